@@ -59,6 +59,11 @@
 
 #include <boost/range/adaptor/reversed.hpp>
 
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
 namespace sigmaengine { namespace app {
 using graphene::net::item_hash_t;
 using graphene::net::item_id;
@@ -80,6 +85,97 @@ api_context::api_context( application& _app, const std::string& _api_name, std::
 
 namespace detail {
 
+   namespace bmi = boost::multi_index;
+
+   /**
+    * LRU of block messages recently served to peers. During a mass sync many peers walk the same
+    * range of blocks, so the same message is often requested several times in a short window.
+    * The compressed form sent to peers that accept compressed messages is kept next to each
+    * block, so it is built once. Only used from the node delegate thread.
+    */
+   class served_block_cache
+   {
+      public:
+         void set_max_size( size_t max_size )
+         {
+            _max_size = max_size;
+            trim();
+         }
+
+         optional< message > get( const block_id_type& id )
+         {
+            optional< message > result;
+            auto& by_id = _entries.get< by_block_id >();
+            auto itr = by_id.find( id );
+            if( itr != by_id.end() )
+            {
+               _entries.relocate( _entries.begin(), _entries.project< 0 >( itr ) );
+               result = itr->msg;
+            }
+            return result;
+         }
+
+         optional< message > get_compressed( const block_id_type& id )
+         {
+            optional< message > result;
+            auto& by_id = _entries.get< by_block_id >();
+            auto itr = by_id.find( id );
+            if( itr != by_id.end() && itr->compressed.valid() )
+            {
+               _entries.relocate( _entries.begin(), _entries.project< 0 >( itr ) );
+               result = *itr->compressed;
+            }
+            return result;
+         }
+
+         /** attaches the compressed form to a block put() before, dropped if that block is not cached */
+         void set_compressed( const block_id_type& id, const message& compressed )
+         {
+            auto& by_id = _entries.get< by_block_id >();
+            auto itr = by_id.find( id );
+            if( itr != by_id.end() )
+               by_id.modify( itr, [&]( entry& e ){ e.compressed = compressed; } );
+         }
+
+         void put( const block_id_type& id, const message& msg )
+         {
+            if( _max_size == 0 )
+               return;
+
+            auto inserted = _entries.push_front( entry{ id, msg, optional< message >() } );
+            if( !inserted.second )
+               _entries.relocate( _entries.begin(), inserted.first );
+            trim();
+         }
+
+      private:
+         void trim()
+         {
+            while( _entries.size() > _max_size )
+               _entries.pop_back();
+         }
+
+         struct entry
+         {
+            block_id_type       id;
+            message             msg;
+            optional< message > compressed;
+         };
+
+         struct by_block_id;
+
+         typedef boost::multi_index_container<
+            entry,
+            bmi::indexed_by<
+               bmi::sequenced<>,
+               bmi::hashed_unique< bmi::tag< by_block_id >, bmi::member< entry, block_id_type, &entry::id >, std::hash< block_id_type > >
+            >
+         > entry_container;
+
+         entry_container _entries;
+         size_t          _max_size = 0;
+   };
+
    class application_impl : public graphene::net::node_delegate
    {
    public:
@@ -133,6 +229,12 @@ namespace detail {
             ilog("Setting p2p max connections to ${n}", ("n", node_param["maximum_number_of_connections"]));
          }
 
+         if( !_options->at("p2p-compression").as<bool>() )
+         {
+            _p2p_network->set_advanced_node_parameters( fc::variant_object( "enable_message_compression", fc::variant( false ) ) );
+            ilog("Disabled compressed p2p messages");
+         }
+
          _p2p_network->listen_to_p2p_network();
          ilog("Configured p2p node to listen on ${ip}", ("ip", _p2p_network->get_actual_listening_endpoint()));
 
@@ -267,6 +369,40 @@ namespace detail {
          if( _options->count("check-locks") )
             _chain_db->set_require_locking( true );
 
+         chainbase::mapping_options mapping;
+         auto huge_pages = _options->at( "shared-file-huge-pages" ).as< string >();
+         if( huge_pages == "transparent" )
+            mapping.huge_pages = chainbase::mapping_options::transparent_huge_pages;
+         else if( huge_pages == "hugetlbfs" )
+            mapping.huge_pages = chainbase::mapping_options::hugetlbfs;
+         else
+            FC_ASSERT( huge_pages == "off", "Unknown shared-file-huge-pages mode ${m}", ("m", huge_pages) );
+         auto numa = _options->at( "shared-file-numa" ).as< string >();
+         auto numa_colon = numa.find( ':' );
+         auto numa_mode = numa.substr( 0, numa_colon );
+         if( numa_mode == "interleave" )
+            mapping.numa = chainbase::mapping_options::numa_interleave;
+         else if( numa_mode == "bind" )
+            mapping.numa = chainbase::mapping_options::numa_bind;
+         else
+            FC_ASSERT( numa == "off", "Unknown shared-file-numa mode ${m}", ("m", numa) );
+         if( numa_colon != string::npos )
+         {
+            vector< string > nodes;
+            boost::split( nodes, numa.substr( numa_colon + 1 ), boost::is_any_of( "," ) );
+            for( const auto& node : nodes )
+               mapping.numa_nodes.push_back( boost::lexical_cast< uint32_t >( boost::trim_copy( node ) ) );
+         }
+         mapping.warm_up = _options->at( "shared-file-warm-up" ).as< bool >();
+         mapping.prefault = _options->at( "shared-file-prefault" ).as< bool >();
+         mapping.lock = _options->at( "shared-file-lock" ).as< bool >();
+         _chain_db->set_mapping_options( mapping );
+         _chain_db->set_page_fault_report_interval( _options->at( "page-fault-report-interval" ).as< uint32_t >() );
+         _chain_db->set_block_authority_cache( _options->at( "block-authority-cache" ).as< bool >() );
+         if( !read_only )
+            _chain_db->set_shared_memory_growth( fc::parse_size( _options->at( "shared-file-min-free" ).as< string >() ),
+                                                 fc::parse_size( _options->at( "shared-file-grow-size" ).as< string >() ) );
+
          if( _options->count("shared-file-dir") )
             _shared_dir = fc::path( _options->at("shared-file-dir").as<string>() );
          else
@@ -275,6 +411,9 @@ namespace detail {
          if( _options->count( "disable-get-block" ) )
             _self->_disable_get_block = true;
 
+         if( _options->at( "read-api-threads" ).as< uint32_t >() > 0 )
+            _read_api_pool = std::make_shared< read_api_pool >( _options->at( "read-api-threads" ).as< uint32_t >() );
+
          if( !read_only )
          {
             _self->_read_only = false;
@@ -285,6 +424,12 @@ namespace detail {
                _chain_db->wipe(_data_dir / "blockchain", _shared_dir, true);
 
             _chain_db->set_flush_interval( _options->at("flush").as<uint32_t>() );
+            _served_blocks.set_max_size( _options->at("p2p-served-block-cache-size").as<uint32_t>() );
+            _chain_db->set_recent_transaction_cache_size( _options->at("p2p-recent-transaction-cache-size").as<uint32_t>() );
+            _chain_db->set_replay_threads( _options->at("replay-threads").as<uint32_t>(), _options->at("replay-queue-size").as<uint32_t>() );
+            _chain_db->set_signature_recovery_threads( _options->at("signature-recovery-threads").as<uint32_t>() );
+            _chain_db->set_block_prevalidation_threads( _options->at("block-prevalidation-threads").as<uint32_t>(), _options->at("block-prevalidation-queue-size").as<uint32_t>() );
+            _chain_db->set_single_pass_block_production( _options->at("single-pass-block-production").as<bool>() );
 
             flat_map<uint32_t,block_id_type> loaded_checkpoints;
             if( _options->count("checkpoint") )
@@ -309,7 +454,17 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
                }
             }
 
-            if( _options->count("replay-blockchain") )
+            fc::path snapshot_dir = _data_dir / "snapshots";
+            if( _options->count("snapshot-dir") )
+               snapshot_dir = fc::path( _options->at("snapshot-dir").as<string>() );
+            _chain_db->set_snapshot_interval( _options->at("snapshot-interval").as<uint32_t>(), snapshot_dir, _options->at("snapshots-to-keep").as<uint32_t>() );
+
+            if( _options->count("load-snapshot") )
+            {
+               ilog("Loading snapshot on user request.");
+               _chain_db->open_from_snapshot( _data_dir / "blockchain", _shared_dir, fc::path( _options->at("load-snapshot").as<string>() ), _shared_file_size );
+            }
+            else if( _options->count("replay-blockchain") )
             {
                ilog("Replaying blockchain on user request.");
                _chain_db->reindex( _data_dir / "blockchain", _shared_dir, _shared_file_size );
@@ -320,18 +475,39 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
                {
                   _chain_db->open(_data_dir / "blockchain", _shared_dir, SIGMAENGINE_INIT_SUPPLY, _shared_file_size, chainbase::database::read_write );
                }
-               catch( fc::assert_exception& )
+               catch( fc::exception& )
                {
-                  wlog( "Error when opening database. Attempting reindex..." );
-
-                  try
+                  // Also reached when the shared memory file was written by an incompatible build
+                  bool restored = false;
+                  auto snapshot = chain::database::latest_snapshot( snapshot_dir );
+                  if( snapshot != fc::path() )
                   {
-                     _chain_db->reindex( _data_dir / "blockchain", _shared_dir, _shared_file_size );
+                     wlog( "Error when opening database. Attempting to load snapshot ${s}...", ("s", snapshot) );
+
+                     try
+                     {
+                        _chain_db->open_from_snapshot( _data_dir / "blockchain", _shared_dir, snapshot, _shared_file_size );
+                        restored = true;
+                     }
+                     catch( fc::exception& e )
+                     {
+                        wlog( "Error loading snapshot: ${e}", ("e", e.to_detail_string()) );
+                     }
                   }
-                  catch( chain::block_log_exception& )
+
+                  if( !restored )
                   {
-                     wlog( "Error opening block log. Having to resync from network..." );
-                     _chain_db->open( _data_dir / "blockchain", _shared_dir, SIGMAENGINE_INIT_SUPPLY, _shared_file_size, chainbase::database::read_write );
+                     wlog( "Error when opening database. Attempting reindex..." );
+
+                     try
+                     {
+                        _chain_db->reindex( _data_dir / "blockchain", _shared_dir, _shared_file_size );
+                     }
+                     catch( chain::block_log_exception& )
+                     {
+                        wlog( "Error opening block log. Having to resync from network..." );
+                        _chain_db->open( _data_dir / "blockchain", _shared_dir, SIGMAENGINE_INIT_SUPPLY, _shared_file_size, chainbase::database::read_write );
+                     }
                   }
                }
             }
@@ -639,16 +815,31 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
          // ilog("Request for item ${id}", ("id", id));
          if( id.item_type == graphene::net::block_message_type )
          {
-            return _chain_db->with_read_lock( [&]()
+            auto cached = _served_blocks.get( id.item_hash );
+            if( cached.valid() )
+               return *cached;
+
+            // Irreversible blocks come straight out of the block log as packed bytes, so the
+            // message body is built by appending the packed id instead of unpacking and repacking.
+            auto packed_block = _chain_db->with_read_lock( [&]()
             {
-               auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
+               auto opt_block = _chain_db->fetch_serialized_block_by_id(id.item_hash);
                if( !opt_block )
                   elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
                      ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-               FC_ASSERT( opt_block.valid() );
-               // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-               return block_message(std::move(*opt_block));
+               return opt_block;
             });
+            FC_ASSERT( packed_block.valid() );
+
+            message result;
+            result.msg_type = block_message::type;
+            result.data = std::move( *packed_block );
+            auto packed_id = fc::raw::pack( block_id_type( id.item_hash ) );
+            result.data.insert( result.data.end(), packed_id.begin(), packed_id.end() );
+            result.size = (uint32_t)result.data.size();
+
+            _served_blocks.put( id.item_hash, result );
+            return result;
          }
          return _chain_db->with_read_lock( [&]()
          {
@@ -656,6 +847,25 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
          });
       } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+      /**
+       * The body of get_item() as it is sent to peers that accept compressed messages. Blocks are
+       * compressed once and kept in the served block cache for the next peer that asks.
+       */
+      virtual message get_compressed_item(const item_id& id) override
+      { try {
+         if( id.item_type == graphene::net::block_message_type )
+         {
+            auto cached = _served_blocks.get_compressed( id.item_hash );
+            if( cached.valid() )
+               return *cached;
+
+            message result = graphene::net::compress_if_worthwhile( get_item( id ) );
+            _served_blocks.set_compressed( id.item_hash, result );
+            return result;
+         }
+         return graphene::net::compress_if_worthwhile( get_item( id ) );
+      } FC_CAPTURE_AND_RETHROW( (id) ) }
+
       /**
        * Returns a synopsis of the blockchain used for syncing.  This consists of a list of
        * block hashes at intervals exponentially increasing towards the genesis block.
@@ -863,6 +1073,15 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
          return block_header::num_from_id(block_id);
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
+      /**
+       * Start the checks that do not depend on chain state on a block received during sync, which
+       * may arrive well before the blocks it builds on have been applied.
+       */
+      virtual void prevalidate_sync_block(const graphene::net::block_message& blk_msg) override
+      {
+         _chain_db->prevalidate_block( blk_msg.block_id, blk_msg.block, _is_block_producer || _force_validate );
+      }
+
       /**
        * Returns the time a block was produced (if block_id = 0, returns genesis time).
        * If we don't know about the block, returns time_point_sec::min()
@@ -871,8 +1090,8 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
       { try {
          return _chain_db->with_read_lock( [&]()
          {
-            auto opt_block = _chain_db->fetch_block_by_id( block_id );
-            if( opt_block.valid() ) return opt_block->timestamp;
+            auto opt_time = _chain_db->fetch_block_time_by_id( block_id );
+            if( opt_time.valid() ) return *opt_time;
             return fc::time_point_sec::min();
          });
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
@@ -927,6 +1146,7 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
       std::shared_ptr<graphene::net::node>             _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
+      std::shared_ptr<read_api_pool>                   _read_api_pool;
 
       std::map<string, std::shared_ptr<abstract_plugin> > _plugins_available;
       std::map<string, std::shared_ptr<abstract_plugin> > _plugins_enabled;
@@ -938,6 +1158,8 @@ ilog( "_options->count(black-list) : ${ccc}", ("ccc", _options->count("black-lis
       bool                                             _running;
 
       uint32_t allow_pia_time = 5;
+
+      served_block_cache                               _served_blocks;
    };
 
 }
@@ -988,10 +1210,22 @@ void application::set_program_options(boost::program_options::options_descriptio
    configuration_file_options.add_options()
          ("p2p-endpoint", bpo::value<string>(), "Endpoint for P2P node to listen on")
          ("p2p-max-connections", bpo::value<uint32_t>(), "Maxmimum number of incoming connections on P2P endpoint")
+         ("p2p-compression", bpo::value< bool >()->default_value(true), "Send blocks and transactions zlib compressed to peers that support it")
+         ("p2p-served-block-cache-size", bpo::value<uint32_t>()->default_value(512), "Number of recently served block messages cached for peers, 0 to disable")
+         ("p2p-recent-transaction-cache-size", bpo::value<uint32_t>()->default_value(50000), "Number of recently applied transactions kept in memory to serve to peers, 0 to disable")
          ("seed-node,s", bpo::value<vector<string>>()->composing(), "P2P nodes to connect to on startup (may specify multiple times)")
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
          ("shared-file-dir", bpo::value<string>(), "Location of the shared memory file. Defaults to data_dir/blockchain")
          ("shared-file-size", bpo::value<string>()->default_value("54G"), "Size of the shared memory file. Default: 54G")
+         ("shared-file-min-free", bpo::value<string>()->default_value("0"), "Grow the shared memory file between blocks whenever its free memory falls below this size, 0 to never grow it while running")
+         ("shared-file-grow-size", bpo::value<string>()->default_value("8G"), "Size the shared memory file grows by each time free memory falls below shared-file-min-free")
+         ("shared-file-huge-pages", bpo::value<string>()->default_value("off"), "Huge pages for the shared memory file: off, transparent (for a shared-file-dir on tmpfs such as /dev/shm) or hugetlbfs (for a shared-file-dir on a hugetlbfs mount)")
+         ("shared-file-numa", bpo::value<string>()->default_value("off"), "NUMA placement of the shared memory file: off, interleave or bind, over all nodes or the nodes listed after a colon, such as interleave:0,1")
+         ("shared-file-warm-up", bpo::value< bool >()->default_value(false), "Have the kernel read the whole shared memory file in on startup")
+         ("shared-file-prefault", bpo::value< bool >()->default_value(false), "Fault in the whole shared memory file on startup and after it grows, which takes as much RAM as the file is large")
+         ("shared-file-lock", bpo::value< bool >()->default_value(false), "Lock the whole shared memory file in RAM on startup and after it grows, needs a memlock limit of at least shared-file-size")
+         ("block-authority-cache", bpo::value< bool >()->default_value(false), "Look up the authorities of the accounts signing a block's transactions once per block, for blocks with many multisig transactions")
+         ("page-fault-report-interval", bpo::value< uint32_t >()->default_value(0), "Log page faults and dTLB misses per block every this many blocks, 0 to disable")
          ("rpc-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:5020"), "Endpoint for websocket RPC to listen on")
          ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"), "Endpoint for TLS websocket RPC to listen on")
          ("read-forward-rpc", bpo::value<string>(), "Endpoint to forward write API calls to for a read node" )
@@ -1002,12 +1236,23 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-plugin", bpo::value< vector<string> >()->composing()->default_value(default_plugins, str_default_plugins), "Plugin(s) to enable, may be specified multiple times")
          ("max-block-age", bpo::value< int32_t >()->default_value(200), "Maximum age of head block when broadcasting tx via API")
          ("flush", bpo::value< uint32_t >()->default_value(100000), "Flush shared memory file to disk this many blocks")
+         ("replay-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads unpacking blocks ahead of the applier during replay, 0 to replay serially")
+         ("replay-queue-size", bpo::value< uint32_t >()->default_value(1024), "Maximum number of blocks read ahead of the applier during replay")
+         ("signature-recovery-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads recovering transaction signatures of incoming blocks before they are applied, 0 to recover them inline")
+         ("block-prevalidation-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads checking sync blocks as they arrive, ahead of the blocks being applied, 0 to check them when they are applied")
+         ("block-prevalidation-queue-size", bpo::value< uint32_t >()->default_value(2048), "Maximum number of sync blocks held by the prevalidation threads")
+         ("read-api-threads", bpo::value< uint32_t >()->default_value(2), "Number of threads serving read-only database API calls next to the thread that applies blocks, 0 to serve them on that thread")
+         ("single-pass-block-production", bpo::value< bool >()->default_value(true), "Apply pending transactions once while producing a block and keep that state as the new head block, instead of applying the produced block again")
+         ("snapshot-interval", bpo::value< uint32_t >()->default_value(0), "Write a state snapshot each time the last irreversible block passes a multiple of this many blocks, 0 to disable")
+         ("snapshot-dir", bpo::value<string>(), "Directory snapshots are written to and loaded from. Defaults to data_dir/snapshots")
+         ("snapshots-to-keep", bpo::value< uint32_t >()->default_value(2), "Number of most recent snapshots kept in snapshot-dir")
          ("backtrace", bpo::value<string>()->default_value("yes"), "Whether to print backtrace on SIGSEGV")
          ("black-list", bpo::value<vector<string>>()->composing(), "black-list account")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
          ("replay-blockchain", "Rebuild object graph by replaying all blocks")
+         ("load-snapshot", bpo::value<string>(), "Rebuild object graph from a snapshot file and the blocks after it in the block log")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
          ("force-validate", "Force validation of all transactions")
          ("read-only", "Node will not connect to p2p network and can only read from the chain state" )
@@ -1057,6 +1302,11 @@ std::shared_ptr<chain::database> application::chain_database() const
 {
    return my->_chain_db;
 }
+
+std::shared_ptr<read_api_pool> application::get_read_api_pool() const
+{
+   return my->_read_api_pool;
+}
 /*std::shared_ptr<graphene::db::object_database> application::pending_trx_database() const
 {
    return my->_pending_trx_db;
@@ -21,6 +21,28 @@
 
 #define GET_REQUIRED_FEES_MAX_RECURSION 4
 
+namespace sigmaengine { namespace app { namespace detail {
+
+   /// Where a stream stopped. Clients get it packed and hex encoded and only hand it back
+   struct stream_cursor
+   {
+      enum stream_kind
+      {
+         block_range = 0,
+         operation_list = 1,
+         account_history = 2
+      };
+
+      uint8_t     kind = block_range;
+      uint64_t    next = 0;        ///< block number, operation number or sequence number to send next
+      uint64_t    remaining = 0;   ///< items left to send
+      string      account;
+   };
+
+} } }
+
+FC_REFLECT( sigmaengine::app::detail::stream_cursor, (kind)(next)(remaining)(account) )
+
 namespace sigmaengine { namespace app {
 
 class database_api_impl;
@@ -71,12 +93,31 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       bool verify_authority( const signed_transaction& trx )const;
       bool verify_account_authority( const string& name_or_id, const flat_set<public_key_type>& signers )const;
 
+      /**
+       * Run callback under the database read lock, on the read API pool when the node has one so the
+       * thread applying blocks is free while the call waits for the lock and runs. Pool workers read on
+       * another thread than the writer, so they take the lock as strict readers: the writer still moves
+       * past a call that reads longer than its lock wait, and that call fails rather than return a result
+       * read across a block.
+       */
+      template< typename Lambda >
+      auto with_read_lock( Lambda&& callback )const -> decltype( (*(Lambda*)nullptr)() )
+      {
+         if( _read_api_pool )
+            return _read_api_pool->run( [&]() { return _db.with_strict_read_lock( std::forward< Lambda >( callback ) ); } );
+         return _db.with_read_lock( std::forward< Lambda >( callback ) );
+      }
+
+      // Streams
+      string stream( detail::stream_cursor cursor, const std::function<void(const variant&)>& cb )const;
+
       // signal handlers
       void on_applied_block( const chain::signed_block& b );
 
       std::function<void(const fc::variant&)> _block_applied_callback;
 
       sigmaengine::chain::database&                _db;
+      std::shared_ptr< read_api_pool >             _read_api_pool;
 
       boost::signals2::scoped_connection       _block_applied_connection;
 
@@ -85,17 +126,15 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
 applied_operation::applied_operation() {}
 
-applied_operation::applied_operation( const operation_object& op_obj )
+applied_operation::applied_operation( const history_operation& op_obj )
  : trx_id( op_obj.trx_id ),
    block( op_obj.block ),
    trx_in_block( op_obj.trx_in_block ),
    op_in_trx( op_obj.op_in_trx ),
    virtual_op( op_obj.virtual_op ),
-   timestamp( op_obj.timestamp )
-{
-   //fc::raw::unpack( op_obj.serialized_op, op );     // g++ refuses to compile this as ambiguous
-   op = fc::raw::unpack< operation >( op_obj.serialized_op );
-}
+   timestamp( op_obj.timestamp ),
+   op( op_obj.op )
+{}
 
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
@@ -141,7 +180,7 @@ database_api::database_api( const sigmaengine::app::api_context& ctx )
 database_api::~database_api() {}
 
 database_api_impl::database_api_impl( const sigmaengine::app::api_context& ctx )
-   : _db( *ctx.app.chain_database() )
+   : _db( *ctx.app.chain_database() ), _read_api_pool( ctx.app.get_read_api_pool() )
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
 
@@ -165,7 +204,7 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 {
    FC_ASSERT( !my->_disable_get_block, "get_block_header is disabled on this node." );
 
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_block_header( block_num );
    });
@@ -173,9 +212,9 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 
 optional<block_header> database_api_impl::get_block_header(uint32_t block_num) const
 {
-   auto result = _db.fetch_block_by_number(block_num);
+   auto result = _db.fetch_block_header_by_number(block_num);
    if(result)
-      return *result;
+      return block_header( *result );
    return {};
 }
 
@@ -183,7 +222,7 @@ optional<signed_block_api_obj> database_api::get_block(uint32_t block_num)const
 {
    FC_ASSERT( !my->_disable_get_block, "get_block is disabled on this node." );
 
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_block( block_num );
    });
@@ -196,7 +235,7 @@ optional<signed_block_api_obj> database_api_impl::get_block(uint32_t block_num)c
 
 vector<applied_operation> database_api::get_ops_in_block(uint32_t block_num, bool only_virtual)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_ops_in_block( block_num, only_virtual );
    });
@@ -204,19 +243,13 @@ vector<applied_operation> database_api::get_ops_in_block(uint32_t block_num, boo
 
 vector<applied_operation> database_api_impl::get_ops_in_block(uint32_t block_num, bool only_virtual)const
 {
-   const auto& idx = _db.get_index< operation_index >().indices().get< by_location >();   
-   auto itr = idx.lower_bound( block_num );
    vector<applied_operation> result;
-   applied_operation temp;
-   while( itr != idx.end() && itr->block == block_num )
+   for( const auto& op : _db.get_history_store().get_block_operations( block_num ) )
    {
-      temp = *itr;
-      if( !only_virtual || is_virtual_operation(temp.op) )
-         result.push_back(temp);
-      ++itr;
+      if( !only_virtual || is_virtual_operation(op.op) )
+         result.push_back(op);
    }
-   
-   
+
    return result;
 }
 
@@ -229,7 +262,7 @@ vector<applied_operation> database_api_impl::get_ops_in_block(uint32_t block_num
 
 fc::variant_object database_api::get_config()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_config();
    });
@@ -242,7 +275,7 @@ fc::variant_object database_api_impl::get_config()const
 
 dynamic_global_property_api_obj database_api::get_dynamic_global_properties()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_dynamic_global_properties();
    });
@@ -255,7 +288,7 @@ dynamic_global_property_api_obj database_api_impl::get_dynamic_global_properties
 
 bobserver_schedule_api_obj database_api::get_bobserver_schedule()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->_db.get(bobserver_schedule_id_type());
    });
@@ -263,7 +296,7 @@ bobserver_schedule_api_obj database_api::get_bobserver_schedule()const
 
 hardfork_version database_api::get_hardfork_version()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->_db.get(hardfork_property_id_type()).current_hardfork_version;
    });
@@ -271,7 +304,7 @@ hardfork_version database_api::get_hardfork_version()const
 
 scheduled_hardfork database_api::get_next_scheduled_hardfork() const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       scheduled_hardfork shf;
       const auto& hpo = my->_db.get(hardfork_property_id_type());
@@ -283,7 +316,7 @@ scheduled_hardfork database_api::get_next_scheduled_hardfork() const
 
 common_fund_api_obj database_api::get_common_fund( string name )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       auto fund = my->_db.find< common_fund_object, by_name >( name );
       FC_ASSERT( fund != nullptr, "Invalid reward fund name" );
@@ -319,7 +352,7 @@ variant database_api::get_fund_info(string name) const
 
 vector< savings_withdraw_api_obj > database_api::get_savings_withdraw_from( string account )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       vector<savings_withdraw_api_obj> result;
 
@@ -335,7 +368,7 @@ vector< savings_withdraw_api_obj > database_api::get_savings_withdraw_from( stri
 
 vector< savings_withdraw_api_obj > database_api::get_savings_withdraw_to( string account )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       vector<savings_withdraw_api_obj> result;
 
@@ -351,7 +384,7 @@ vector< savings_withdraw_api_obj > database_api::get_savings_withdraw_to( string
 
 vector< fund_withdraw_api_obj > database_api::get_fund_withdraw_from( string fund_name, string account )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       vector<fund_withdraw_api_obj> result;
 
@@ -367,7 +400,7 @@ vector< fund_withdraw_api_obj > database_api::get_fund_withdraw_from( string fun
 
 vector< fund_withdraw_api_obj > database_api::get_fund_withdraw_list( string fund_name, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
 
@@ -388,7 +421,7 @@ vector< fund_withdraw_api_obj > database_api::get_fund_withdraw_list( string fun
 
 dapp_reward_fund_api_object database_api::get_dapp_reward_fund() const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_dapp_reward_fund();
    });
@@ -407,7 +440,7 @@ dapp_reward_fund_api_object database_api_impl::get_dapp_reward_fund() const
 
 vector<set<string>> database_api::get_key_references( vector<public_key_type> key )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_key_references( key );
    });
@@ -431,7 +464,7 @@ vector<set<string>> database_api_impl::get_key_references( vector<public_key_typ
 
 vector< extended_account > database_api::get_accounts( vector< string > names )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_accounts( names );
    });
@@ -463,7 +496,7 @@ vector< extended_account > database_api_impl::get_accounts( vector< string > nam
 
 vector<account_id_type> database_api::get_account_references( account_id_type account_id )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_account_references( account_id );
    });
@@ -488,7 +521,7 @@ vector<account_id_type> database_api_impl::get_account_references( account_id_ty
 
 vector<optional<account_api_obj>> database_api::lookup_account_names(const vector<string>& account_names)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->lookup_account_names( account_names );
    });
@@ -518,7 +551,7 @@ vector<optional<account_api_obj>> database_api_impl::lookup_account_names(const
 
 set<string> database_api::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->lookup_accounts( lower_bound_name, limit );
    });
@@ -542,7 +575,7 @@ set<string> database_api_impl::lookup_accounts(const string& lower_bound_name, u
 
 uint64_t database_api::get_account_count()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_account_count();
    });
@@ -555,7 +588,7 @@ uint64_t database_api_impl::get_account_count()const
 
 vector< owner_authority_history_api_obj > database_api::get_owner_history( string account )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       vector< owner_authority_history_api_obj > results;
 
@@ -574,7 +607,7 @@ vector< owner_authority_history_api_obj > database_api::get_owner_history( strin
 
 optional< account_recovery_request_api_obj > database_api::get_recovery_request( string account )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       optional< account_recovery_request_api_obj > result;
 
@@ -596,7 +629,7 @@ optional< account_recovery_request_api_obj > database_api::get_recovery_request(
 
 vector<optional<bobserver_api_obj>> database_api::get_bobservers(const vector<bobserver_id_type>& bobserver_ids)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_bobservers( bobserver_ids );
    });
@@ -616,7 +649,7 @@ vector<optional<bobserver_api_obj>> database_api_impl::get_bobservers(const vect
 
 fc::optional<bobserver_api_obj> database_api::get_bobserver_by_account( string account_name ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_bobserver_by_account( account_name );
    });
@@ -624,7 +657,7 @@ fc::optional<bobserver_api_obj> database_api::get_bobserver_by_account( string a
 
 vector< bobserver_api_obj > database_api::get_bobservers_by_vote( string from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       //idump((from)(limit));
       FC_ASSERT( limit <= 100 );
@@ -664,7 +697,7 @@ fc::optional<bobserver_api_obj> database_api_impl::get_bobserver_by_account( str
 
 set< account_name_type > database_api::lookup_bobserver_accounts( const string& lower_bound_name, uint32_t limit ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->lookup_bobserver_accounts( lower_bound_name, limit );
    });
@@ -693,7 +726,7 @@ set< account_name_type > database_api_impl::lookup_bobserver_accounts( const str
 
 vector< bproducer_api_obj > database_api::lookup_bproducer_accounts()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->lookup_bproducer_accounts();
    });
@@ -717,7 +750,7 @@ vector< bproducer_api_obj > database_api_impl::lookup_bproducer_accounts()const
 
 uint64_t database_api::get_bobserver_count()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_bobserver_count();
    });
@@ -730,7 +763,7 @@ uint64_t database_api_impl::get_bobserver_count()const
 
 bool database_api::has_hardfork( uint32_t hardfork  ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->has_hardfork( hardfork );
    });
@@ -749,7 +782,7 @@ bool database_api_impl::has_hardfork( uint32_t hardfork )const
 
 std::string database_api::get_transaction_hex(const signed_transaction& trx)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_transaction_hex( trx );
    });
@@ -762,7 +795,7 @@ std::string database_api_impl::get_transaction_hex(const signed_transaction& trx
 
 set<public_key_type> database_api::get_required_signatures( const signed_transaction& trx, const flat_set<public_key_type>& available_keys )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_required_signatures( trx, available_keys );
    });
@@ -773,9 +806,9 @@ set<public_key_type> database_api_impl::get_required_signatures( const signed_tr
 //   wdump((trx)(available_keys));
    auto result = trx.get_required_signatures( SIGMAENGINE_CHAIN_ID,
                                               available_keys,
-                                              [&]( string account_name ){ return authority( _db.get< account_authority_object, by_account >( account_name ).active  ); },
-                                              [&]( string account_name ){ return authority( _db.get< account_authority_object, by_account >( account_name ).owner   ); },
-                                              [&]( string account_name ){ return authority( _db.get< account_authority_object, by_account >( account_name ).posting ); },
+                                              [&]( const string& account_name ) -> authority_view { return _db.get< account_authority_object, by_account >( account_name ).active;  },
+                                              [&]( const string& account_name ) -> authority_view { return _db.get< account_authority_object, by_account >( account_name ).owner;   },
+                                              [&]( const string& account_name ) -> authority_view { return _db.get< account_authority_object, by_account >( account_name ).posting; },
                                               SIGMAENGINE_MAX_SIG_CHECK_DEPTH );
 //   wdump((result));
    return result;
@@ -783,7 +816,7 @@ set<public_key_type> database_api_impl::get_required_signatures( const signed_tr
 
 set<public_key_type> database_api::get_potential_signatures( const signed_transaction& trx )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->get_potential_signatures( trx );
    });
@@ -796,26 +829,26 @@ set<public_key_type> database_api_impl::get_potential_signatures( const signed_t
    trx.get_required_signatures(
       SIGMAENGINE_CHAIN_ID,
       flat_set<public_key_type>(),
-      [&]( account_name_type account_name )
+      [&]( const string& account_name ) -> authority_view
       {
          const auto& auth = _db.get< account_authority_object, by_account >(account_name).active;
-         for( const auto& k : auth.get_keys() )
-            result.insert(k);
-         return authority( auth );
+         for( const auto& k : auth.key_auths )
+            result.insert(k.first);
+         return auth;
       },
-      [&]( account_name_type account_name )
+      [&]( const string& account_name ) -> authority_view
       {
          const auto& auth = _db.get< account_authority_object, by_account >(account_name).owner;
-         for( const auto& k : auth.get_keys() )
-            result.insert(k);
-         return authority( auth );
+         for( const auto& k : auth.key_auths )
+            result.insert(k.first);
+         return auth;
       },
-      [&]( account_name_type account_name )
+      [&]( const string& account_name ) -> authority_view
       {
          const auto& auth = _db.get< account_authority_object, by_account >(account_name).posting;
-         for( const auto& k : auth.get_keys() )
-            result.insert(k);
-         return authority( auth );
+         for( const auto& k : auth.key_auths )
+            result.insert(k.first);
+         return auth;
       },
       SIGMAENGINE_MAX_SIG_CHECK_DEPTH
    );
@@ -826,7 +859,7 @@ set<public_key_type> database_api_impl::get_potential_signatures( const signed_t
 
 bool database_api::verify_authority( const signed_transaction& trx ) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->verify_authority( trx );
    });
@@ -835,16 +868,16 @@ bool database_api::verify_authority( const signed_transaction& trx ) const
 bool database_api_impl::verify_authority( const signed_transaction& trx )const
 {
    trx.verify_authority( SIGMAENGINE_CHAIN_ID,
-                         [&]( string account_name ){ return authority( _db.get< account_authority_object, by_account >( account_name ).active  ); },
-                         [&]( string account_name ){ return authority( _db.get< account_authority_object, by_account >( account_name ).owner   ); },
-                         [&]( string account_name ){ return authority( _db.get< account_authority_object, by_account >( account_name ).posting ); },
+                         [&]( const string& account_name ) -> authority_view { return _db.get< account_authority_object, by_account >( account_name ).active;  },
+                         [&]( const string& account_name ) -> authority_view { return _db.get< account_authority_object, by_account >( account_name ).owner;   },
+                         [&]( const string& account_name ) -> authority_view { return _db.get< account_authority_object, by_account >( account_name ).posting; },
                          SIGMAENGINE_MAX_SIG_CHECK_DEPTH );
    return true;
 }
 
 bool database_api::verify_account_authority( const string& name_or_id, const flat_set<public_key_type>& signers )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       return my->verify_account_authority( name_or_id, signers );
    });
@@ -875,7 +908,7 @@ u256 to256( const fc::uint128& t )
 
 asset database_api::get_total_supply() const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       const auto& null_account = my->_db.get_account( SIGMAENGINE_NULL_ACCOUNT );
       asset miss_balance( 0, SGT_SYMBOL );
@@ -900,7 +933,7 @@ asset database_api::get_total_supply() const
 
 asset database_api::get_dapp_transaction_fee() const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       asset fee = my->_db.get_dynamic_global_properties().dapp_transaction_fee;
       
@@ -911,7 +944,7 @@ asset database_api::get_dapp_transaction_fee() const
 
 map< uint32_t, account_balance_api_obj > database_api::get_balance_rank( uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       
@@ -920,18 +953,10 @@ map< uint32_t, account_balance_api_obj > database_api::get_balance_rank( uint64_
       
       const auto& idx = my->_db.get_index< account_index >().indices().get< by_balance >();
 
-      auto itr = idx.begin();
+      auto itr = idx.nth( from );
       auto end = idx.end();
 
-      uint32_t index = 0;
-      if ( from > 0 )
-      {
-         while( itr != end && from-- )
-         {
-            ++itr;
-            index++;
-         }
-      }
+      uint32_t index = from;
 
       map<uint32_t, account_balance_api_obj> result;
       account_balance_api_obj temp;
@@ -948,12 +973,29 @@ map< uint32_t, account_balance_api_obj > database_api::get_balance_rank( uint64_
    });
 }
 
+optional< uint32_t > database_api::get_account_balance_rank( string account )const
+{
+   return my->with_read_lock( [&]()
+   {
+      optional< uint32_t > result;
+
+      const auto* acnt = my->_db.find_account( account );
+      if( acnt != nullptr )
+      {
+         const auto& idx = my->_db.get_index< account_index >().indices().get< by_balance >();
+         result = idx.rank( idx.iterator_to( *acnt ) );
+      }
+
+      return result;
+   });
+}
+
 map< uint32_t, optional<signed_block_api_obj>> database_api::get_block_range(uint32_t block_num, uint16_t num)const
 {
    FC_ASSERT( !my->_disable_get_block, "get_block is disabled on this node." );
    FC_ASSERT( num < 1000, "num lass than 1000." );
 
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       map<uint32_t, optional<signed_block_api_obj>> result;
       for ( uint32_t i = 0 ; i < num ; i++ )
@@ -971,54 +1013,170 @@ map< uint32_t, optional<signed_block_api_obj>> database_api::get_block_range(uin
    });
 }
 
-map< uint32_t, applied_operation > database_api::get_operation_list( uint64_t from, uint32_t limit )const
+//////////////////////////////////////////////////////////////////////
+//                                                                  //
+// Streams                                                          //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+string database_api::stream_block_range( std::function<void(const variant&)> cb, uint32_t first_block, uint32_t count )const
+{
+   FC_ASSERT( !my->_disable_get_block, "get_block is disabled on this node." );
+   FC_ASSERT( first_block > 0, "Blocks are numbered from 1" );
+
+   detail::stream_cursor cursor;
+   cursor.kind = detail::stream_cursor::block_range;
+   cursor.next = first_block;
+   cursor.remaining = count;
+   return my->stream( cursor, cb );
+}
+
+string database_api::stream_operation_list( std::function<void(const variant&)> cb, uint64_t from, uint64_t count )const
 {
-   return my->_db.with_read_lock( [&]()
+   detail::stream_cursor cursor;
+   cursor.kind = detail::stream_cursor::operation_list;
+   cursor.remaining = count;
+
+   my->with_read_lock( [&]()
    {
-      FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
-      //FC_ASSERT( from >= 0, "From must be greater than -1" );
+      // Index 0 is the most recent operation
+      uint64_t total = my->_db.get_history_store().operation_count();
+      if( from < total )
+         cursor.next = total - 1 - from;
+      else
+         cursor.remaining = 0;
+   });
 
-      const auto& idx = my->_db.get_index< operation_index >().indices().get< by_location >();
+   return my->stream( cursor, cb );
+}
 
-      auto itr = idx.rbegin();
-      auto end = idx.rend();
-      
-      uint32_t start = from;
-      
-      /*
-      auto itr = idx.begin();
-      auto end = idx.end();
+string database_api::stream_account_history( std::function<void(const variant&)> cb, string account, uint64_t from, uint64_t count )const
+{
+   detail::stream_cursor cursor;
+   cursor.kind = detail::stream_cursor::account_history;
+   cursor.remaining = count;
+   cursor.account = account;
 
-      uint32_t max = idx.size();
-      //ilog("get_opeartion_list size ${s}",("s",max));
+   my->with_read_lock( [&]()
+   {
+      uint64_t size = my->_db.get_history_store().sequence_size( account_history_key( account ) );
+      if( size > 0 )
+         cursor.next = std::min( from, size - 1 );
+      else
+         cursor.remaining = 0;
+   });
+
+   return my->stream( cursor, cb );
+}
+
+string database_api::resume_stream( std::function<void(const variant&)> cb, string cursor )const
+{
+   detail::stream_cursor c;
+   try
+   {
+      std::vector< char > packed( cursor.size() / 2 );
+      FC_ASSERT( fc::from_hex( cursor, packed.data(), packed.size() ) == packed.size() );
+      c = fc::raw::unpack< detail::stream_cursor >( packed );
+   }
+   FC_CAPTURE_AND_RETHROW( (cursor) )
+
+   FC_ASSERT( c.kind <= detail::stream_cursor::account_history, "Unknown stream cursor" );
+   FC_ASSERT( c.kind != detail::stream_cursor::block_range || !my->_disable_get_block, "get_block is disabled on this node." );
+   return my->stream( c, cb );
+}
 
-      uint32_t start = max - limit;
-      if ( from < my->_db.head_block_num() )
+string database_api_impl::stream( detail::stream_cursor cursor, const std::function<void(const variant&)>& cb )const
+{
+   const bool blocks = cursor.kind == detail::stream_cursor::block_range;
+
+   // Blocks are much larger than operations, so they go in smaller chunks
+   uint64_t budget = blocks ? 1000 : 10000;
+   const uint64_t chunk_size = blocks ? 20 : 200;
+
+   while( cursor.remaining > 0 && budget > 0 )
+   {
+      uint64_t n = std::min( { cursor.remaining, budget, chunk_size } );
+      budget -= n;
+
+      // The read lock is only held while a chunk is read, it is converted and sent after releasing it
+      fc::variant chunk;
+      if( blocks )
       {
-         start = from;
-      }
-      */
+         auto items = with_read_lock( [&]()
+         {
+            vector< std::pair< uint32_t, signed_block_api_obj > > result;
+            result.reserve( n );
+            for( ; n > 0 && cursor.next <= _db.head_block_num(); --n, --cursor.remaining, ++cursor.next )
+            {
+               auto b = _db.fetch_block_by_number( cursor.next );
+               FC_ASSERT( b.valid(), "Block ${b} is missing", ("b", cursor.next) );
+               result.emplace_back( cursor.next, std::move( *b ) );
+            }
 
-      uint32_t index = 0;
-      while( itr != end && start-- )
+            // Stopped at the head block
+            if( n > 0 )
+               cursor.remaining = 0;
+            return result;
+         });
+         chunk = fc::variant( items );
+      }
+      else
       {
-         ++itr;
-         index++;
+         auto items = with_read_lock( [&]()
+         {
+            const auto& history = _db.get_history_store();
+            vector< std::pair< uint64_t, applied_operation > > result;
+
+            if( cursor.kind == detail::stream_cursor::operation_list )
+            {
+               result.reserve( n );
+               for( ; n > 0; --n, --cursor.remaining )
+               {
+                  result.emplace_back( cursor.next, history.get_operation( cursor.next ) );
+                  if( cursor.next == 0 )
+                  {
+                     cursor.remaining = 0;
+                     break;
+                  }
+                  --cursor.next;
+               }
+            }
+            else
+            {
+               for( auto& item : history.get_sequence( account_history_key( cursor.account ), cursor.next, n - 1 ) )
+                  result.emplace_back( item.first, std::move( item.second ) );
+
+               cursor.remaining -= result.size();
+               if( cursor.next < n )
+                  cursor.remaining = 0;
+               else
+                  cursor.next -= n;
+            }
+            return result;
+         });
+         chunk = fc::variant( items );
       }
 
+      cb( chunk );
+   }
+
+   return cursor.remaining > 0 ? fc::to_hex( fc::raw::pack( cursor ) ) : string();
+}
+
+map< uint32_t, applied_operation > database_api::get_operation_list( uint64_t from, uint32_t limit )const
+{
+   return my->with_read_lock( [&]()
+   {
+      FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
+
+      // Index 0 is the most recent operation
+      const auto& history = my->_db.get_history_store();
+      uint64_t count = history.operation_count();
+
       map<uint32_t, applied_operation> result;
-      applied_operation temp;
-      
-      while( itr != end && limit-- )
-      {
-         //ilog(" itr opeartion is ${b} ${op}",("b", itr->block)("op",itr->trx_id));
+      for( uint64_t index = from; index < count && limit--; ++index )
+         result[index] = history.get_operation( count - 1 - index );
 
-         temp = *itr;
-         result[index] = temp;
-         ++itr;
-         index++;
-      }
-      
       return result;
    });
 }
@@ -1026,7 +1184,7 @@ map< uint32_t, applied_operation > database_api::get_operation_list( uint64_t fr
 /*
 uint64_t database_api::get_account_transfer_history_count( string account,uint32_t type )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
 
       const auto& a = my->_db.get_account(account);
@@ -1051,7 +1209,7 @@ uint64_t database_api::get_account_transfer_history_count( string account,uint32
 
 map< uint32_t, applied_operation > database_api::get_account_token_symbol_transfer_history( string account, string symbol, uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       FC_ASSERT( from >= limit, "From must be greater than limit" );
@@ -1065,16 +1223,9 @@ map< uint32_t, applied_operation > database_api::get_account_token_symbol_transf
          token_symbol |= uint64_t(ch) << (i + 1) * 8;
       }
 
-      const auto& idx = my->_db.get_index<account_history_index>().indices().get<by_account_token>();
-      auto itr = idx.lower_bound( boost::make_tuple( account, 3, token_symbol, from ) );
-      auto end = idx.upper_bound( boost::make_tuple( account, 3, token_symbol, std::max( int64_t(0), int64_t(itr->token_seq)-limit ) ) );
- 
       map<uint32_t, applied_operation> result;
-      while( itr != end )
-      {
-         result[itr->token_seq] = my->_db.get(itr->op);
-         ++itr;
-      }
+      for( const auto& item : my->_db.get_history_store().get_sequence( account_history_key( account, 3, token_symbol ), from, limit ) )
+         result[item.first] = item.second;
       return result;
  
    });
@@ -1082,21 +1233,14 @@ map< uint32_t, applied_operation > database_api::get_account_token_symbol_transf
 
 map< uint32_t, applied_operation > database_api::get_account_token_transfer_history( string account, uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       FC_ASSERT( from >= limit, "From must be greater than limit" );
 
-      const auto& idx = my->_db.get_index<account_history_index>().indices().get<by_account_op_tag>();
-      auto itr = idx.lower_bound( boost::make_tuple( account, 3, from ) );
-      auto end = idx.upper_bound( boost::make_tuple( account, 3, std::max( int64_t(0), int64_t(itr->op_seq)-limit ) ) );
- 
       map<uint32_t, applied_operation> result;
-      while( itr != end )
-      {
-         result[itr->op_seq] = my->_db.get(itr->op);
-         ++itr;
-      }
+      for( const auto& item : my->_db.get_history_store().get_sequence( account_history_key( account, 3 ), from, limit ) )
+         result[item.first] = item.second;
       return result;
  
    });
@@ -1104,24 +1248,14 @@ map< uint32_t, applied_operation > database_api::get_account_token_transfer_hist
 
 map< uint32_t, applied_operation > database_api::get_account_transfer_history( string account, uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       FC_ASSERT( from >= limit, "From must be greater than limit" );
 
-      const auto& idx = my->_db.get_index<account_history_index>().indices().get<by_account_op_tag>();
-      auto itr = idx.lower_bound( boost::make_tuple( account, 1, from ) );
-      auto end = idx.upper_bound( boost::make_tuple( account, 1, std::max( int64_t(0), int64_t(itr->op_seq)-limit ) ) );
-
-      //auto itr = idx.lower_bound( boost::make_tuple( account, operation::tag<transfer_operation>::value, from ) );
-      //auto end = idx.upper_bound( boost::make_tuple( account, operation::tag<transfer_operation>::value, std::max( int64_t(0), int64_t(itr->op_seq)-limit ) ) );
-
       map<uint32_t, applied_operation> result;
-      while( itr != end )
-      {
-         result[itr->op_seq] = my->_db.get(itr->op);
-         ++itr;
-      }
+      for( const auto& item : my->_db.get_history_store().get_sequence( account_history_key( account, 1 ), from, limit ) )
+         result[item.first] = item.second;
       return result;
 
    
@@ -1204,46 +1338,31 @@ map< uint32_t, applied_operation > database_api::get_account_transfer_history( s
 
 map< uint32_t, applied_operation > database_api::get_account_history( string account, uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       FC_ASSERT( from >= limit, "From must be greater than limit" );
    //   idump((account)(from)(limit));
-      const auto& idx = my->_db.get_index<account_history_index>().indices().get<by_account>();
-      auto itr = idx.lower_bound( boost::make_tuple( account, from ) );
-   //   if( itr != idx.end() ) idump((*itr));
-      auto end = idx.upper_bound( boost::make_tuple( account, std::max( int64_t(0), int64_t(itr->sequence)-limit ) ) );
-   //   if( end != idx.end() ) idump((*end));
-
       map<uint32_t, applied_operation> result;
-      while( itr != end )
-      {
-         result[itr->sequence] = my->_db.get(itr->op);
-         ++itr;
-      }
+      for( const auto& item : my->_db.get_history_store().get_sequence( account_history_key( account ), from, limit ) )
+         result[item.first] = item.second;
       return result;
    });
 }
 
 vector< operation > database_api::get_history_by_opname( string account, string op_name )const 
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
-      const auto& idx = my->_db.get_index<account_history_index>().indices().get<by_account>();
-      auto itr = idx.lower_bound(boost::make_tuple( account, -1 ));
-      auto end = idx.upper_bound( boost::make_tuple( account, std::max( int64_t(0), int64_t(itr->sequence)-10000 ) ) );
       vector<operation> result;
-      applied_operation temp;
 
-      while( itr != end )
+      for( const auto& item : my->_db.get_history_store().get_sequence( account_history_key( account ), uint64_t(-1), 10000 ) )
       {
-         temp = my->_db.get(itr->op);
-         const auto& tempop = temp.op;
+         const auto& tempop = item.second.op;
          fc::string opname = get_op_name(tempop);
          if (opname.find(op_name.c_str(),0) != fc::string::npos) {
             result.push_back(tempop);
          }
-         ++itr;
       }
       return result;
    });
@@ -1251,7 +1370,7 @@ vector< operation > database_api::get_history_by_opname( string account, string
 
 vector< account_name_type > database_api::get_active_bobservers()const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       const auto& wso = my->_db.get_bobserver_schedule_object();
       size_t n = wso.current_shuffled_bobservers.size();
@@ -1265,66 +1384,51 @@ vector< account_name_type > database_api::get_active_bobservers()const
 
 uint64_t database_api::get_transaction_count(uint32_t block)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
-      const auto& idx = my->_db.get_index< operation_index >().indices().get< by_location >();
+      const auto* head = my->_db.find_block_stats( my->_db.head_block_num() );
+      if( head == nullptr )
+         return uint64_t( 0 );
 
       if ( block > 0 )
       {
          FC_ASSERT( (my->_db.head_block_num() - block) <= 30000, "block ${l} is lass than head_block_num - 30000", ("l",block) );
-         auto itr = idx.rbegin();
-         auto end = idx.rend();
-
-         uint64_t cnt = 0;
-         while( itr != end && itr->block > block)
-         {
-            cnt++;
-            ++itr;
-         }
-
-         return cnt;
+         const auto* from = my->_db.find_block_stats( block );
+         return head->total_operations - ( from ? from->total_operations : 0 );
       }
       else
       {
-         return idx.size();
+         return head->total_operations;
       }
    });
 }
 
 map< uint32_t, uint64_t > database_api::get_transaction_day_count(uint32_t day)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
-      const auto& idx = my->_db.get_index< operation_index >().indices().get< by_location >();
-
-      uint32_t day_per_block = (60 / 3) * 60 * 24;
-
       FC_ASSERT( day <= 15, "day ${l} is lass than 15 days", ("l",day) );
-      auto itr = idx.rbegin();
-      auto end = idx.rend();
 
+      auto total_operations = [&]( uint32_t block ) -> uint64_t
+      {
+         const auto* stats = my->_db.find_block_stats( block );
+         return stats ? stats->total_operations : 0;
+      };
+
+      // Each day is the SIGMAENGINE_BLOCKS_PER_DAY blocks ending where the following day begins, counting back from the head block
       map<uint32_t, uint64_t> result;
       uint32_t start = my->_db.head_block_num();
-      while(itr != end && day >= 0 && start > 0)
+      while( start > 0 )
       {
-         uint64_t cnt = 0;
-         uint64_t target = start - day_per_block;
-         while( itr != end && itr->block >= target )
-         {
-            cnt++;
-            ++itr;
-         }
-
-//         ilog("${day} : ${cnt}", ("day", day)("cnt", cnt));
+         uint32_t target = start > SIGMAENGINE_BLOCKS_PER_DAY ? start - SIGMAENGINE_BLOCKS_PER_DAY : 0;
+         result[day] = total_operations( start ) - total_operations( target );
 
          start = target;
-         result[day] = cnt;
          if ( day == 0 )
          {
             break;
          }
          day--;
-         
       }
       return result;
    });
@@ -1335,16 +1439,15 @@ annotated_signed_transaction database_api::get_transaction( transaction_id_type
 #ifdef SKIP_BY_TX_ID
    FC_ASSERT( false, "This node's operator has disabled operation indexing by transaction_id" );
 #else
-   return my->_db.with_read_lock( [&](){
-      const auto& idx = my->_db.get_index<operation_index>().indices().get<by_transaction_id>();
-      auto itr = idx.lower_bound( id );
-      if( itr != idx.end() && itr->trx_id == id ) {
-         auto blk = my->_db.fetch_block_by_number( itr->block );
+   return my->with_read_lock( [&](){
+      auto location = my->_db.get_history_store().find_transaction( id );
+      if( location.valid() ) {
+         auto blk = my->_db.fetch_block_by_number( location->first );
          FC_ASSERT( blk.valid() );
-         FC_ASSERT( blk->transactions.size() > itr->trx_in_block );
-         annotated_signed_transaction result = blk->transactions[itr->trx_in_block];
-         result.block_num       = itr->block;
-         result.transaction_num = itr->trx_in_block;
+         FC_ASSERT( blk->transactions.size() > location->second );
+         annotated_signed_transaction result = blk->transactions[location->second];
+         result.block_num       = location->first;
+         result.transaction_num = location->second;
          return result;
       }
       
@@ -1355,7 +1458,7 @@ annotated_signed_transaction database_api::get_transaction( transaction_id_type
 
 string database_api::get_auth_token( string account, string authtype)const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       account_auth_api_obj result;
 
@@ -1368,7 +1471,7 @@ string database_api::get_auth_token( string account, string authtype)const
 
 vector<account_auth_api_obj> database_api::get_auth_token_list( uint64_t from, uint32_t limit )const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       FC_ASSERT( from >= 0, "From must be greater than -1" );
@@ -1397,9 +1500,14 @@ uint32_t database_api::get_free_memory()
    return my->_db.get_free_memory_gb();
 }
 
+read_api_pool_stats database_api::get_read_api_pool_stats()const
+{
+   return my->_read_api_pool ? my->_read_api_pool->get_stats() : read_api_pool_stats();
+}
+
 vector<mining_reward_turn_api_obj> database_api::get_reward_turn_list(uint32_t from, uint32_t limit) const
 {
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
       //FC_ASSERT( from >= limit, "From must be greater than limit" );
@@ -1429,7 +1537,7 @@ map< uint32_t, account_mining_balance_api_obj > database_api::get_mining_account
 {
    FC_ASSERT( limit <= 10000, "Limit of ${l} is greater than maxmimum allowed", ("l",limit) );
 
-   return my->_db.with_read_lock( [&]()
+   return my->with_read_lock( [&]()
    {
       const auto& idx = my->_db.get_index< account_index >().indices().get< by_mining >();
 
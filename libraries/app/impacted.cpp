@@ -41,7 +41,8 @@ struct get_impacted_account_visitor
 {
    flat_set<account_name_type>& _impacted;
    chain::database& _db;
-   get_impacted_account_visitor( chain::database& db, flat_set<account_name_type>& impact ): _impacted( impact ), _db( db ) {}
+   const chain::operation_notification& _note;
+   get_impacted_account_visitor( chain::database& db, const chain::operation_notification& note, flat_set<account_name_type>& impact ): _impacted( impact ), _db( db ), _note( note ) {}
    typedef void result_type;
 
    template<typename T>
@@ -108,12 +109,12 @@ struct get_impacted_account_visitor
 
    void operator()( const custom_json_operation& op) {
       dlog("IMPACT : custom_json_operation ");
-      get_impacted_account_from_custom( op, _impacted );
+      get_impacted_account_from_custom( _note, _impacted );
    }
 
    void operator()( const custom_json_dapp_operation& op) {
       dlog("IMPACT : custom_json_dapp_operation ");
-      get_impacted_account_from_custom( op, _impacted );
+      get_impacted_account_from_custom( _note, _impacted );
    }
 
    void operator()( const custom_binary_operation& op) {
@@ -373,17 +374,13 @@ struct get_account_visitor_from_custom
 };
 
 template< typename OPERATION_TYPE, typename VISITOR >
-void process_inner_operation( const fc::variant var, VISITOR visitor ){
+void process_inner_operation( const chain::operation_notification& note, VISITOR visitor ){
    try {
-      std::vector< OPERATION_TYPE > operations;
-      if( var.is_array() && var.size() > 0 && var.get_array()[0].is_array() ) {
-         from_variant( var, operations );
-      } else {
-         operations.emplace_back();
-         from_variant( var, operations[0] );
-      }
+      const auto* operations = note.find_inner_operations< OPERATION_TYPE >();
+      if( operations == nullptr )
+         return;
 
-      for( const OPERATION_TYPE& inner_o : operations ) {
+      for( const OPERATION_TYPE& inner_o : *operations ) {
          inner_o.visit( visitor );
       }
    } catch( const fc::exception& ) { }
@@ -405,20 +402,10 @@ void process_inner_operation( vector< char > data, VISITOR visitor ){
    } catch( const fc::exception& ) { }
 }
 
-void get_impacted_account_from_custom( const custom_json_dapp_operation& op, flat_set< account_name_type >& result ) {
-   auto var = fc::json::from_string( op.json );
-
-   process_inner_operation< dapp_operation >( var, get_account_visitor_from_custom( result ) );
-   process_inner_operation< token_operation >( var, get_account_visitor_from_custom( result ) );
-   process_inner_operation< bobserver_plugin_operation >( var, get_account_visitor_from_custom( result ) );
-}
-
-void get_impacted_account_from_custom( const custom_json_operation& op, flat_set< account_name_type >& result ) {
-   auto var = fc::json::from_string( op.json );
-
-   process_inner_operation< dapp_operation >( var, get_account_visitor_from_custom( result ) );
-   process_inner_operation< token_operation >( var, get_account_visitor_from_custom( result ) );
-   process_inner_operation< bobserver_plugin_operation, get_account_visitor_from_custom >( var, get_account_visitor_from_custom( result ) );
+void get_impacted_account_from_custom( const chain::operation_notification& note, flat_set< account_name_type >& result ) {
+   process_inner_operation< dapp_operation >( note, get_account_visitor_from_custom( result ) );
+   process_inner_operation< token_operation >( note, get_account_visitor_from_custom( result ) );
+   process_inner_operation< bobserver_plugin_operation >( note, get_account_visitor_from_custom( result ) );
 }
 
 void get_impacted_account_from_custom( const custom_binary_operation& op, flat_set< account_name_type >& result ) {
@@ -431,8 +418,13 @@ void get_impacted_account_from_custom( const custom_binary_operation& op, flat_s
 // template<>
 void operation_get_impacted_accounts( const operation& op, chain::database& db, flat_set<account_name_type>& result )
 {
-   get_impacted_account_visitor vtor = get_impacted_account_visitor( db, result );
-   op.visit( vtor );
+   operation_get_impacted_accounts( chain::operation_notification( op ), db, result );
+}
+
+void operation_get_impacted_accounts( const chain::operation_notification& note, chain::database& db, flat_set<account_name_type>& result )
+{
+   get_impacted_account_visitor vtor = get_impacted_account_visitor( db, note, result );
+   note.op.visit( vtor );
 }
 
 void transaction_get_impacted_accounts( const transaction& tx, chain::database& db, flat_set<account_name_type>& result )
@@ -25,6 +25,7 @@
 
 #include <sigmaengine/app/api_access.hpp>
 #include <sigmaengine/app/api_context.hpp>
+#include <sigmaengine/app/read_api_pool.hpp>
 #include <sigmaengine/chain/database.hpp>
 
 #include <graphene/net/node.hpp>
@@ -84,6 +85,9 @@ namespace sigmaengine { namespace app {
 
          graphene::net::node_ptr                    p2p_node();
          std::shared_ptr<chain::database> chain_database()const;
+
+         /// Worker threads for read-only API calls, null when they run on the thread that applies blocks
+         std::shared_ptr<read_api_pool>   get_read_api_pool()const;
          //std::shared_ptr<graphene::db::object_database> pending_trx_database() const;
 
          void set_block_production(bool producing_blocks);
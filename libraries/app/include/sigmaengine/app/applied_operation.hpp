@@ -1,14 +1,14 @@
 #pragma once
 
 #include <sigmaengine/protocol/operations.hpp>
-#include <sigmaengine/chain/sigmaengine_object_types.hpp>
+#include <sigmaengine/chain/history_store.hpp>
 
 namespace sigmaengine { namespace app {
 
 struct applied_operation
 {
    applied_operation();
-   applied_operation( const sigmaengine::chain::operation_object& op_obj );
+   applied_operation( const sigmaengine::chain::history_operation& op_obj );
 
    sigmaengine::protocol::transaction_id_type trx_id;
    uint32_t                               block = 0;
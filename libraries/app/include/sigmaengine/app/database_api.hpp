@@ -1,11 +1,12 @@
 #pragma once
 #include <sigmaengine/app/applied_operation.hpp>
+#include <sigmaengine/app/read_api_pool.hpp>
 #include <sigmaengine/app/state.hpp>
 
 #include <sigmaengine/chain/database.hpp>
 #include <sigmaengine/chain/sigmaengine_objects.hpp>
 #include <sigmaengine/chain/sigmaengine_object_types.hpp>
-#include <sigmaengine/chain/history_object.hpp>
+#include <sigmaengine/chain/history_store.hpp>
 
 #include <sigmaengine/bobserver/bobserver_plugin.hpp>
 
@@ -256,6 +257,42 @@ class database_api
       map<uint32_t, applied_operation> get_account_history( string account, uint64_t from, uint32_t limit )const;
       map< uint32_t, optional<signed_block_api_obj>> get_block_range(uint32_t block_num, uint16_t num)const;
 
+      /////////////
+      // Streams //
+      /////////////
+
+      /**
+       * @brief Send blocks first_block to first_block + count - 1 to cb, oldest first, as arrays of
+       *        [block_num, block] pairs
+       *
+       * Every chunk is read under its own read lock and sent as a notice as soon as it is read, so
+       * only one chunk is in memory at a time on either side. A call sends at most 1000 blocks and
+       * stops at the head block.
+       *
+       * @return An opaque cursor to pass to resume_stream for the rest, empty when nothing is left
+       */
+      string stream_block_range( std::function<void(const variant&)> cb, uint32_t first_block, uint32_t count )const;
+
+      /**
+       * @brief Send count operations to cb, starting at index from of get_operation_list and going back in time,
+       *        as arrays of [operation_num, operation] pairs. A call sends at most 10000 operations.
+       *
+       * Operations are keyed by operation number, which unlike the index of get_operation_list does
+       * not move as new operations are added, so a resumed stream continues where it stopped.
+       */
+      string stream_operation_list( std::function<void(const variant&)> cb, uint64_t from, uint64_t count )const;
+
+      /**
+       * @brief Send count operations of an account to cb, starting at sequence number from and going back in
+       *        time, as arrays of [sequence, operation] pairs. A call sends at most 10000 operations.
+       */
+      string stream_account_history( std::function<void(const variant&)> cb, string account, uint64_t from, uint64_t count )const;
+
+      /**
+       * @brief Continue the stream that returned cursor
+       */
+      string resume_stream( std::function<void(const variant&)> cb, string cursor )const;
+
       vector< operation > get_history_by_opname( string account, string op_name )const; 
 
       ////////////////////////////
@@ -269,11 +306,24 @@ class database_api
 
       map<uint32_t, applied_operation> get_operation_list( uint64_t from, uint32_t limit )const;
       map< uint32_t, account_balance_api_obj > get_balance_rank( uint64_t from, uint32_t limit )const;
+
+      /**
+       * @brief Position of an account in the balance ranking used by get_balance_rank
+       * @return the zero based rank, or null if the account does not exist
+       */
+      optional< uint32_t > get_account_balance_rank( string account )const;
+
       asset get_total_supply() const;
       asset get_dapp_transaction_fee() const;
 
       uint32_t get_free_memory();
 
+      /**
+       * @brief Queue depth and latency of the threads serving read-only calls, all zero when calls
+       *        run on the thread that applies blocks
+       */
+      read_api_pool_stats get_read_api_pool_stats()const;
+
       vector<mining_reward_turn_api_obj> get_reward_turn_list(uint32_t from, uint32_t limit) const;
       map< uint32_t, account_mining_balance_api_obj > get_mining_accounts(uint32_t from, uint32_t limit)const;
 
@@ -347,6 +397,7 @@ FC_API(sigmaengine::app::database_api,
 
    (get_operation_list)
    (get_balance_rank)
+   (get_account_balance_rank)
 
    (get_total_supply)
    (get_dapp_transaction_fee)
@@ -357,7 +408,14 @@ FC_API(sigmaengine::app::database_api,
    (get_transaction_day_count)
    (get_block_range)
 
+   // Streams
+   (stream_block_range)
+   (stream_operation_list)
+   (stream_account_history)
+   (resume_stream)
+
    (get_free_memory)
+   (get_read_api_pool_stats)
 
    (get_reward_turn_list)
    (get_mining_accounts)
@@ -27,6 +27,7 @@
 #include <sigmaengine/protocol/operations.hpp>
 #include <sigmaengine/protocol/transaction.hpp>
 #include <sigmaengine/chain/sigmaengine_object_types.hpp>
+#include <sigmaengine/chain/operation_notification.hpp>
 #include <sigmaengine/bobserver/bobserver_operations.hpp>
 #include <sigmaengine/token/token_operations.hpp>
 #include <sigmaengine/dapp/dapp_operations.hpp>
@@ -42,13 +43,12 @@ using namespace sigmaengine::token;
 using namespace sigmaengine::dapp;
 
 template< typename OPERATION_TYPE, typename VISITOR >
-void process_inner_operation( const fc::variant var, VISITOR visitor );
+void process_inner_operation( const chain::operation_notification& note, VISITOR visitor );
 
 template< typename OPERATION_TYPE, typename VISITOR >
 void process_inner_operation( vector< char > data, VISITOR visitor );
 
-void get_impacted_account_from_custom( const custom_json_dapp_operation& op, fc::flat_set< protocol::account_name_type >& result );
-void get_impacted_account_from_custom( const custom_json_operation& op, fc::flat_set< protocol::account_name_type >& result );
+void get_impacted_account_from_custom( const chain::operation_notification& note, fc::flat_set< protocol::account_name_type >& result );
 void get_impacted_account_from_custom( const custom_binary_operation& op, fc::flat_set< protocol::account_name_type >& result );
 
 void operation_get_impacted_accounts(
@@ -56,6 +56,12 @@ void operation_get_impacted_accounts(
    chain::database& db,
    fc::flat_set<protocol::account_name_type>& result );
 
+/// Same as above, reusing the custom json inner operations already decoded for the notification
+void operation_get_impacted_accounts(
+   const chain::operation_notification& note,
+   chain::database& db,
+   fc::flat_set<protocol::account_name_type>& result );
+
 void transaction_get_impacted_accounts(
    const sigmaengine::protocol::transaction& tx,
    chain::database& db,
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace sigmaengine { namespace app {
+
+   struct read_api_pool_stats
+   {
+      uint32_t threads = 0;
+      uint32_t queue_depth = 0;        ///< calls queued or running right now
+      uint32_t max_queue_depth = 0;
+      uint64_t calls = 0;
+      uint64_t average_wait_us = 0;    ///< time from queueing a call to a worker starting on it
+      uint64_t max_wait_us = 0;
+      uint64_t average_run_us = 0;     ///< time a worker spends on a call, waiting for the read lock included
+      uint64_t max_run_us = 0;
+   };
+
+   /**
+    * Runs read-only API calls on a fixed set of worker threads instead of the thread that handles
+    * the websocket connections, which is the thread blocks are applied on. The calling task waits
+    * for the result, which lets the websocket thread serve other calls and apply blocks meanwhile.
+    * Workers take the database read lock themselves, so calls on different workers read in
+    * parallel, and each call reads one state between two writes. The writer waits at most its one
+    * second lock wait for them, a call still reading then fails instead of delaying the block.
+    */
+   class read_api_pool
+   {
+      public:
+         explicit read_api_pool( uint32_t threads );
+         ~read_api_pool();
+
+         /// Run callback on a worker and return its result, or run it right away when called from a worker
+         template< typename Lambda >
+         auto run( Lambda&& callback ) -> typename std::enable_if< !std::is_void< decltype( callback() ) >::value, decltype( callback() ) >::type
+         {
+            std::unique_ptr< decltype( callback() ) > result;
+            run_on_worker( [&]() { result.reset( new decltype( callback() )( callback() ) ); } );
+            return std::move( *result );
+         }
+
+         template< typename Lambda >
+         auto run( Lambda&& callback ) -> typename std::enable_if< std::is_void< decltype( callback() ) >::value >::type
+         {
+            run_on_worker( callback );
+         }
+
+         read_api_pool_stats get_stats()const;
+
+      private:
+         void run_on_worker( const std::function< void() >& call );
+         fc::thread& next_thread();
+         bool on_worker_thread()const;
+
+         void call_queued();
+         void call_started( fc::microseconds wait );
+         void call_ran( fc::microseconds run );
+         void call_finished();
+
+         std::vector< std::unique_ptr< fc::thread > > _threads;
+         std::atomic< uint32_t >                       _next_thread;
+
+         mutable std::mutex                            _stats_mutex;
+         read_api_pool_stats                           _stats;
+         uint64_t                                      _total_wait_us = 0;
+         uint64_t                                      _total_run_us = 0;
+   };
+
+} }
+
+FC_REFLECT( sigmaengine::app::read_api_pool_stats,
+   (threads)(queue_depth)(max_queue_depth)(calls)(average_wait_us)(max_wait_us)(average_run_us)(max_run_us) )
@@ -2,7 +2,6 @@
 #include <sigmaengine/chain/account_object.hpp>
 #include <sigmaengine/chain/block_summary_object.hpp>
 #include <sigmaengine/chain/global_property_object.hpp>
-#include <sigmaengine/chain/history_object.hpp>
 #include <sigmaengine/chain/sigmaengine_objects.hpp>
 #include <sigmaengine/chain/transaction_object.hpp>
 #include <sigmaengine/chain/bobserver_objects.hpp>
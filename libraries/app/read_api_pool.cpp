@@ -0,0 +1,97 @@
+#include <sigmaengine/app/read_api_pool.hpp>
+
+#include <fc/scoped_exit.hpp>
+
+#include <algorithm>
+
+namespace sigmaengine { namespace app {
+
+   read_api_pool::read_api_pool( uint32_t threads )
+   :_next_thread( 0 )
+   {
+      for( uint32_t i = 0; i < threads; ++i )
+         _threads.emplace_back( new fc::thread( "read_api_" + std::to_string( i ) ) );
+      _stats.threads = threads;
+   }
+
+   read_api_pool::~read_api_pool()
+   {
+      for( auto& t : _threads )
+         t->quit();
+   }
+
+   void read_api_pool::run_on_worker( const std::function< void() >& call )
+   {
+      // A call made from a worker runs where it is, waiting for another worker could deadlock
+      if( on_worker_thread() )
+      {
+         call();
+         return;
+      }
+
+      fc::time_point queued = fc::time_point::now();
+      call_queued();
+      auto finish = fc::make_scoped_exit( [&]() { call_finished(); } );
+
+      next_thread().async( [&]()
+      {
+         fc::time_point started = fc::time_point::now();
+         call_started( started - queued );
+         auto record_run = fc::make_scoped_exit( [&]() { call_ran( fc::time_point::now() - started ); } );
+         call();
+      }, "read_api_call" ).wait();
+   }
+
+   fc::thread& read_api_pool::next_thread()
+   {
+      return *_threads[ _next_thread++ % _threads.size() ];
+   }
+
+   bool read_api_pool::on_worker_thread()const
+   {
+      const fc::thread* current = &fc::thread::current();
+      return std::any_of( _threads.begin(), _threads.end(),
+         [current]( const std::unique_ptr< fc::thread >& t ) { return t.get() == current; } );
+   }
+
+   void read_api_pool::call_queued()
+   {
+      std::lock_guard< std::mutex > lock( _stats_mutex );
+      ++_stats.queue_depth;
+      _stats.max_queue_depth = std::max( _stats.max_queue_depth, _stats.queue_depth );
+   }
+
+   void read_api_pool::call_started( fc::microseconds wait )
+   {
+      std::lock_guard< std::mutex > lock( _stats_mutex );
+      ++_stats.calls;
+      _total_wait_us += wait.count();
+      _stats.max_wait_us = std::max< uint64_t >( _stats.max_wait_us, wait.count() );
+   }
+
+   void read_api_pool::call_ran( fc::microseconds run )
+   {
+      std::lock_guard< std::mutex > lock( _stats_mutex );
+      _total_run_us += run.count();
+      _stats.max_run_us = std::max< uint64_t >( _stats.max_run_us, run.count() );
+   }
+
+   void read_api_pool::call_finished()
+   {
+      std::lock_guard< std::mutex > lock( _stats_mutex );
+      --_stats.queue_depth;
+   }
+
+   read_api_pool_stats read_api_pool::get_stats()const
+   {
+      std::lock_guard< std::mutex > lock( _stats_mutex );
+      read_api_pool_stats result = _stats;
+      if( result.calls )
+      {
+         result.average_wait_us = _total_wait_us / result.calls;
+         result.average_run_us = _total_run_us / result.calls;
+      }
+      return result;
+   }
+
+} } // sigmaengine::app
@@ -2,83 +2,171 @@
 #include <fstream>
 #include <fc/io/raw.hpp>
 
-#define LOG_READ  (std::ios::in | std::ios::binary)
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
 namespace sigmaengine { namespace chain {
 
+   namespace bip = boost::interprocess;
+
    namespace detail {
+      typedef std::shared_ptr< const bip::mapped_region > mapping_ptr;
+
       class block_log_impl {
          public:
             optional< signed_block > head;
             block_id_type            head_id;
-            std::fstream             block_stream;
-            std::fstream             index_stream;
+            std::ofstream            block_stream;
+            std::ofstream            index_stream;
+            std::ofstream            header_stream;
             fc::path                 block_file;
             fc::path                 index_file;
-            bool                     block_write = false;
-            bool                     index_write = false;
-
-            inline void check_block_read()
+            fc::path                 header_file;
+
+            /*
+             * Appends only ever happen on the writer thread. Readers look at the atomics below to
+             * learn how much of each file has been flushed, and read through a read only mapping of
+             * the files. A mapping is replaced, never modified, when the file outgrows it, so a
+             * reader holding an older mapping can keep using it.
+             */
+            std::atomic< uint32_t >  head_num{ 0 };
+            std::atomic< uint64_t >  block_end{ 0 };
+            std::atomic< uint64_t >  index_end{ 0 };
+            std::atomic< uint64_t >  header_end{ 0 };
+
+            mutable mapping_ptr      block_mapping;
+            mutable mapping_ptr      index_mapping;
+            mutable mapping_ptr      header_mapping;
+            mutable std::mutex       remap_mutex;
+
+            mapping_ptr get_mapping( mapping_ptr& slot, const fc::path& file, uint64_t required_size, uint64_t file_size )const
             {
-               try
+               FC_ASSERT( required_size > 0 && required_size <= file_size, "Read past the end of ${f}", ("f", file)("required", required_size)("size", file_size) );
+
+               mapping_ptr m = std::atomic_load( &slot );
+               if( m && m->get_size() >= required_size )
+                  return m;
+
+               std::lock_guard< std::mutex > lock( remap_mutex );
+               m = std::atomic_load( &slot );
+               if( !m || m->get_size() < required_size )
                {
-                  if( block_write )
-                  {
-                     block_stream.close();
-                     block_stream.open( block_file.generic_string().c_str(), LOG_READ );
-                     block_write = false;
-                  }
+                  bip::file_mapping fm( file.generic_string().c_str(), bip::read_only );
+                  m = std::make_shared< const bip::mapped_region >( fm, bip::read_only, 0, file_size );
+                  std::atomic_store( &slot, m );
                }
-               FC_LOG_AND_RETHROW()
+               return m;
             }
 
-            inline void check_block_write()
+            mapping_ptr get_block_mapping( uint64_t required_size )const
             {
-               try
-               {
-                  if( !block_write )
-                  {
-                     block_stream.close();
-                     block_stream.open( block_file.generic_string().c_str(), LOG_WRITE );
-                     block_write = true;
-#ifdef WIN32
-					 block_stream.seekp(0, std::ios::end);
-#endif
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               return get_mapping( block_mapping, block_file, required_size, block_end.load( std::memory_order_acquire ) );
             }
 
-            inline void check_index_read()
+            mapping_ptr get_index_mapping( uint64_t required_size )const
             {
-               try
-               {
-                  if( index_write )
-                  {
-                     index_stream.close();
-                     index_stream.open( index_file.generic_string().c_str(), LOG_READ );
-                     index_write = false;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               return get_mapping( index_mapping, index_file, required_size, index_end.load( std::memory_order_acquire ) );
             }
 
-            inline void check_index_write()
+            mapping_ptr get_header_mapping( uint64_t required_size )const
             {
-               try
-               {
-                  if( !index_write )
-                  {
-                     index_stream.close();
-                     index_stream.open( index_file.generic_string().c_str(), LOG_WRITE );
-                     index_write = true;
-#ifdef WIN32
-					 index_stream.seekp(0, std::ios::end);
-#endif
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               return get_mapping( header_mapping, header_file, required_size, header_end.load( std::memory_order_acquire ) );
+            }
+
+            static uint64_t read_u64( const mapping_ptr& m, uint64_t offset )
+            {
+               uint64_t result;
+               memcpy( (char*)&result, (const char*)m->get_address() + offset, sizeof( result ) );
+               return result;
+            }
+
+            void reset_mappings()
+            {
+               std::lock_guard< std::mutex > lock( remap_mutex );
+               std::atomic_store( &block_mapping, mapping_ptr() );
+               std::atomic_store( &index_mapping, mapping_ptr() );
+               std::atomic_store( &header_mapping, mapping_ptr() );
+            }
+
+            void open_index_for_write()
+            {
+               index_stream.open( index_file.generic_string().c_str(), LOG_WRITE );
+               index_end.store( fc::file_size( index_file ), std::memory_order_release );
+            }
+
+            void open_headers_for_write()
+            {
+               header_stream.open( header_file.generic_string().c_str(), LOG_WRITE );
+               header_end.store( fc::file_size( header_file ), std::memory_order_release );
+            }
+
+            static const size_t bobserver_size = block_log::header_record_size - 20 - 4 - 4 - 4;
+            static_assert( bobserver_size >= SIGMAENGINE_MAX_ACCOUNT_NAME_LENGTH, "Header record cannot hold a bobserver name" );
+
+            /* Header records are written field by field so the file layout does not depend on struct
+             * padding. The bobserver name is stored zero padded. */
+            static void pack_header_record( const block_log::header_record& r, char* out )
+            {
+               memset( out, 0, block_log::header_record_size );
+               memcpy( out, r.id.data(), r.id.data_size() );
+               out += r.id.data_size();
+
+               uint32_t timestamp = r.timestamp.sec_since_epoch();
+               memcpy( out, (const char*)&timestamp, sizeof( timestamp ) );
+               out += sizeof( timestamp );
+
+               std::string bobserver = r.bobserver;
+               memcpy( out, bobserver.data(), std::min( bobserver.size(), size_t( bobserver_size ) ) );
+               out += bobserver_size;
+
+               memcpy( out, (const char*)&r.transaction_count, sizeof( r.transaction_count ) );
+               out += sizeof( r.transaction_count );
+               memcpy( out, (const char*)&r.byte_size, sizeof( r.byte_size ) );
+            }
+
+            static block_log::header_record unpack_header_record( const char* in )
+            {
+               block_log::header_record r;
+               memcpy( r.id.data(), in, r.id.data_size() );
+               in += r.id.data_size();
+
+               uint32_t timestamp;
+               memcpy( (char*)&timestamp, in, sizeof( timestamp ) );
+               r.timestamp = fc::time_point_sec( timestamp );
+               in += sizeof( timestamp );
+
+               r.bobserver = std::string( in, strnlen( in, bobserver_size ) );
+               in += bobserver_size;
+
+               memcpy( (char*)&r.transaction_count, in, sizeof( r.transaction_count ) );
+               in += sizeof( r.transaction_count );
+               memcpy( (char*)&r.byte_size, in, sizeof( r.byte_size ) );
+               return r;
+            }
+
+            /* Builds the record from the packed block. The transaction count directly follows the header,
+             * so none of the transactions are unpacked. */
+            static block_log::header_record make_header_record( const char* data, size_t size )
+            {
+               signed_block_header header;
+               fc::unsigned_int transaction_count;
+               fc::datastream< const char* > ds( data, size );
+               fc::raw::unpack( ds, header );
+               fc::raw::unpack( ds, transaction_count );
+
+               block_log::header_record r;
+               r.id = header.id();
+               r.timestamp = header.timestamp;
+               r.bobserver = header.bobserver;
+               r.transaction_count = transaction_count.value;
+               r.byte_size = size;
+               return r;
             }
       };
    }
@@ -88,6 +176,7 @@ namespace sigmaengine { namespace chain {
    {
       my->block_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
       my->index_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+      my->header_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
    }
 
    block_log::~block_log()
@@ -101,14 +190,17 @@ namespace sigmaengine { namespace chain {
          my->block_stream.close();
       if( my->index_stream.is_open() )
          my->index_stream.close();
+      if( my->header_stream.is_open() )
+         my->header_stream.close();
+      my->reset_mappings();
 
       my->block_file = file;
       my->index_file = fc::path( file.generic_string() + ".index" );
+      my->header_file = fc::path( file.generic_string() + ".headers" );
 
       my->block_stream.open( my->block_file.generic_string().c_str(), LOG_WRITE );
-      my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-      my->block_write = true;
-      my->index_write = true;
+      my->open_index_for_write();
+      my->open_headers_for_write();
 
       /* On startup of the block log, there are several states the log file and the index file can be
        * in relation to eachother.
@@ -130,6 +222,7 @@ namespace sigmaengine { namespace chain {
        */
       auto log_size = fc::file_size( my->block_file );
       auto index_size = fc::file_size( my->index_file );
+      my->block_end.store( log_size, std::memory_order_release );
 
       if( log_size )
       {
@@ -139,17 +232,9 @@ namespace sigmaengine { namespace chain {
 
          if( index_size )
          {
-            my->check_block_read();
-            my->check_index_read();
-
             ilog( "Index is nonempty" );
-            uint64_t block_pos;
-            my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
-            my->block_stream.read( (char*)&block_pos, sizeof( block_pos ) );
-
-            uint64_t index_pos;
-            my->index_stream.seekg( -sizeof( uint64_t), std::ios::end );
-            my->index_stream.read( (char*)&index_pos, sizeof( index_pos ) );
+            uint64_t block_pos = detail::block_log_impl::read_u64( my->get_block_mapping( log_size ), log_size - sizeof( uint64_t ) );
+            uint64_t index_pos = detail::block_log_impl::read_u64( my->get_index_mapping( index_size ), index_size - sizeof( uint64_t ) );
 
             if( block_pos < index_pos )
             {
@@ -167,14 +252,53 @@ namespace sigmaengine { namespace chain {
             ilog( "Index is empty" );
             construct_index();
          }
+
+         uint32_t head_num = my->head->block_num();
+         my->head_num.store( head_num, std::memory_order_release );
+
+         /* The header file is checked against the head of the log. A partial file whose last record
+          * matches the log is extended, anything else is rebuilt from scratch.
+          */
+         uint64_t header_size = my->header_end.load( std::memory_order_acquire );
+         uint64_t header_count = header_size / header_record_size;
+
+         if( header_count == 0 || header_count > head_num || header_size % header_record_size )
+         {
+            ilog( "Header index does not match the log, reconstructing it" );
+            construct_header_index( 1 );
+         }
+         else
+         {
+            auto last = read_header_by_num( header_count );
+            auto data = read_serialized_block_by_num( header_count );
+            if( last->id != detail::block_log_impl::make_header_record( data->data, data->size ).id )
+            {
+               ilog( "Header index head is not in the log, reconstructing it" );
+               construct_header_index( 1 );
+            }
+            else if( header_count < head_num )
+            {
+               ilog( "Header index is incomplete" );
+               construct_header_index( header_count + 1 );
+            }
+         }
       }
-      else if( index_size )
+      else
       {
-         ilog( "Index is nonempty, remove and recreate it" );
-         my->index_stream.close();
-         fc::remove_all( my->index_file );
-         my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-         my->index_write = true;
+         if( index_size )
+         {
+            ilog( "Index is nonempty, remove and recreate it" );
+            my->index_stream.close();
+            fc::remove_all( my->index_file );
+            my->open_index_for_write();
+         }
+
+         if( my->header_end.load( std::memory_order_acquire ) )
+         {
+            my->header_stream.close();
+            fc::remove_all( my->header_file );
+            my->open_headers_for_write();
+         }
       }
    }
 
@@ -192,18 +316,36 @@ namespace sigmaengine { namespace chain {
    {
       try
       {
-         my->check_block_write();
-         my->check_index_write();
-
-         uint64_t pos = my->block_stream.tellp();
-         uint64_t index_pos = my->index_stream.tellp();
-         FC_ASSERT( index_pos == sizeof( uint64_t ) * uint64_t( b.block_num() - 1 ), "Append to index file occuring at wrong position.", ( "position", (uint64_t) my->index_stream.tellp() )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
+         uint64_t pos = my->block_end.load( std::memory_order_relaxed );
+         uint64_t index_pos = my->index_end.load( std::memory_order_relaxed );
+         uint64_t header_pos = my->header_end.load( std::memory_order_relaxed );
+         FC_ASSERT( index_pos == sizeof( uint64_t ) * uint64_t( b.block_num() - 1 ), "Append to index file occuring at wrong position.", ( "position", index_pos )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
+         FC_ASSERT( header_pos == header_record_size * uint64_t( b.block_num() - 1 ), "Append to header file occuring at wrong position.", ( "position", header_pos )( "expected",( b.block_num() - 1 ) * header_record_size ) );
          auto data = fc::raw::pack( b );
+
+         header_record record;
+         record.id = b.id();
+         record.timestamp = b.timestamp;
+         record.bobserver = b.bobserver;
+         record.transaction_count = b.transactions.size();
+         record.byte_size = data.size();
+         char packed_record[ header_record_size ];
+         detail::block_log_impl::pack_header_record( record, packed_record );
+
          my->block_stream.write( data.data(), data.size() );
          my->block_stream.write( (char*)&pos, sizeof( pos ) );
          my->index_stream.write( (char*)&pos, sizeof( pos ) );
+         my->header_stream.write( packed_record, header_record_size );
+
+         // Readers only see what has reached the file, so publish the new sizes after flushing
+         flush();
+         my->block_end.store( pos + data.size() + sizeof( pos ), std::memory_order_release );
+         my->index_end.store( index_pos + sizeof( pos ), std::memory_order_release );
+         my->header_end.store( header_pos + header_record_size, std::memory_order_release );
+
          my->head = b;
-         my->head_id = b.id();
+         my->head_id = record.id;
+         my->head_num.store( b.block_num(), std::memory_order_release );
 
          return pos;
       }
@@ -212,20 +354,26 @@ namespace sigmaengine { namespace chain {
 
    void block_log::flush()
    {
-      my->block_stream.flush();
-      my->index_stream.flush();
+      if( my->block_stream.is_open() )
+         my->block_stream.flush();
+      if( my->index_stream.is_open() )
+         my->index_stream.flush();
+      if( my->header_stream.is_open() )
+         my->header_stream.flush();
    }
 
    std::pair< signed_block, uint64_t > block_log::read_block( uint64_t pos )const
    {
       try
       {
-         my->check_block_read();
+         uint64_t end = my->block_end.load( std::memory_order_acquire );
+         FC_ASSERT( pos < end, "Read past the end of the block log", ("pos", pos)("end", end) );
+         auto m = my->get_block_mapping( end );
 
-         my->block_stream.seekg( pos );
+         fc::datastream< const char* > ds( (const char*)m->get_address() + pos, end - pos );
          std::pair<signed_block,uint64_t> result;
-         fc::raw::unpack( my->block_stream, result.first );
-         result.second = uint64_t(my->block_stream.tellg()) + 8;
+         fc::raw::unpack( ds, result.first );
+         result.second = pos + ds.tellp() + 8;
          return result;
       }
       FC_LOG_AND_RETHROW()
@@ -236,10 +384,12 @@ namespace sigmaengine { namespace chain {
       try
       {
       optional< signed_block > b;
-      uint64_t pos = get_block_pos( block_num );
-      if( pos != npos )
+      auto data = read_serialized_block_by_num( block_num );
+      if( data.valid() )
       {
-         b = read_block( pos ).first;
+         b = signed_block();
+         fc::datastream< const char* > ds( data->data, data->size );
+         fc::raw::unpack( ds, *b );
          FC_ASSERT( b->block_num() == block_num , "Wrong block was read from block log.", ( "returned", b->block_num() )( "expected", block_num ));
       }
       return b;
@@ -247,18 +397,62 @@ namespace sigmaengine { namespace chain {
       FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   optional< block_log::serialized_block > block_log::read_serialized_block_by_num( uint32_t block_num )const
    {
       try
       {
-         my->check_index_read();
+         optional< serialized_block > result;
+
+         uint32_t head_num = my->head_num.load( std::memory_order_acquire );
+         if( block_num == 0 || block_num > head_num )
+            return result;
 
-         if( !( my->head.valid() && block_num <= protocol::block_header::num_from_id( my->head_id ) && block_num > 0 ) )
+         auto index = my->get_index_mapping( sizeof( uint64_t ) * block_num );
+         uint64_t pos = detail::block_log_impl::read_u64( index, sizeof( uint64_t ) * ( block_num - 1 ) );
+
+         // Each block is followed by its own 8 byte position, and then by the next block
+         uint64_t end;
+         if( block_num < head_num )
+            end = detail::block_log_impl::read_u64( my->get_index_mapping( sizeof( uint64_t ) * ( block_num + 1 ) ), sizeof( uint64_t ) * block_num );
+         else
+            end = my->block_end.load( std::memory_order_acquire );
+
+         FC_ASSERT( end >= pos + sizeof( uint64_t ), "Corrupt block log index", ("block_num", block_num)("pos", pos)("end", end) );
+         end -= sizeof( uint64_t );
+
+         auto m = my->get_block_mapping( end );
+         result = serialized_block();
+         result->data = (const char*)m->get_address() + pos;
+         result->size = end - pos;
+         result->mapping = m;
+         return result;
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   optional< block_log::header_record > block_log::read_header_by_num( uint32_t block_num )const
+   {
+      try
+      {
+         optional< header_record > result;
+         if( block_num == 0 || block_num > my->head_num.load( std::memory_order_acquire ) )
+            return result;
+
+         auto m = my->get_header_mapping( header_record_size * block_num );
+         result = detail::block_log_impl::unpack_header_record( (const char*)m->get_address() + header_record_size * ( block_num - 1 ) );
+         return result;
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   {
+      try
+      {
+         if( !( block_num <= my->head_num.load( std::memory_order_acquire ) && block_num > 0 ) )
             return npos;
-         my->index_stream.seekg( sizeof( uint64_t ) * ( block_num - 1 ) );
-         uint64_t pos;
-         my->index_stream.read( (char*)&pos, sizeof( pos ) );
-         return pos;
+         auto index = my->get_index_mapping( sizeof( uint64_t ) * block_num );
+         return detail::block_log_impl::read_u64( index, sizeof( uint64_t ) * ( block_num - 1 ) );
       }
       FC_LOG_AND_RETHROW()
    }
@@ -267,11 +461,9 @@ namespace sigmaengine { namespace chain {
    {
       try
       {
-         my->check_block_read();
-
-         uint64_t pos;
-         my->block_stream.seekg( -sizeof(pos), std::ios::end );
-         my->block_stream.read( (char*)&pos, sizeof(pos) );
+         uint64_t end = my->block_end.load( std::memory_order_acquire );
+         FC_ASSERT( end >= sizeof( uint64_t ), "Block log is empty" );
+         uint64_t pos = detail::block_log_impl::read_u64( my->get_block_mapping( end ), end - sizeof( uint64_t ) );
          return read_block( pos ).first;
       }
       FC_LOG_AND_RETHROW()
@@ -289,25 +481,52 @@ namespace sigmaengine { namespace chain {
          ilog( "Reconstructing Block Log Index..." );
          my->index_stream.close();
          fc::remove_all( my->index_file );
-         my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-         my->index_write = true;
+         my->reset_mappings();
+         my->open_index_for_write();
 
-         uint64_t pos = 0;
-         uint64_t end_pos;
-         my->check_block_read();
+         uint64_t log_size = my->block_end.load( std::memory_order_acquire );
+         auto m = my->get_block_mapping( log_size );
+         uint64_t end_pos = detail::block_log_impl::read_u64( m, log_size - sizeof( uint64_t ) );
 
-         my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
-         my->block_stream.read( (char*)&end_pos, sizeof( end_pos ) );
+         fc::datastream< const char* > ds( (const char*)m->get_address(), log_size );
          signed_block tmp;
+         uint64_t pos = 0;
 
-         my->block_stream.seekg( pos );
-
-         while( pos < end_pos )
+         do
          {
-            fc::raw::unpack( my->block_stream, tmp );
-            my->block_stream.read( (char*)&pos, sizeof( pos ) );
+            fc::raw::unpack( ds, tmp );
+            ds.read( (char*)&pos, sizeof( pos ) );
             my->index_stream.write( (char*)&pos, sizeof( pos ) );
+         } while( pos < end_pos );
+
+         my->index_stream.flush();
+         my->index_end.store( fc::file_size( my->index_file ), std::memory_order_release );
+      }
+      FC_LOG_AND_RETHROW()
+   }
+
+   void block_log::construct_header_index( uint32_t first_block )
+   {
+      try
+      {
+         uint32_t head_num = my->head_num.load( std::memory_order_acquire );
+         ilog( "Reconstructing Block Log Header Index from block ${b}...", ("b", first_block)("head", head_num) );
+         my->header_stream.close();
+         my->reset_mappings();
+         fc::resize_file( my->header_file, header_record_size * ( first_block - 1 ) );
+         my->open_headers_for_write();
+
+         char packed_record[ header_record_size ];
+         for( uint32_t block_num = first_block; block_num <= head_num; ++block_num )
+         {
+            auto data = read_serialized_block_by_num( block_num );
+            auto record = detail::block_log_impl::make_header_record( data->data, data->size );
+            detail::block_log_impl::pack_header_record( record, packed_record );
+            my->header_stream.write( packed_record, header_record_size );
          }
+
+         my->header_stream.flush();
+         my->header_end.store( fc::file_size( my->header_file ), std::memory_order_release );
       }
       FC_LOG_AND_RETHROW()
    }
@@ -0,0 +1,206 @@
+#include <sigmaengine/chain/block_prevalidator.hpp>
+#include <sigmaengine/protocol/config.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace sigmaengine { namespace chain {
+
+   namespace detail {
+      class block_prevalidator_impl {
+         public:
+            struct job
+            {
+               block_id_type                          id;
+               std::shared_ptr< const signed_block >  block;
+               bool                                   recover_transaction_keys;
+            };
+
+            struct entry
+            {
+               uint64_t                               sequence = 0;
+               bool                                   started = false;
+               prevalidated_block_ptr                 result;
+            };
+
+            std::vector< std::thread >                threads;
+
+            std::mutex                                mtx;
+            std::condition_variable                   work_cv;
+            std::condition_variable                   done_cv;
+            bool                                      stopping = false;
+
+            std::deque< job >                         queue;
+            std::map< block_id_type, entry >          entries;
+            std::map< uint64_t, block_id_type >       finished;    ///< finished entries by sequence
+            uint64_t                                  next_sequence = 0;
+            uint32_t                                  max_blocks = 0;
+
+            static prevalidated_block_ptr prevalidate( const signed_block& block, bool recover_transaction_keys )
+            {
+               auto result = std::make_shared< prevalidated_block >();
+               result->id = block.id();
+
+               try
+               {
+                  result->merkle_root = block.calculate_merkle_root();
+               }
+               catch( const fc::exception& ) {}
+
+               try
+               {
+                  result->signee = block.signee();
+               }
+               catch( const fc::exception& ) {}
+
+               if( recover_transaction_keys )
+               {
+                  result->transaction_keys.resize( block.transactions.size() );
+                  for( size_t i = 0; i < block.transactions.size(); ++i )
+                  {
+                     auto& keys = result->transaction_keys[i];
+                     try
+                     {
+                        keys.keys = block.transactions[i].get_signature_keys( SIGMAENGINE_CHAIN_ID );
+                     }
+                     catch( const fc::exception& e )
+                     {
+                        keys.error = e.dynamic_copy_exception();
+                     }
+                     catch( const std::exception& e )
+                     {
+                        keys.error = std::make_shared< fc::exception >( FC_LOG_MESSAGE( error, "${what}", ("what", e.what()) ) );
+                     }
+                  }
+               }
+
+               return result;
+            }
+
+            /// Drop the oldest finished results until there is room for one more block
+            void trim()
+            {
+               while( entries.size() >= max_blocks && !finished.empty() )
+               {
+                  entries.erase( finished.begin()->second );
+                  finished.erase( finished.begin() );
+               }
+            }
+
+            void work_loop()
+            {
+               while( true )
+               {
+                  job next;
+                  {
+                     std::unique_lock< std::mutex > lock( mtx );
+                     work_cv.wait( lock, [&]() { return stopping || !queue.empty(); } );
+                     if( stopping )
+                        return;
+                     next = std::move( queue.front() );
+                     queue.pop_front();
+
+                     auto itr = entries.find( next.id );
+                     if( itr == entries.end() )
+                        continue;
+                     itr->second.started = true;
+                  }
+
+                  auto result = prevalidate( *next.block, next.recover_transaction_keys );
+
+                  std::lock_guard< std::mutex > lock( mtx );
+                  auto itr = entries.find( next.id );
+                  if( itr != entries.end() )
+                  {
+                     itr->second.result = result;
+                     finished.emplace( itr->second.sequence, itr->first );
+                  }
+                  done_cv.notify_all();
+               }
+            }
+      };
+   }
+
+   block_prevalidator::block_prevalidator( uint32_t worker_threads, uint32_t max_blocks )
+   :my( new detail::block_prevalidator_impl() )
+   {
+      my->max_blocks = std::max( max_blocks, 1u );
+      for( uint32_t i = 0; i < worker_threads; ++i )
+         my->threads.emplace_back( [this]() { my->work_loop(); } );
+   }
+
+   block_prevalidator::~block_prevalidator()
+   {
+      {
+         std::lock_guard< std::mutex > lock( my->mtx );
+         my->stopping = true;
+      }
+      my->work_cv.notify_all();
+
+      for( auto& t : my->threads )
+         t.join();
+   }
+
+   void block_prevalidator::submit( const block_id_type& id, const signed_block& block, bool recover_transaction_keys )
+   {
+      if( my->threads.empty() )
+         return;
+
+      auto copy = std::make_shared< const signed_block >( block );
+
+      {
+         std::lock_guard< std::mutex > lock( my->mtx );
+         if( my->entries.find( id ) != my->entries.end() )
+            return;
+
+         my->trim();
+         if( my->entries.size() >= my->max_blocks )
+            return;
+
+         auto& e = my->entries[ id ];
+         e.sequence = my->next_sequence++;
+         my->queue.push_back( detail::block_prevalidator_impl::job{ id, std::move( copy ), recover_transaction_keys } );
+      }
+      my->work_cv.notify_one();
+   }
+
+   prevalidated_block_ptr block_prevalidator::take( const block_id_type& id )
+   {
+      std::unique_lock< std::mutex > lock( my->mtx );
+
+      auto itr = my->entries.find( id );
+      if( itr == my->entries.end() )
+         return prevalidated_block_ptr();
+
+      if( !itr->second.started )
+      {
+         // Computing it on the caller's thread is no slower than waiting for a worker to start on it
+         my->entries.erase( itr );
+         return prevalidated_block_ptr();
+      }
+
+      my->done_cv.wait( lock, [&]()
+      {
+         itr = my->entries.find( id );
+         return itr == my->entries.end() || itr->second.result;
+      });
+
+      prevalidated_block_ptr result;
+      if( itr != my->entries.end() )
+      {
+         result = itr->second.result;
+         my->finished.erase( itr->second.sequence );
+         my->entries.erase( itr );
+      }
+
+      // A block announced under another id than its own is of no use
+      if( result && result->id != id )
+         result.reset();
+
+      return result;
+   }
+
+} } // sigmaengine::chain
@@ -8,7 +8,6 @@
 #include <sigmaengine/chain/db_with.hpp>
 #include <sigmaengine/chain/evaluator_registry.hpp>
 #include <sigmaengine/chain/global_property_object.hpp>
-#include <sigmaengine/chain/history_object.hpp>
 #include <sigmaengine/chain/index.hpp>
 #include <sigmaengine/chain/sigmaengine_evaluator.hpp>
 #include <sigmaengine/chain/sigmaengine_objects.hpp>
@@ -16,6 +15,8 @@
 #include <sigmaengine/chain/shared_db_merkle.hpp>
 #include <sigmaengine/chain/operation_notification.hpp>
 #include <sigmaengine/chain/bobserver_schedule.hpp>
+#include <sigmaengine/chain/replay_pipeline.hpp>
+#include <sigmaengine/chain/snapshot.hpp>
 
 #include <sigmaengine/chain/util/asset.hpp>
 #include <sigmaengine/chain/util/reward.hpp>
@@ -28,6 +29,7 @@
 #include <fc/container/deque.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <cstdint>
 #include <deque>
@@ -68,6 +70,18 @@ namespace sigmaengine { namespace chain {
 
 using boost::container::flat_set;
 
+namespace {
+   /// Block number of a file named snapshot-<block_num>.bin, zero for any other file
+   uint32_t snapshot_file_block_num( const fc::path& file )
+   {
+      uint32_t block_num = 0;
+      std::string name = file.filename().generic_string();
+      if( sscanf( name.c_str(), "snapshot-%u.bin", &block_num ) != 1 || name != "snapshot-" + std::to_string( block_num ) + ".bin" )
+         return 0;
+      return block_num;
+   }
+}
+
 class database_impl
 {
    public:
@@ -86,6 +100,7 @@ database::database()
 database::~database()
 {
    clear_pending();
+   finish_snapshot_write();
 }
 
 void database::open( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t initial_supply, uint64_t shared_file_size, uint32_t chainbase_flags )
@@ -108,6 +123,9 @@ void database::open( const fc::path& data_dir, const fc::path& shared_mem_dir, u
 
          _block_log.open( data_dir / "block_log" );
 
+         if( _history_enabled )
+            _history.open( data_dir / "history" );
+
          auto log_head = _block_log.head();
 
          // Rewind all undo state. This should return us to the state at the last irreversible block.
@@ -166,24 +184,10 @@ void database::reindex( const fc::path& data_dir, const fc::path& shared_mem_dir
 
       with_write_lock( [&]()
       {
-         auto itr = _block_log.read_block( 0 );
-         auto last_block_num = _block_log.head()->block_num();
-
-         while( itr.first.block_num() != last_block_num )
-         {
-            auto cur_block_num = itr.first.block_num();
-            if( cur_block_num % 100000 == 0 )
-               std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
-               "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
-            apply_block( itr.first, skip_flags );
-            try{
-               itr = _block_log.read_block( itr.second );
-            } FC_CAPTURE_AND_RETHROW( (cur_block_num) )
-         }
+         replay_blocks( data_dir, 1, skip_flags );
 
-         std::cerr << "   reindex complete!\n";
+         ilog( "   reindex complete!" );
 
-         apply_block( itr.first, skip_flags );
          set_revision( head_block_num() );
       });
 
@@ -197,6 +201,289 @@ void database::reindex( const fc::path& data_dir, const fc::path& shared_mem_dir
 
 }
 
+void database::replay_blocks( const fc::path& data_dir, uint32_t first_block, uint32_t skip )
+{ try {
+   auto last_block_num = _block_log.head()->block_num();
+
+   auto last_report_time = fc::time_point::now();
+   uint64_t last_report_bytes = 0;
+   uint32_t last_report_block = first_block - 1;
+
+   auto report_progress = [&]( uint32_t cur_block_num, uint64_t bytes, uint32_t queued )
+   {
+      auto now = fc::time_point::now();
+      double elapsed = std::max( double( ( now - last_report_time ).count() ) / 1000000.0, 0.001 );
+
+      ilog( "   ${p}%   ${n} of ${l}   (${bps} blocks/s, ${mbps} MB/s, ${q} queued, ${m}M free)",
+         ("p", double( cur_block_num * 100 ) / last_block_num)("n", cur_block_num)("l", last_block_num)
+         ("bps", uint64_t( ( cur_block_num - last_report_block ) / elapsed ))
+         ("mbps", double( bytes - last_report_bytes ) / ( 1024 * 1024 ) / elapsed)
+         ("q", queued)("m", get_free_memory() / ( 1024 * 1024 )) );
+
+      last_report_time = now;
+      last_report_bytes = bytes;
+      last_report_block = cur_block_num;
+   };
+
+   if( _replay_threads == 0 )
+   {
+      auto itr = _block_log.read_block( _block_log.get_block_pos( first_block ) );
+
+      while( itr.first.block_num() != last_block_num )
+      {
+         auto cur_block_num = itr.first.block_num();
+         if( cur_block_num % 100000 == 0 )
+            report_progress( cur_block_num, itr.second, 0 );
+         apply_block( itr.first, skip );
+         maybe_grow_shared_memory();
+         try{
+            itr = _block_log.read_block( itr.second );
+         } FC_CAPTURE_AND_RETHROW( (cur_block_num) )
+      }
+
+      apply_block( itr.first, skip );
+      maybe_grow_shared_memory();
+   }
+   else
+   {
+      ilog( "Replaying with ${t} worker threads, ${q} blocks in flight", ("t", _replay_threads)("q", _replay_queue_size) );
+      replay_pipeline pipeline( data_dir / "block_log", first_block, last_block_num, _replay_threads, _replay_queue_size );
+
+      auto reset_replay_block = fc::make_scoped_exit( [&]() { _replay_block = nullptr; } );
+
+      while( auto next = pipeline.next() )
+      {
+         if( next->block_num % 100000 == 0 )
+            report_progress( next->block_num, pipeline.bytes_consumed(), pipeline.in_flight() );
+
+         _replay_block = next.get();
+         apply_block( next->block, skip );
+         _replay_block = nullptr;
+         maybe_grow_shared_memory();
+      }
+   }
+} FC_CAPTURE_AND_RETHROW( (data_dir)(first_block) ) }
+
+void database::open_from_snapshot( const fc::path& data_dir, const fc::path& shared_mem_dir, const fc::path& snapshot_file, uint64_t shared_file_size )
+{
+   try
+   {
+      ilog( "Loading state from snapshot ${f}", ("f", snapshot_file) );
+      auto start = fc::time_point::now();
+
+      wipe( data_dir, shared_mem_dir, false );
+
+      init_schema();
+      chainbase::database::open( shared_mem_dir, chainbase::database::read_write, shared_file_size );
+
+      initialize_indexes();
+      initialize_evaluators();
+
+      _block_log.open( data_dir / "block_log" );
+
+      if( _history_enabled )
+         _history.open( data_dir / "history" );
+
+      std::ifstream in( snapshot_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      in.exceptions( std::fstream::failbit | std::fstream::badbit );
+      snapshot_istream s( in );
+
+      snapshot_header header;
+      fc::raw::unpack( s, header );
+      FC_ASSERT( header.magic == snapshot_header::magic_number, "File is not a snapshot" );
+      FC_ASSERT( header.version == snapshot_header::current_version, "Unsupported snapshot version", ("version", header.version) );
+      FC_ASSERT( header.chain_id == get_chain_id(), "Snapshot is from a different chain", ("chain_id", header.chain_id) );
+
+      auto record = _block_log.read_header_by_num( header.block_num );
+      FC_ASSERT( record.valid() && record->id == header.block_id, "Snapshot block is not in the block log",
+         ("block_num", header.block_num)("block_id", header.block_id) );
+
+      std::map< std::string, std::shared_ptr< abstract_snapshot_index > > indices;
+      for_each_index_extension< abstract_snapshot_index >( [&]( std::shared_ptr< abstract_snapshot_index > idx )
+      {
+         indices[ idx->type_name() ] = idx;
+      });
+
+      with_write_lock( [&]()
+      {
+         for( uint32_t i = 0; i < header.index_count; ++i )
+         {
+            std::string name;
+            uint64_t size;
+            fc::raw::unpack( s, name );
+            fc::raw::unpack( s, size );
+            uint64_t section_start = in.tellg();
+
+            auto itr = indices.find( name );
+            if( itr == indices.end() )
+            {
+               wlog( "Skipping unknown index ${n} in snapshot", ("n", name) );
+               in.seekg( section_start + size );
+               continue;
+            }
+
+            itr->second->read( in );
+            FC_ASSERT( uint64_t( in.tellg() ) == section_start + size, "Snapshot index section has the wrong size", ("index", name) );
+            indices.erase( itr );
+         }
+
+         uint64_t footer;
+         fc::raw::unpack( s, footer );
+         FC_ASSERT( footer == snapshot_header::magic_number, "Snapshot is truncated" );
+
+         for( const auto& item : indices )
+            wlog( "Index ${n} is not in the snapshot and starts out empty", ("n", item.first) );
+
+         set_revision( header.block_num );
+         FC_ASSERT( head_block_num() == header.block_num && head_block_id() == header.block_id,
+            "Snapshot state does not match its header", ("head", head_block_num())("block_num", header.block_num) );
+
+         if( _history.is_open() && _history.head_block_num() < header.block_num )
+            wlog( "History store ends at block ${h}, operations of blocks ${f} to ${b} were not recorded",
+               ("h", _history.head_block_num())("f", _history.head_block_num() + 1)("b", header.block_num) );
+
+         ilog( "Loaded snapshot of block ${b} in ${t} sec", ("b", header.block_num)("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+
+         if( _block_log.head()->block_num() > header.block_num )
+         {
+            ilog( "Replaying blocks ${f} to ${l} from the block log...", ("f", header.block_num + 1)("l", _block_log.head()->block_num()) );
+            replay_blocks( data_dir, header.block_num + 1,
+               skip_bobserver_signature |
+               skip_transaction_signatures |
+               skip_transaction_dupe_check |
+               skip_tapos_check |
+               skip_merkle_check |
+               skip_bobserver_schedule_check |
+               skip_authority_check |
+               skip_validate |
+               skip_validate_invariants |
+               skip_block_log );
+         }
+
+         set_revision( head_block_num() );
+      });
+
+      _fork_db.start_block( *_block_log.head() );
+
+      with_read_lock( [&]()
+      {
+         init_hardforks();
+      });
+
+      ilog( "Done loading snapshot, elapsed time: ${t} sec", ("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+   }
+   FC_CAPTURE_LOG_AND_RETHROW( (data_dir)(shared_mem_dir)(snapshot_file) )
+}
+
+void database::write_snapshot( const fc::path& snapshot_file )
+{
+   capture_snapshot()->write( snapshot_file );
+}
+
+std::shared_ptr< captured_snapshot > database::capture_snapshot()const
+{
+   try
+   {
+      auto start = fc::time_point::now();
+      auto result = std::make_shared< captured_snapshot >();
+
+      snapshot_header& header = result->header;
+      header.chain_id = get_chain_id();
+      header.block_num = snapshot_block_num();
+
+      auto record = _block_log.read_header_by_num( header.block_num );
+      FC_ASSERT( record.valid(), "Snapshot block is not in the block log", ("block_num", header.block_num) );
+      header.block_id = record->id;
+      header.timestamp = record->timestamp;
+
+      for_each_index_extension< abstract_snapshot_index >( [&]( std::shared_ptr< abstract_snapshot_index > idx )
+      {
+         // Serialized straight into the section's chunks, nothing written is copied again before the file
+         std::unique_ptr< snapshot_section_buffer > buffer( new snapshot_section_buffer() );
+         std::ostream out( buffer.get() );
+         out.exceptions( std::ios::failbit | std::ios::badbit );
+         idx->write( out, header.block_num );
+         result->sections.emplace_back( idx->type_name(), std::move( buffer ) );
+      });
+      header.index_count = result->sections.size();
+
+      ilog( "Captured snapshot of block ${b} in ${t} sec", ("b", header.block_num)
+         ("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+      return result;
+   }
+   FC_CAPTURE_AND_RETHROW()
+}
+
+void captured_snapshot::write( const fc::path& snapshot_file )const
+{
+   try
+   {
+      auto start = fc::time_point::now();
+
+      fc::path tmp_file = snapshot_file.generic_string() + ".tmp";
+      {
+         std::ofstream out( tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+         out.exceptions( std::fstream::failbit | std::fstream::badbit );
+         snapshot_ostream s( out );
+
+         fc::raw::pack( s, header );
+
+         for( const auto& section : sections )
+         {
+            fc::raw::pack( s, section.first );
+            fc::raw::pack( s, section.second->size() );
+            for( const auto& chunk : section.second->chunks() )
+               out.write( chunk.data(), chunk.size() );
+         }
+
+         fc::raw::pack( s, snapshot_header::magic_number );
+         out.flush();
+      }
+
+      fc::rename( tmp_file, snapshot_file );
+
+      ilog( "Wrote snapshot of block ${b} to ${f} in ${t} sec", ("b", header.block_num)("f", snapshot_file)
+         ("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+   }
+   FC_CAPTURE_AND_RETHROW( (snapshot_file) )
+}
+
+void database::finish_snapshot_write()
+{
+   if( _snapshot_write.valid() )
+      _snapshot_write.get();
+}
+
+uint32_t database::snapshot_block_num()const
+{
+   // Blocks replayed from the block log are applied without undo sessions, so the revision lags
+   // behind the head block and the state is only available as of the head block
+   if( revision() < head_block_num() )
+      return head_block_num();
+   return get_dynamic_global_properties().last_irreversible_block_num;
+}
+
+fc::path database::latest_snapshot( const fc::path& dir )
+{
+   fc::path result;
+   uint32_t latest = 0;
+
+   if( !fc::is_directory( dir ) )
+      return result;
+
+   for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      uint32_t block_num = snapshot_file_block_num( *itr );
+      if( block_num > latest )
+      {
+         latest = block_num;
+         result = *itr;
+      }
+   }
+
+   return result;
+}
+
 void database::wipe( const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks)
 {
    close();
@@ -205,6 +492,8 @@ void database::wipe( const fc::path& data_dir, const fc::path& shared_mem_dir, b
    {
       fc::remove_all( data_dir / "block_log" );
       fc::remove_all( data_dir / "block_log.index" );
+      fc::remove_all( data_dir / "block_log.headers" );
+      fc::remove_all( data_dir / "history" );
    }
 }
 
@@ -216,11 +505,14 @@ void database::close(bool rewind)
       // we have to clear_pending() after we're done popping to get a clean
       // DB state (issue #336).
       clear_pending();
+      finish_snapshot_write();
 
       chainbase::database::flush();
       chainbase::database::close();
 
       _block_log.close();
+      _history.close();
+      _recent_transactions.clear();
 
       _fork_db.reset();
    }
@@ -261,9 +553,9 @@ block_id_type database::find_block_id_for_num( uint32_t block_num )const
       }
 
       // Next we query the block log.   Irreversible blocks are here.
-      auto b = _block_log.read_block_by_num( block_num );
-      if( b.valid() )
-         return b->id();
+      auto h = _block_log.read_header_by_num( block_num );
+      if( h.valid() )
+         return h->id;
 
       // Finally we query the fork DB.
       shared_ptr< fork_item > fitem = _fork_db.fetch_block_on_main_branch_by_number( block_num );
@@ -313,14 +605,77 @@ optional<signed_block> database::fetch_block_by_number( uint32_t block_num )cons
    return b;
 } FC_LOG_AND_RETHROW() }
 
+optional< signed_block_header > database::fetch_block_header_by_number( uint32_t block_num )const
+{ try {
+   optional< signed_block_header > result;
+
+   auto results = _fork_db.fetch_block_by_number( block_num );
+   if( results.size() == 1 )
+   {
+      result = signed_block_header( results[0]->data );
+      return result;
+   }
+
+   auto data = _block_log.read_serialized_block_by_num( block_num );
+   if( data.valid() )
+   {
+      result = signed_block_header();
+      fc::datastream< const char* > ds( data->data, data->size );
+      fc::raw::unpack( ds, *result );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+optional< fc::time_point_sec > database::fetch_block_time_by_id( const block_id_type& id )const
+{ try {
+   optional< fc::time_point_sec > result;
+
+   auto b = _fork_db.fetch_block( id );
+   if( b )
+   {
+      result = b->data.timestamp;
+      return result;
+   }
+
+   auto h = _block_log.read_header_by_num( protocol::block_header::num_from_id( id ) );
+   if( h.valid() && h->id == id )
+      result = h->timestamp;
+   return result;
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+optional< vector< char > > database::fetch_serialized_block_by_id( const block_id_type& id )const
+{ try {
+   optional< vector< char > > result;
+
+   auto b = _fork_db.fetch_block( id );
+   if( b )
+   {
+      result = fc::raw::pack( b->data );
+      return result;
+   }
+
+   auto data = _block_log.read_serialized_block_by_num( protocol::block_header::num_from_id( id ) );
+   if( !data.valid() )
+      return result;
+
+   // The header is a prefix of the packed block, so the id can be checked without unpacking the transactions
+   signed_block_header header;
+   fc::datastream< const char* > ds( data->data, data->size );
+   fc::raw::unpack( ds, header );
+   if( header.id() != id )
+      return result;
+
+   result = vector< char >( data->data, data->data + data->size );
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
 const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
 { try {
-   auto& index = get_index<transaction_index>().indices().get<by_trx_id>();
-   auto itr = index.find(trx_id);
-   FC_ASSERT(itr != index.end());
+   const auto* packed_trx = _recent_transactions.find( trx_id );
+   FC_ASSERT( packed_trx != nullptr, "Transaction is not in the recent transaction cache" );
    signed_transaction trx;
-   fc::raw::unpack( itr->packed_trx, trx );
-   return trx;;
+   fc::raw::unpack( *packed_trx, trx );
+   return trx;
 } FC_CAPTURE_AND_RETHROW() }
 
 std::vector< block_id_type > database::get_block_ids_on_fork( block_id_type head_of_fork ) const
@@ -366,6 +721,30 @@ const account_object* database::find_account( const account_name_type& name )con
    return find< account_object, by_name >( name );
 }
 
+const block_stats_object* database::find_block_stats( uint32_t block_num )const
+{
+   const auto& stats_idx = get_index< block_stats_index >().indices().get< by_block_num >();
+   auto itr = stats_idx.upper_bound( block_num );
+   if( itr == stats_idx.begin() )
+      return nullptr;
+   return &*( --itr );
+}
+
+history_store& database::get_history_store()
+{
+   return _history;
+}
+
+const history_store& database::get_history_store()const
+{
+   return _history;
+}
+
+void database::enable_history_store()
+{
+   _history_enabled = true;
+}
+
 const savings_withdraw_object& database::get_savings_withdraw( const account_name_type& owner, uint32_t request_id )const
 { try {
    return get< savings_withdraw_object, by_from_rid >( boost::make_tuple( owner, request_id ) );
@@ -444,11 +823,31 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
    //fc::time_point begin_time = fc::time_point::now();
 
+   // Checks that do not touch the database run before the write lock is taken, unless the prevalidator already ran them
+   const block_id_type new_block_id = new_block.id();
+   prevalidated_block_ptr prevalidated = _block_prevalidator ? _block_prevalidator->take( new_block_id ) : prevalidated_block_ptr();
+
+   if( _signature_recovery_pool && !( skip & ( skip_transaction_signatures | skip_authority_check ) ) && new_block.transactions.size() > 1
+      && !( prevalidated && prevalidated->transaction_keys.size() == new_block.transactions.size() ) )
+   {
+      // The keys are recovered from this body, so they are tied to its merkle root
+      auto merkle_root = new_block.calculate_merkle_root();
+      auto recovered = ( prevalidated && prevalidated->merkle_root && *prevalidated->merkle_root == merkle_root )
+         ? std::make_shared< prevalidated_block >( *prevalidated ) : std::make_shared< prevalidated_block >();
+      recovered->id = new_block_id;
+      recovered->merkle_root = merkle_root;
+      recovered->transaction_keys = _signature_recovery_pool->recover( new_block.transactions, SIGMAENGINE_CHAIN_ID );
+      prevalidated = recovered;
+   }
+
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
       with_write_lock( [&]()
       {
+         _pushed_block = prevalidated;
+         auto reset_pushed_block = fc::make_scoped_exit( [&]() { _pushed_block.reset(); } );
+
          detail::without_pending_transactions( *this, std::move(_pending_tx), [&]()
          {
             try
@@ -457,6 +856,8 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
             }
             FC_CAPTURE_AND_RETHROW( (new_block) )
          });
+
+         maybe_grow_shared_memory();
       });
    });
 
@@ -501,11 +902,13 @@ bool database::_push_block(const signed_block& new_block)
          if( new_head->data.block_num() > head_block_num() )
          {
             // wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
+            auto switch_start = fc::time_point::now();
             auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
 
             // pop blocks until we hit the forked block
             while( head_block_id() != branches.second.back()->data.previous )
                pop_block();
+            auto pop_time = fc::time_point::now();
 
             // push all blocks on the new fork
             for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
@@ -541,9 +944,17 @@ bool database::_push_block(const signed_block& new_block)
                       apply_block( (*ritr)->data, skip );
                       session.push();
                    }
+                   wlog( "Switching to fork ${id} failed, restored the previous fork after ${t} ms",
+                      ("id", new_head->id)("t", ( fc::time_point::now() - switch_start ).count() / 1000) );
                    throw *except;
                 }
             }
+
+            auto switch_end = fc::time_point::now();
+            ilog( "Switched to fork ${id}: popped ${p} blocks in ${pt} ms, applied ${a} blocks in ${at} ms, ${t} ms total",
+               ("id", new_head->id)("p", branches.second.size())("a", branches.first.size())
+               ("pt", ( pop_time - switch_start ).count() / 1000)("at", ( switch_end - pop_time ).count() / 1000)
+               ("t", ( switch_end - switch_start ).count() / 1000) );
             return true;
          }
          else
@@ -582,14 +993,15 @@ void database::push_transaction( const signed_transaction& trx, uint32_t skip )
    {
       try
       {
-         FC_ASSERT( fc::raw::pack_size(trx) <= (get_dynamic_global_properties().maximum_block_size - 256) );
+         precomputed_transaction ptrx( trx );
+         FC_ASSERT( ptrx.packed().size() <= (get_dynamic_global_properties().maximum_block_size - 256) );
          set_producing( true );
          detail::with_skip_flags( *this, skip,
             [&]()
             {
                with_write_lock( [&]()
                {
-                  _push_transaction( trx );
+                  _push_transaction( ptrx );
                });
             });
          set_producing( false );
@@ -603,12 +1015,15 @@ void database::push_transaction( const signed_transaction& trx, uint32_t skip )
    FC_CAPTURE_AND_RETHROW( (trx) )
 }
 
-void database::_push_transaction( const signed_transaction& trx )
+void database::_push_transaction( const precomputed_transaction& trx )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
    if( !_pending_tx_session.valid() )
+   {
+      _pending_tx_base_revision = revision();
       _pending_tx_session = start_undo_session( true );
+   }
 
    // Create a temporary undo session as a child of _pending_tx_session.
    // The temporary session will be discarded by the destructor if
@@ -624,7 +1039,109 @@ void database::_push_transaction( const signed_transaction& trx )
    temp_session.squash();
 
    // notify anyone listening to pending transactions
-   notify_on_pending_transaction( trx );
+   notify_on_pending_transaction( trx.get_transaction() );
+}
+
+optional< pending_transaction_changes > database::get_pending_transaction_changes()const
+{
+   optional< pending_transaction_changes > result;
+   if( _pending_tx_base_revision < 0 )
+      return result;
+
+   pending_transaction_changes changes;
+   bool all_known = true;
+
+   bool complete = get_index< account_authority_index >().for_each_changed_since( _pending_tx_base_revision,
+      [&]( const account_authority_id_type& id )
+      {
+         const auto* auth = find< account_authority_object >( id );
+         if( auth != nullptr )
+            changes.authorities.insert( auth->account );
+         else
+            all_known = false;
+      });
+
+   complete = complete && get_index< block_summary_index >().for_each_changed_since( _pending_tx_base_revision,
+      [&]( const block_summary_id_type& id )
+      {
+         changes.block_summaries.insert( uint32_t( id._id ) );
+      });
+
+   if( complete && all_known )
+      result = std::move( changes );
+
+   return result;
+}
+
+bool database::authorities_changed( const signed_transaction& trx, const flat_set< account_name_type >& changed )const
+{
+   if( changed.empty() )
+      return false;
+
+   flat_set< account_name_type > active, owner, posting;
+   vector< authority > other;
+   trx.get_required_authorities( active, owner, posting, other );
+
+   flat_set< account_name_type > accounts;
+   accounts.insert( active.begin(), active.end() );
+   accounts.insert( owner.begin(), owner.end() );
+   accounts.insert( posting.begin(), posting.end() );
+   for( const auto& a : other )
+   {
+      for( const auto& item : a.account_auths )
+         accounts.insert( item.first );
+   }
+
+   // Authorities can be satisfied by other accounts' authorities, as deep as verify_authority follows them
+   flat_set< account_name_type > frontier = accounts;
+   for( uint32_t depth = 0; depth <= SIGMAENGINE_MAX_SIG_CHECK_DEPTH && frontier.size(); ++depth )
+   {
+      flat_set< account_name_type > next;
+      for( const auto& name : frontier )
+      {
+         if( changed.find( name ) != changed.end() )
+            return true;
+
+         const auto* auth = find< account_authority_object, by_account >( name );
+         if( auth == nullptr )
+            return true;
+
+         for( const shared_authority* a : { &auth->owner, &auth->active, &auth->posting } )
+         {
+            for( const auto& item : a->account_auths )
+            {
+               if( accounts.insert( item.first ).second )
+                  next.insert( item.first );
+            }
+         }
+      }
+      frontier = std::move( next );
+   }
+
+   return false;
+}
+
+void database::_repush_pending_transaction( const precomputed_transaction& trx, const optional< pending_transaction_changes >& changes )
+{
+   if( !changes )
+   {
+      _push_transaction( trx );
+      return;
+   }
+
+   const signed_transaction& t = trx.get_transaction();
+   uint32_t skip = get_node_properties().skip_flags | skip_validate;
+
+   if( !authorities_changed( t, changes->authorities ) )
+      skip |= skip_transaction_signatures | skip_authority_check;
+
+   if( changes->block_summaries.find( t.ref_block_num ) == changes->block_summaries.end() )
+      skip |= skip_tapos_check;
+
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      _push_transaction( trx );
+   });
 }
 
 signed_block database::generate_block(
@@ -669,34 +1186,24 @@ signed_block database::_generate_block(
    size_t total_block_size = max_block_header_size;
 
    signed_block pending_block;
+   bool single_pass = false;
 
-   with_write_lock( [&]()
-   {
-      //
-      // The following code throws away existing pending_tx_session and
-      // rebuilds it by re-applying pending transactions.
-      //
-      // This rebuild is necessary because pending transactions' validity
-      // and semantics may have changed since they were received, because
-      // time-based semantics are evaluated based on the current block
-      // time.  These changes can only be reflected in the database when
-      // the value of the "when" variable is known, which means we need to
-      // re-apply pending transactions in this method.
-      //
-      _pending_tx_session.reset();
-      _pending_tx_session = start_undo_session( true );
+   fc::time_point start_time = fc::time_point::now();
+   fc::time_point select_time, seal_time, finish_time, restore_time;
 
+   // Applies each pending transaction that fits in its own undo session and adds it to the block
+   auto select_transactions = [&]( const vector< precomputed_transaction >& pending )
+   {
       uint64_t postponed_tx_count = 0;
-      // pop pending state (reset to head block state)
-      for( const signed_transaction& tx : _pending_tx )
+      for( const precomputed_transaction& tx : pending )
       {
          // Only include transactions that have not expired yet for currently generating block,
          // this should clear problem transactions and allow block production to continue
 
-         if( tx.expiration < when )
+         if( tx.get_transaction().expiration < when )
             continue;
 
-         uint64_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+         uint64_t new_total_size = total_block_size + tx.packed().size();
 
          // postpone transaction if it would make block too big
          if( new_total_size >= maximum_block_size )
@@ -705,75 +1212,197 @@ signed_block database::_generate_block(
             continue;
          }
 
+         uint32_t block_op_count = _current_block_op_count;
+         uint32_t block_virtual_op_count = _current_block_virtual_op_count;
+         uint32_t history_op_count = _history.pending_operation_count();
+         bool included = false;
+
          try
          {
+            _current_trx_in_block = pending_block.transactions.size();
+
             auto temp_session = start_undo_session( true );
             _apply_transaction( tx );
             temp_session.squash();
 
-            total_block_size += fc::raw::pack_size( tx );
-            pending_block.transactions.push_back( tx );
+            total_block_size += tx.packed().size();
+            pending_block.transactions.push_back( tx.get_transaction() );
+            included = true;
          }
          catch ( const fc::exception& e )
          {
             // Do nothing, transaction will not be re-applied
             //wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
             //wlog( "The transaction was ${t}", ("t", tx) );
+            _current_block_op_count = block_op_count;
+            _current_block_virtual_op_count = block_virtual_op_count;
+            _history.discard_pending_operations( history_op_count );
          }
+
+         // Applied for good in single pass production, so observers hear of it as push_block would tell them
+         if( included && single_pass )
+            notify_on_applied_transaction( tx.get_transaction() );
       }
       if( postponed_tx_count > 0 )
       {
          wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
       }
+   };
 
+   with_write_lock( [&]()
+   {
+      //
+      // The following code throws away existing pending_tx_session and
+      // rebuilds it by re-applying pending transactions.
+      //
+      // This rebuild is necessary because pending transactions' validity
+      // and semantics may have changed since they were received, because
+      // time-based semantics are evaluated based on the current block
+      // time.  These changes can only be reflected in the database when
+      // the value of the "when" variable is known, which means we need to
+      // re-apply pending transactions in this method.
+      //
       _pending_tx_session.reset();
-   });
 
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_tx now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
+      // The header only depends on the head block state, so it is known before any transaction is applied
+      pending_block.previous = head_block_id();
+      pending_block.timestamp = when;
+      pending_block.bobserver = bobserver_owner;
 
-   pending_block.previous = head_block_id();
-   pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
-   pending_block.bobserver = bobserver_owner;
+      const auto& bobserver = get_bobserver( bobserver_owner );
 
-   const auto& bobserver = get_bobserver( bobserver_owner );
+      if( bobserver.running_version != SIGMAENGINE_BLOCKCHAIN_VERSION )
+         pending_block.extensions.insert( block_header_extensions( SIGMAENGINE_BLOCKCHAIN_VERSION ) );
 
-   if( bobserver.running_version != SIGMAENGINE_BLOCKCHAIN_VERSION )
-      pending_block.extensions.insert( block_header_extensions( SIGMAENGINE_BLOCKCHAIN_VERSION ) );
+      const auto& hfp = get_hardfork_property_object();
 
-   const auto& hfp = get_hardfork_property_object();
+      if (bobserver.is_bproducer) 
+      {
+         if( hfp.current_hardfork_version < SIGMAENGINE_BLOCKCHAIN_HARDFORK_VERSION // Binary is newer hardfork than has been applied
+               && ( bobserver.hardfork_version_vote != _hardfork_versions[ hfp.last_hardfork + 1 ] 
+               || bobserver.hardfork_time_vote != _hardfork_times[ hfp.last_hardfork + 1 ] ) ) // Bobserver vote does not match binary configuration
+         {
+               // Make vote match binary configuration
+               pending_block.extensions.insert( block_header_extensions( hardfork_version_vote( _hardfork_versions[ hfp.last_hardfork + 1 ], _hardfork_times[ hfp.last_hardfork + 1 ] ) ) );
+         }
+         else if( hfp.current_hardfork_version == SIGMAENGINE_BLOCKCHAIN_HARDFORK_VERSION // Binary does not know of a new hardfork
+               && bobserver.hardfork_version_vote > SIGMAENGINE_BLOCKCHAIN_HARDFORK_VERSION ) // Voting for hardfork in the future, that we do not know of...
+         {
+               // Make vote match binary configuration. This is vote to not apply the new hardfork.
+               pending_block.extensions.insert( block_header_extensions( hardfork_version_vote( _hardfork_versions[ hfp.last_hardfork ], _hardfork_times[ hfp.last_hardfork ] ) ) );
+         }
+      }
 
-   if (bobserver.is_bproducer) 
-   {
-      if( hfp.current_hardfork_version < SIGMAENGINE_BLOCKCHAIN_HARDFORK_VERSION // Binary is newer hardfork than has been applied
-            && ( bobserver.hardfork_version_vote != _hardfork_versions[ hfp.last_hardfork + 1 ] 
-            || bobserver.hardfork_time_vote != _hardfork_times[ hfp.last_hardfork + 1 ] ) ) // Bobserver vote does not match binary configuration
+      // The block can only be promoted in place when it becomes the new head without a fork switch
+      single_pass = _single_pass_block_production
+         && ( (skip & skip_fork_db) || ( _fork_db.head() && _fork_db.head()->id == head_block_id() ) );
+
+      if( !single_pass )
       {
-            // Make vote match binary configuration
-            pending_block.extensions.insert( block_header_extensions( hardfork_version_vote( _hardfork_versions[ hfp.last_hardfork + 1 ], _hardfork_times[ hfp.last_hardfork + 1 ] ) ) );
+         _pending_tx_session = start_undo_session( true );
+         select_transactions( _pending_tx );
+         _pending_tx_session.reset();
+         select_time = fc::time_point::now();
+         return;
       }
-      else if( hfp.current_hardfork_version == SIGMAENGINE_BLOCKCHAIN_HARDFORK_VERSION // Binary does not know of a new hardfork
-            && bobserver.hardfork_version_vote > SIGMAENGINE_BLOCKCHAIN_HARDFORK_VERSION ) // Voting for hardfork in the future, that we do not know of...
+
+      //
+      // Single pass production: the transactions are applied once, inside the session that becomes
+      // the undo session of the new head block. Pending transactions that did not make it into the
+      // block are re-applied on top of it when the restorer goes out of scope, exactly as push_block
+      // does, while the included ones are skipped as known.
+      //
       {
-            // Make vote match binary configuration. This is vote to not apply the new hardfork.
-            pending_block.extensions.insert( block_header_extensions( hardfork_version_vote( _hardfork_versions[ hfp.last_hardfork ], _hardfork_times[ hfp.last_hardfork ] ) ) );
+         // Every node checks the header against the state before the block's transactions, so the signing
+         // bobserver and its key are taken from that state too. The signature is checked once the block is sealed.
+         const bobserver_object& signing_bobserver = validate_block_header( skip | skip_bobserver_signature, pending_block );
+         const public_key_type signing_key = signing_bobserver.signing_key;
+
+         detail::pending_transactions_restorer restorer( *this, std::move( _pending_tx ) );
+
+         auto session = start_undo_session( true );
+
+         start_block( pending_block );
+         select_transactions( restorer._pending_transactions );
+         select_time = fc::time_point::now();
+
+         pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+
+         if( !(skip & skip_bobserver_signature) )
+            pending_block.sign( block_signing_private_key );
+
+         if( !(skip & skip_block_size_check) )
+         {
+            FC_ASSERT( fc::raw::pack_size(pending_block) <= SIGMAENGINE_MAX_BLOCK_SIZE );
+         }
+
+         if( !(skip & skip_bobserver_signature) )
+            FC_ASSERT( pending_block.validate_signee( signing_key ), "Generated block is not signed by the key of its bobserver" );
+
+         validate_block_size( pending_block );
+         const block_id_type pending_block_id = pending_block.id();
+         seal_time = fc::time_point::now();
+
+         // Observers get the finished block, as they do from push_block, although its transactions are already applied
+         notify_pre_apply_block( pending_block );
+
+         if( !(skip & skip_fork_db) )
+         {
+            shared_ptr<fork_item> new_head = _fork_db.push_block( pending_block );
+            _maybe_warn_multiple_production( new_head->num );
+            FC_ASSERT( new_head->id == pending_block_id, "Generated block did not become the fork database head" );
+         }
+
+         try
+         {
+            finish_block( pending_block, pending_block_id, signing_bobserver );
+            session.push();
+         }
+         catch( const fc::exception& e )
+         {
+            elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
+            _fork_db.remove( pending_block_id );
+            throw;
+         }
+
+         flush_and_snapshot( pending_block.block_num() );
+         finish_time = fc::time_point::now();
       }
-   }      
- 
-   if( !(skip & skip_bobserver_signature) )
-      pending_block.sign( block_signing_private_key );
+      restore_time = fc::time_point::now();
 
-   // TODO:  Move this to _push_block() so session is restored.
-   if( !(skip & skip_block_size_check) )
+      maybe_grow_shared_memory();
+   });
+
+   if( !single_pass )
    {
-      FC_ASSERT( fc::raw::pack_size(pending_block) <= SIGMAENGINE_MAX_BLOCK_SIZE );
+      // We have temporarily broken the invariant that
+      // _pending_tx_session is the result of applying _pending_tx, as
+      // _pending_tx now consists of the set of postponed transactions.
+      // However, the push_block() call below will re-create the
+      // _pending_tx_session.
+
+      pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+
+      if( !(skip & skip_bobserver_signature) )
+         pending_block.sign( block_signing_private_key );
+
+      // TODO:  Move this to _push_block() so session is restored.
+      if( !(skip & skip_block_size_check) )
+      {
+         FC_ASSERT( fc::raw::pack_size(pending_block) <= SIGMAENGINE_MAX_BLOCK_SIZE );
+      }
+      seal_time = fc::time_point::now();
+
+      push_block( pending_block, skip );
+      finish_time = restore_time = fc::time_point::now();
    }
 
-   push_block( pending_block, skip );
+   ilog( "Block #${n} with ${t} transactions produced in ${total} us (${mode}): apply transactions ${a} us, sign ${s} us, ${f} ${p} us, restore pending ${r} us",
+      ("n", pending_block.block_num())("t", pending_block.transactions.size())("total", (restore_time - start_time).count())
+      ("mode", single_pass ? "single pass" : "push_block")
+      ("a", (select_time - start_time).count())("s", (seal_time - select_time).count())
+      ("f", single_pass ? "finish block" : "push block")("p", (finish_time - seal_time).count())
+      ("r", (restore_time - finish_time).count()) );
 
    return pending_block;
 }
@@ -789,14 +1418,27 @@ void database::pop_block()
       _pending_tx_session.reset();
       auto head_id = head_block_id();
 
-      /// save the head block so we can recover its transactions
-      optional<signed_block> head_block = fetch_block_by_id( head_id );
-      SIGMAENGINE_ASSERT( head_block.valid(), pop_empty_chain, "there are no blocks to pop" );
+      /// keep the head block so we can recover its transactions, sharing the fork database's copy when it has one
+      std::shared_ptr< const signed_block > head_block;
+      auto head_item = _fork_db.fetch_block( head_id );
+      if( head_item )
+      {
+         head_block = std::shared_ptr< const signed_block >( head_item, &head_item->data );
+      }
+      else
+      {
+         optional< signed_block > logged_block = fetch_block_by_id( head_id );
+         SIGMAENGINE_ASSERT( logged_block.valid(), pop_empty_chain, "there are no blocks to pop" );
+         head_block = std::make_shared< const signed_block >( std::move( *logged_block ) );
+      }
 
       _fork_db.pop_block();
       undo();
+      _pending_tx_base_revision = -1;
+      _history.pop_blocks( head_block->block_num() );
 
-      _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
+      for( auto itr = head_block->transactions.rbegin(); itr != head_block->transactions.rend(); ++itr )
+         _popped_tx.emplace_front( precomputed_transaction::share( head_block, *itr ) );
 
    }
    FC_CAPTURE_AND_RETHROW()
@@ -825,6 +1467,7 @@ void database::notify_pre_apply_operation( operation_notification& note )
 
 void database::notify_post_apply_operation( const operation_notification& note )
 {
+   ++_current_block_op_count;
    SIGMAENGINE_TRY_NOTIFY( post_apply_operation, note )
 }
 
@@ -833,6 +1476,7 @@ void database::push_virtual_operation( const operation& op, bool force )
    FC_ASSERT( is_virtual_operation( op ) );
    operation_notification note(op);
    ++_current_virtual_op;
+   ++_current_block_virtual_op_count;
    note.virtual_op = _current_virtual_op;
    notify_pre_apply_operation( note );
    notify_post_apply_operation( note );
@@ -1220,8 +1864,6 @@ void database::initialize_indexes()
    add_core_index< block_summary_index                     >(*this);
    add_core_index< bobserver_schedule_index                >(*this);
    add_core_index< bobserver_vote_index                    >(*this);
-   add_core_index< operation_index                         >(*this);
-   add_core_index< account_history_index                   >(*this);
    add_core_index< hardfork_property_index                 >(*this);
    add_core_index< owner_authority_history_index           >(*this);
    add_core_index< account_recovery_request_index          >(*this);
@@ -1236,6 +1878,7 @@ void database::initialize_indexes()
    add_core_index< transaction_fee_vote_index              >(*this);
    add_core_index< transaction_fee_reward_index            >(*this);
    add_core_index< mining_reward_turn_index                >(*this);
+   add_core_index< block_stats_index                       >(*this);
    
    _plugin_index_signal();
 }
@@ -1472,6 +2115,116 @@ void database::set_flush_interval( uint32_t flush_blocks )
    _next_flush_block = 0;
 }
 
+void database::set_replay_threads( uint32_t threads, uint32_t queue_size )
+{
+   FC_ASSERT( queue_size > 0, "Replay queue size must be nonzero" );
+   _replay_threads = threads;
+   _replay_queue_size = queue_size;
+}
+
+const account_authority_object& database::get_signing_authority( const string& name )
+{
+   if( !_block_authority_cache_active )
+      return get< account_authority_object, by_account >( name );
+
+   auto itr = _block_authority_cache.find( name );
+   if( itr != _block_authority_cache.end() )
+      return *itr->second;
+
+   const auto& auth = get< account_authority_object, by_account >( name );
+   _block_authority_cache.emplace( name, &auth );
+   return auth;
+}
+
+void database::set_block_authority_cache( bool enabled )
+{
+   _block_authority_cache_enabled = enabled;
+}
+
+void database::set_shared_memory_growth( uint64_t min_free, uint64_t increment )
+{
+   FC_ASSERT( min_free == 0 || increment > 0, "Shared memory growth increment must be nonzero" );
+   _shared_memory_min_free = min_free;
+   _shared_memory_increment = increment;
+}
+
+void database::maybe_grow_shared_memory()
+{
+   if( _shared_memory_min_free == 0 || get_free_memory() >= _shared_memory_min_free )
+      return;
+
+   uint64_t old_size = get_size();
+   auto start = fc::time_point::now();
+   try
+   {
+      if( !grow( _shared_memory_increment ) )
+      {
+         wlog( "Readers of the shared memory file did not finish in time, growing it after the next block" );
+         return;
+      }
+   }
+   catch( const std::exception& e )
+   {
+      // Most likely out of disk or memory, which the next block would not change
+      elog( "Unable to grow the shared memory file, giving up growing it until restart: ${e}", ("e", e.what()) );
+      _shared_memory_min_free = 0;
+      return;
+   }
+
+   ilog( "Grew the shared memory file from ${o}M to ${n}M in ${t} ms at block ${b}, ${f}M free",
+      ("o", old_size / ( 1024 * 1024 ))("n", get_size() / ( 1024 * 1024 ))("t", ( fc::time_point::now() - start ).count() / 1000)
+      ("b", head_block_num())("f", get_free_memory() / ( 1024 * 1024 )) );
+   _last_free_gb_printed = uint32_t( get_free_memory() / ( 1024 * 1024 * 1024 ) );
+}
+
+void database::set_page_fault_report_interval( uint32_t interval )
+{
+   _page_fault_report_interval = interval;
+   _page_fault_report_block = 0;
+}
+
+void database::set_snapshot_interval( uint32_t interval, const fc::path& dir, uint32_t keep )
+{
+   FC_ASSERT( interval == 0 || keep > 0, "At least one snapshot must be kept" );
+   _snapshot_interval = interval;
+   _snapshot_dir = dir;
+   _snapshots_to_keep = keep;
+   _next_snapshot_block = 0;
+
+   if( interval && !fc::exists( dir ) )
+      fc::create_directories( dir );
+}
+
+void database::set_single_pass_block_production( bool single_pass )
+{
+   _single_pass_block_production = single_pass;
+}
+
+void database::set_recent_transaction_cache_size( uint32_t size )
+{
+   _recent_transactions.set_max_size( size );
+}
+
+void database::set_signature_recovery_threads( uint32_t threads )
+{
+   _signature_recovery_pool.reset();
+   if( threads > 0 )
+      _signature_recovery_pool.reset( new signature_recovery_pool( threads ) );
+}
+
+void database::set_block_prevalidation_threads( uint32_t threads, uint32_t max_blocks )
+{
+   _block_prevalidator.reset();
+   if( threads > 0 )
+      _block_prevalidator.reset( new block_prevalidator( threads, max_blocks ) );
+}
+
+void database::prevalidate_block( const block_id_type& id, const signed_block& block, bool recover_transaction_keys )
+{
+   if( _block_prevalidator )
+      _block_prevalidator->submit( id, block, recover_transaction_keys );
+}
+
 //////////////////// private methods ////////////////////
 
 void database::apply_block( const signed_block& next_block, uint32_t skip )
@@ -1516,6 +2269,73 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
    //fc::time_point end_time = fc::time_point::now();
    //fc::microseconds dt = end_time - begin_time;
+   flush_and_snapshot( block_num );
+} FC_CAPTURE_AND_RETHROW( (next_block) ) }
+
+void database::flush_and_snapshot( uint32_t block_num )
+{
+   if( _snapshot_interval != 0 )
+   {
+      uint32_t snapshot_block = snapshot_block_num();
+      if( _next_snapshot_block == 0 )
+         _next_snapshot_block = ( snapshot_block / _snapshot_interval + 1 ) * _snapshot_interval;
+
+      if( snapshot_block >= _next_snapshot_block )
+      {
+         _next_snapshot_block = ( snapshot_block / _snapshot_interval + 1 ) * _snapshot_interval;
+
+         if( _snapshot_write.valid() && _snapshot_write.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+         {
+            wlog( "Skipping snapshot of block ${b}, the previous snapshot is still being written", ("b", snapshot_block) );
+         }
+         else
+         {
+            finish_snapshot_write();
+
+            try
+            {
+               // Only the capture needs the write lock, the file is written and old ones pruned on their own thread
+               auto snapshot = capture_snapshot();
+               fc::path dir = _snapshot_dir;
+               uint32_t keep = _snapshots_to_keep;
+               _snapshot_write = std::async( std::launch::async, [snapshot, dir, keep, snapshot_block]()
+               {
+                  try
+                  {
+                     snapshot->write( dir / ( "snapshot-" + std::to_string( snapshot_block ) + ".bin" ) );
+
+                     std::map< uint32_t, fc::path > snapshots;
+                     for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+                     {
+                        if( uint32_t num = snapshot_file_block_num( *itr ) )
+                           snapshots[ num ] = *itr;
+                     }
+
+                     while( snapshots.size() > keep )
+                     {
+                        fc::remove( snapshots.begin()->second );
+                        snapshots.erase( snapshots.begin() );
+                     }
+                  }
+                  catch( const fc::exception& e )
+                  {
+                     elog( "Failed to write snapshot: ${e}", ("e", e.to_detail_string()) );
+                  }
+                  catch( const std::exception& e )
+                  {
+                     elog( "Failed to write snapshot: ${e}", ("e", e.what()) );
+                  }
+               });
+            }
+            catch( const fc::exception& e )
+            {
+               // A failed snapshot must not stop the node from following the chain
+               elog( "Failed to capture snapshot: ${e}", ("e", e.to_detail_string()) );
+            }
+         }
+      }
+   }
+
    if( _flush_blocks != 0 )
    {
       if( _next_flush_block == 0 )
@@ -1544,8 +2364,7 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
    }
 
    show_free_memory( false );
-
-} FC_CAPTURE_AND_RETHROW( (next_block) ) }
+}
 
 void database::show_free_memory( bool force )
 {
@@ -1563,6 +2382,26 @@ void database::show_free_memory( bool force )
       if( free_mb <= 100 && head_block_num() % 10 == 0 )
          elog( "Free memory is now ${n}M. Increase shared file size immediately!" , ("n", free_mb) );
    }
+
+   if( _page_fault_report_interval && head_block_num() >= _page_fault_report_block + _page_fault_report_interval )
+   {
+      auto stats = get_mapping_stats();
+
+      // The first call only takes the counters to report the following blocks against
+      if( _page_fault_report_block > 0 )
+      {
+         double blocks = head_block_num() - _page_fault_report_block;
+         const auto& last = _page_fault_report_stats;
+         ilog( "Blocks ${f} to ${l}: ${minor} minor and ${major} major page faults, ${dtlb} dTLB load misses per block",
+            ("f", _page_fault_report_block + 1)("l", head_block_num())
+            ("minor", ( stats.minor_faults - last.minor_faults ) / blocks)
+            ("major", ( stats.major_faults - last.major_faults ) / blocks)
+            ("dtlb", stats.dtlb_available ? fc::variant( ( stats.dtlb_misses - last.dtlb_misses ) / blocks ) : fc::variant( "n/a" )) );
+      }
+
+      _page_fault_report_block = head_block_num();
+      _page_fault_report_stats = stats;
+   }
 }
 
 uint32_t database::get_free_memory_gb()
@@ -1579,73 +2418,118 @@ void database::_apply_block( const signed_block& next_block )
    notify_pre_apply_block( next_block );
 
    uint32_t next_block_num = next_block.block_num();
-   //block_id_type next_block_id = next_block.id();
+   const block_id_type next_block_id = _replay_block ? _replay_block->block_id : next_block.id();
 
    uint32_t skip = get_node_properties().skip_flags;
 
-   if( !( skip & skip_merkle_check ) )
+   // A fork switch applies other blocks inside the same push_block, so the prevalidated block is matched by id.
+   // The id only covers the header, so its results are only used once the merkle root of this body matches theirs.
+   const prevalidated_block* prevalidated = ( _pushed_block && _pushed_block->id == next_block_id ) ? _pushed_block.get() : nullptr;
+
+   if( !( skip & skip_merkle_check ) || prevalidated )
    {
       auto merkle_root = next_block.calculate_merkle_root();
 
-      try
-      {
-         FC_ASSERT( next_block.transaction_merkle_root == merkle_root, "Merkle check failed", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",merkle_root)("next_block",next_block)("id",next_block.id()) );
-      }
-      catch( fc::assert_exception& e )
+      if( prevalidated && !( prevalidated->merkle_root && *prevalidated->merkle_root == merkle_root ) )
+         prevalidated = nullptr;
+
+      if( !( skip & skip_merkle_check ) )
       {
-         // const auto& merkle_map = get_shared_db_merkle();
-         // auto itr = merkle_map.find( next_block_num );
+         try
+         {
+            FC_ASSERT( next_block.transaction_merkle_root == merkle_root, "Merkle check failed", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",merkle_root)("next_block",next_block)("id",next_block_id) );
+         }
+         catch( fc::assert_exception& e )
+         {
+            // const auto& merkle_map = get_shared_db_merkle();
+            // auto itr = merkle_map.find( next_block_num );
 
-         // if( itr == merkle_map.end() || itr->second != merkle_root )
-            throw e;
+            // if( itr == merkle_map.end() || itr->second != merkle_root )
+               throw e;
+         }
       }
    }
 
-   const bobserver_object& signing_bobserver = validate_block_header(skip, next_block);
+   const bobserver_object& signing_bobserver = validate_block_header(skip, next_block, prevalidated);
 
-   _current_block_num    = next_block_num;
-   _current_trx_in_block = 0;
-   _current_virtual_op   = 0;
+   if( prevalidated && prevalidated->transaction_keys.size() && prevalidated->transaction_keys.size() == next_block.transactions.size() )
+      _block_signature_keys = &prevalidated->transaction_keys;
+   auto reset_block_keys = fc::make_scoped_exit( [&]() { _block_signature_keys = nullptr; } );
+
+   _block_authority_cache_active = _block_authority_cache_enabled;
+   auto reset_authority_cache = fc::make_scoped_exit( [&]()
+   {
+      _block_authority_cache_active = false;
+      _block_authority_cache.clear();
+   } );
+
+   validate_block_size( next_block );
+   start_block( next_block );
+
+   for( const auto& trx : next_block.transactions )
+   {
+      /* We do not need to push the undo state for each transaction
+       * because they either all apply and are valid or the
+       * entire block fails to apply.  We only need an "undo" state
+       * for transactions when validating broadcast transactions or
+       * when building a block.
+       */
+      apply_transaction( trx, skip );
+      ++_current_trx_in_block;
+   }
 
+   finish_block( next_block, next_block_id, signing_bobserver );
+
+   if( next_block_num % 10000 == 0 )
+      ilog( "Transaction packs and hashes at block ${b}: ${c} computed, ${r} reused from cache",
+         ("b", next_block_num)("c", precomputed_transaction::computed_count())("r", precomputed_transaction::reused_count()) );
+} //FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
+FC_CAPTURE_LOG_AND_RETHROW( (next_block.block_num()) )
+}
+
+void database::validate_block_size( const signed_block& next_block )const
+{
    const auto& gprops = get_dynamic_global_properties();
    auto block_size = fc::raw::pack_size( next_block );
 
-   FC_ASSERT( block_size <= gprops.maximum_block_size, "Block Size is too Big", ("next_block_num",next_block_num)("block_size", block_size)("max",gprops.maximum_block_size) );
+   FC_ASSERT( block_size <= gprops.maximum_block_size, "Block Size is too Big", ("next_block_num",next_block.block_num())("block_size", block_size)("max",gprops.maximum_block_size) );
 
    if( block_size < SIGMAENGINE_MIN_BLOCK_SIZE )
    {
       elog( "Block size is too small",
-         ("next_block_num",next_block_num)("block_size", block_size)("min",SIGMAENGINE_MIN_BLOCK_SIZE)
+         ("next_block_num",next_block.block_num())("block_size", block_size)("min",SIGMAENGINE_MIN_BLOCK_SIZE)
       );
    }
+}
+
+void database::start_block( const signed_block& next_block )
+{
+   _current_block_num    = next_block.block_num();
+   _current_trx_in_block = 0;
+   _current_virtual_op   = 0;
+   _current_block_op_count = 0;
+   _current_block_virtual_op_count = 0;
 
    /// modify current bobserver so transaction evaluators can know who included the transaction,
    /// this is mostly for POW operations which must pay the current_bobserver
-   modify( gprops, [&]( dynamic_global_property_object& dgp ){
+   modify( get_dynamic_global_properties(), [&]( dynamic_global_property_object& dgp ){
       dgp.current_bobserver = next_block.bobserver;
    });
 
    /// parse bobserver version reporting
    process_header_extensions( next_block );
 
-   for( const auto& trx : next_block.transactions )
-   {
-      /* We do not need to push the undo state for each transaction
-       * because they either all apply and are valid or the
-       * entire block fails to apply.  We only need an "undo" state
-       * for transactions when validating broadcast transactions or
-       * when building a block.
-       */
-      apply_transaction( trx, skip );
-      ++_current_trx_in_block;
-   }
+   _history.start_block( _current_block_num );
+}
 
+void database::finish_block( const signed_block& next_block, const block_id_type& next_block_id, const bobserver_object& signing_bobserver )
+{
    _current_virtual_op   = 0;
 
-   update_global_dynamic_data(next_block);
+   update_global_dynamic_data(next_block, next_block_id);
    update_signing_bobserver(signing_bobserver, next_block);
    update_last_irreversible_block();
-   create_block_summary(next_block);
+   create_block_summary(next_block, next_block_id);
    clear_expired_transactions();
    update_bobserver_schedule(*this);
    clear_null_account_balance();
@@ -1655,11 +2539,14 @@ void database::_apply_block( const signed_block& next_block )
    process_transaction_fee();
    account_recovery_processing();
    process_hardforks();
+   update_block_stats( next_block );
+
+   _history.finish_block();
+   _history.commit( get_dynamic_global_properties().last_irreversible_block_num );
+
    // notify observers that the block has been applied
    notify_applied_block( next_block );
    notify_changed_objects();
-} //FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
-FC_CAPTURE_LOG_AND_RETHROW( (next_block.block_num()) )
 }
 
 void database::process_transaction_fee()
@@ -1755,8 +2642,19 @@ void database::apply_transaction(const signed_transaction& trx, uint32_t skip)
 }
 
 void database::_apply_transaction(const signed_transaction& trx)
-{ try {
-   _current_trx_id = trx.id();
+{
+   const transaction_id_type* known_id = nullptr;
+   if( _replay_block && _current_trx_in_block < _replay_block->trx_ids.size() )
+      known_id = &_replay_block->trx_ids[ _current_trx_in_block ];
+
+   _apply_transaction( precomputed_transaction::borrow( trx, known_id ) );
+}
+
+void database::_apply_transaction(const precomputed_transaction& ptrx)
+{
+   const signed_transaction& trx = ptrx.get_transaction();
+   try {
+   _current_trx_id = ptrx.id();
    _current_virtual_op   = 0;
    uint32_t skip = get_node_properties().skip_flags;
 
@@ -1765,7 +2663,7 @@ void database::_apply_transaction(const signed_transaction& trx)
 
    auto& trx_idx = get_index<transaction_index>();
    const chain_id_type& chain_id = SIGMAENGINE_CHAIN_ID;
-   auto trx_id = trx.id();
+   auto trx_id = _current_trx_id;
    // idump((trx_id)(skip&skip_transaction_dupe_check));
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end(),
@@ -1773,13 +2671,21 @@ void database::_apply_transaction(const signed_transaction& trx)
 
    if( !(skip & (skip_transaction_signatures | skip_authority_check) ) )
    {
-      auto get_active  = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).active ); };
-      auto get_owner   = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).owner );  };
-      auto get_posting = [&]( const string& name ) { return authority( get< account_authority_object, by_account >( name ).posting );  };
+      auto get_active  = [&]( const string& name ) -> authority_view { return get_signing_authority( name ).active;  };
+      auto get_owner   = [&]( const string& name ) -> authority_view { return get_signing_authority( name ).owner;   };
+      auto get_posting = [&]( const string& name ) -> authority_view { return get_signing_authority( name ).posting; };
 
       try
       {
-         trx.verify_authority( chain_id, get_active, get_owner, get_posting, SIGMAENGINE_MAX_SIG_CHECK_DEPTH );
+         if( _block_signature_keys )
+         {
+            const auto& recovered = (*_block_signature_keys)[ _current_trx_in_block ];
+            if( recovered.error )
+               recovered.error->dynamic_rethrow_exception();
+            protocol::verify_authority( trx.operations, recovered.keys, get_active, get_owner, get_posting, SIGMAENGINE_MAX_SIG_CHECK_DEPTH );
+         }
+         else
+            protocol::verify_authority( trx.operations, ptrx.signature_keys( chain_id ), get_active, get_owner, get_posting, SIGMAENGINE_MAX_SIG_CHECK_DEPTH );
       }
       catch( protocol::tx_missing_active_auth& e )
       {
@@ -1815,7 +2721,6 @@ void database::_apply_transaction(const signed_transaction& trx)
       create<transaction_object>([&](transaction_object& transaction) {
          transaction.trx_id = trx_id;
          transaction.expiration = trx.expiration;
-         fc::raw::pack( transaction.packed_trx, trx );
       });
    }
 
@@ -1830,6 +2735,10 @@ void database::_apply_transaction(const signed_transaction& trx)
          ++_current_op_in_trx;
       } FC_CAPTURE_AND_RETHROW( (op) );
    }
+
+   if( !(skip & skip_transaction_dupe_check) )
+      _recent_transactions.add( trx_id, trx.expiration, ptrx.packed() );
+
    _current_trx_id = transaction_id_type();
 
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
@@ -1838,18 +2747,28 @@ void database::apply_operation(const operation& op)
 {
    operation_notification note(op);
    notify_pre_apply_operation( note );
-   _my->_evaluator_registry.get_evaluator( op ).apply( op );
+   {
+      auto prev_note = _current_op_note;
+      _current_op_note = &note;
+      auto restore_note = fc::make_scoped_exit( [&]() { _current_op_note = prev_note; } );
+      _my->_evaluator_registry.get_evaluator( op ).apply( op );
+   }
    notify_post_apply_operation( note );
 }
 
-const bobserver_object& database::validate_block_header( uint32_t skip, const signed_block& next_block )const
+const bobserver_object& database::validate_block_header( uint32_t skip, const signed_block& next_block, const prevalidated_block* prevalidated )const
 { try {
    FC_ASSERT( head_block_id() == next_block.previous, "", ("head_block_id",head_block_id())("next.prev",next_block.previous) );
    FC_ASSERT( head_block_time() < next_block.timestamp, "", ("head_block_time",head_block_time())("next",next_block.timestamp)("blocknum",next_block.block_num()) );
    const bobserver_object& bobserver = get_bobserver( next_block.bobserver );
 
    if( !(skip&skip_bobserver_signature) )
-      FC_ASSERT( next_block.validate_signee( bobserver.signing_key ) );
+   {
+      if( prevalidated && prevalidated->signee )
+         FC_ASSERT( public_key_type( *prevalidated->signee ) == bobserver.signing_key );
+      else
+         FC_ASSERT( next_block.validate_signee( bobserver.signing_key ) );
+   }
 
    if( !(skip&skip_bobserver_schedule_check) )
    {
@@ -1865,15 +2784,42 @@ const bobserver_object& database::validate_block_header( uint32_t skip, const si
    return bobserver;
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::create_block_summary(const signed_block& next_block)
+void database::create_block_summary( const signed_block& next_block, const block_id_type& next_block_id )
 { try {
    block_summary_id_type sid( next_block.block_num() & 0xffff );
    modify( get< block_summary_object >( sid ), [&](block_summary_object& p) {
-         p.block_id = next_block.id();
+         p.block_id = next_block_id;
    });
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::update_global_dynamic_data( const signed_block& b )
+void database::update_block_stats( const signed_block& next_block )
+{ try {
+   const auto& stats_idx = get_index< block_stats_index >().indices().get< by_block_num >();
+
+   uint64_t total_transactions = 0;
+   uint64_t total_operations = 0;
+   if( !stats_idx.empty() )
+   {
+      total_transactions = stats_idx.rbegin()->total_transactions;
+      total_operations = stats_idx.rbegin()->total_operations;
+   }
+
+   create< block_stats_object >( [&]( block_stats_object& s )
+   {
+      s.block_num = next_block.block_num();
+      s.timestamp = next_block.timestamp;
+      s.transaction_count = next_block.transactions.size();
+      s.operation_count = _current_block_op_count;
+      s.virtual_operation_count = _current_block_virtual_op_count;
+      s.total_transactions = total_transactions + s.transaction_count;
+      s.total_operations = total_operations + s.operation_count;
+   });
+
+   while( !stats_idx.empty() && stats_idx.begin()->block_num + block_stats_object::retained_blocks < next_block.block_num() )
+      remove( *stats_idx.begin() );
+} FC_CAPTURE_AND_RETHROW() }
+
+void database::update_global_dynamic_data( const signed_block& b, const block_id_type& b_id )
 { try {
    const dynamic_global_property_object& _dgp =
       get_dynamic_global_properties();
@@ -1929,7 +2875,7 @@ void database::update_global_dynamic_data( const signed_block& b )
       }
 
       dgp.head_block_number = b.block_num();
-      dgp.head_block_id = b.id();
+      dgp.head_block_id = b_id;
       dgp.time = b.timestamp;
       dgp.current_aslot += missed_blocks+1;
    } );
@@ -2043,6 +2989,8 @@ void database::clear_expired_transactions()
    const auto& dedupe_index = transaction_idx.indices().get< by_expiration >();
    while( ( !dedupe_index.empty() ) && ( head_block_time() > dedupe_index.begin()->expiration ) )
       remove( *dedupe_index.begin() );
+
+   _recent_transactions.remove_expired( head_block_time() );
 }
 
 void database::adjust_balance( const account_object& a, const asset& delta )
@@ -0,0 +1,1130 @@
+#include <sigmaengine/chain/history_store.hpp>
+#include <sigmaengine/chain/operation_notification.hpp>
+
+#include <fc/crypto/city.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+#define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
+
+namespace sigmaengine { namespace chain { namespace detail {
+
+   struct history_key_record
+   {
+      string               key;
+      uint64_t             operation;
+   };
+
+   struct history_transaction_record
+   {
+      transaction_id_type  trx_id;
+      uint32_t             block;
+      uint32_t             trx_in_block;
+   };
+
+} } }
+
+FC_REFLECT( sigmaengine::chain::detail::history_key_record, (key)(operation) )
+FC_REFLECT( sigmaengine::chain::detail::history_transaction_record, (trx_id)(block)(trx_in_block) )
+
+namespace sigmaengine { namespace chain {
+
+   namespace bip = boost::interprocess;
+
+   namespace detail {
+      typedef std::shared_ptr< const bip::mapped_region > mapping_ptr;
+
+      /// The operations of one block and the keys they are filed under, by position in operations
+      struct history_block
+      {
+         uint32_t                                  block_num = 0;
+         vector< history_operation >               operations;
+         vector< std::pair< string, uint32_t > >   keys;
+      };
+
+      struct transaction_id_hash
+      {
+         size_t operator()( const transaction_id_type& id )const
+         {
+            return size_t( ( uint64_t( id._hash[1] ) << 32 ) | id._hash[0] );
+         }
+      };
+
+      /*
+       * A file that is only ever appended to or cut short. Appends go through a stream that is flushed
+       * once per committed block, reads through a read only mapping of the file that is replaced when a
+       * read goes past its end.
+       */
+      class append_only_file
+      {
+         public:
+            append_only_file()
+            {
+               stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+            }
+
+            /// Open p for appending, or only for reading, in which case it must exist and is never written
+            void open( const fc::path& p, bool read_only = false )
+            {
+               path = p;
+               if( read_only )
+                  FC_ASSERT( fc::exists( path ), "Missing history file ${f}", ("f", path) );
+               else
+                  stream.open( path.generic_string().c_str(), LOG_WRITE );
+               size = fc::file_size( path );
+               reset_mapping();
+            }
+
+            void close()
+            {
+               if( stream.is_open() )
+                  stream.close();
+               reset_mapping();
+               size = 0;
+            }
+
+            void truncate( uint64_t new_size )
+            {
+               if( new_size == size )
+                  return;
+
+               FC_ASSERT( new_size < size, "Cannot extend ${f} by truncating it", ("f", path)("size", size)("new_size", new_size) );
+               FC_ASSERT( stream.is_open(), "Cannot truncate ${f}, it was opened read only", ("f", path) );
+               stream.close();
+               reset_mapping();
+               fc::resize_file( path, new_size );
+               open( path );
+            }
+
+            void append( const char* data, size_t n )
+            {
+               stream.write( data, n );
+               size += n;
+            }
+
+            void append( uint64_t value )
+            {
+               append( (const char*)&value, sizeof( value ) );
+            }
+
+            void flush()
+            {
+               stream.flush();
+            }
+
+            mapping_ptr map( uint64_t required_size )const
+            {
+               FC_ASSERT( required_size > 0 && required_size <= size, "Read past the end of ${f}", ("f", path)("required", required_size)("size", size) );
+
+               std::lock_guard< std::mutex > lock( mapping_mutex );
+               if( !mapping || mapping->get_size() < required_size )
+               {
+                  bip::file_mapping fm( path.generic_string().c_str(), bip::read_only );
+                  mapping = std::make_shared< const bip::mapped_region >( fm, bip::read_only, 0, size );
+               }
+               return mapping;
+            }
+
+            uint64_t read_u64( uint64_t offset )const
+            {
+               auto m = map( offset + sizeof( uint64_t ) );
+               uint64_t result;
+               memcpy( (char*)&result, (const char*)m->get_address() + offset, sizeof( result ) );
+               return result;
+            }
+
+            /**
+             * Unpacks consecutive Records starting at offset from, passing each with its offset to f and stopping
+             * at the first record f returns false for or that is cut short. Returns the end of the accepted records.
+             */
+            template< typename Record, typename Lambda >
+            uint64_t scan( uint64_t from, Lambda&& f )const
+            {
+               if( from >= size )
+                  return from;
+
+               auto m = map( size );
+               fc::datastream< const char* > ds( (const char*)m->get_address() + from, size - from );
+               uint64_t accepted = from;
+
+               try
+               {
+                  while( ds.remaining() )
+                  {
+                     uint64_t offset = size - ds.remaining();
+                     Record r;
+                     fc::raw::unpack( ds, r );
+                     if( !f( r, offset ) )
+                        break;
+                     accepted = size - ds.remaining();
+                  }
+               }
+               catch( const fc::exception& )
+               {
+                  // A record cut short by a crash is dropped along with everything after it
+               }
+
+               return accepted;
+            }
+
+            void reset_mapping()
+            {
+               std::lock_guard< std::mutex > lock( mapping_mutex );
+               mapping.reset();
+            }
+
+            fc::path                path;
+            std::ofstream           stream;
+            uint64_t                size = 0;
+
+         private:
+            mutable mapping_ptr     mapping;
+            mutable std::mutex      mapping_mutex;
+      };
+
+      /*
+       * A file mapped read write and grown by remapping it. Only the writer grows it, so readers, which
+       * never run alongside the writer, can use the address of the current mapping directly. A file
+       * opened read only must exist and is mapped read only.
+       */
+      class mapped_file
+      {
+         public:
+            void open( const fc::path& p, bool read_only = false )
+            {
+               path = p;
+               writable = !read_only;
+               if( writable && !fc::exists( path ) )
+                  std::ofstream( path.generic_string().c_str(), LOG_WRITE );
+               remap();
+            }
+
+            void close()
+            {
+               region.reset();
+               size = 0;
+            }
+
+            void resize( uint64_t new_size )
+            {
+               FC_ASSERT( writable, "Cannot resize ${f}, it was opened read only", ("f", path) );
+               region.reset();
+               fc::resize_file( path, new_size );
+               remap();
+            }
+
+            char* data()const
+            {
+               return (char*)region->get_address();
+            }
+
+            fc::path                               path;
+            uint64_t                               size = 0;
+
+         private:
+            void remap()
+            {
+               region.reset();
+               size = fc::file_size( path );
+               if( size )
+               {
+                  auto mode = writable ? bip::read_write : bip::read_only;
+                  bip::file_mapping fm( path.generic_string().c_str(), mode );
+                  region.reset( new bip::mapped_region( fm, mode ) );
+               }
+            }
+
+            bool                                   writable = true;
+            std::unique_ptr< bip::mapped_region >  region;
+      };
+
+      struct hash_table_header
+      {
+         uint64_t    magic = 0;
+         uint32_t    version = 0;
+         uint32_t    entry_size = 0;
+         uint64_t    capacity = 0;     ///< number of entries, a power of two
+         uint64_t    count = 0;        ///< entries in use
+         uint64_t    log_size = 0;     ///< bytes of the log the table indexes, the rest is indexed again on open
+      };
+
+      /*
+       * An open addressing hash table of fixed size entries in a mapped file, indexing an append only log.
+       * The table doubles into a new file once it is half full. Entry is a plain struct with hash() and
+       * empty(); an entry that is all zeroes must be empty.
+       */
+      template< typename Entry >
+      class mapped_hash_table
+      {
+         public:
+            static const uint64_t magic_number = 0x5844494853494853; // "SHSIHIDX"
+            static const uint32_t current_version = 1;
+            static const uint64_t initial_capacity = 1 << 16;
+
+            /**
+             * Open the table at p, or start an empty one when the file is missing, was written by another
+             * version or indexes more of the log than log_size. Returns false in the latter case. A table
+             * opened read only is left unmapped instead, and finds nothing.
+             */
+            bool open( const fc::path& p, uint64_t log_size, bool read_only = false )
+            {
+               path = p;
+               if( fc::exists( path ) && fc::file_size( path ) >= sizeof( hash_table_header ) )
+               {
+                  file.open( path, read_only );
+                  const auto& h = header();
+                  if( h.magic == magic_number && h.version == current_version && h.entry_size == sizeof( Entry )
+                     && file.size == sizeof( hash_table_header ) + h.capacity * sizeof( Entry ) && h.log_size <= log_size )
+                     return true;
+                  file.close();
+               }
+
+               if( !read_only )
+                  create( path, initial_capacity );
+               return false;
+            }
+
+            void close()
+            {
+               file.close();
+            }
+
+            bool is_mapped()const
+            {
+               return file.size > 0;
+            }
+
+            hash_table_header& header()const
+            {
+               return *(hash_table_header*)file.data();
+            }
+
+            /// The entry with the given hash that match accepts, valid until the next insert
+            template< typename Match >
+            Entry* lookup( uint64_t hash, Match&& match )const
+            {
+               if( !is_mapped() )
+                  return nullptr;
+
+               uint64_t mask = header().capacity - 1;
+               for( uint64_t i = hash & mask; !entries()[i].empty(); i = ( i + 1 ) & mask )
+               {
+                  if( entries()[i].hash() == hash && match( entries()[i] ) )
+                     return entries() + i;
+               }
+               return nullptr;
+            }
+
+            /// Add an entry that is not in the table yet, the returned reference is valid until the next insert
+            Entry& insert( const Entry& e )
+            {
+               if( ( header().count + 1 ) * 2 > header().capacity )
+                  grow();
+
+               uint64_t mask = header().capacity - 1;
+               uint64_t i = e.hash() & mask;
+               while( !entries()[i].empty() )
+                  i = ( i + 1 ) & mask;
+
+               memcpy( (char*)( entries() + i ), (const char*)&e, sizeof( Entry ) );
+               ++header().count;
+               return entries()[i];
+            }
+
+            template< typename Lambda >
+            void for_each( Lambda&& f )const
+            {
+               if( !is_mapped() )
+                  return;
+
+               for( uint64_t i = 0; i < header().capacity; ++i )
+               {
+                  if( !entries()[i].empty() )
+                     f( entries()[i] );
+               }
+            }
+
+         private:
+            Entry* entries()const
+            {
+               return (Entry*)( file.data() + sizeof( hash_table_header ) );
+            }
+
+            void create( const fc::path& p, uint64_t capacity )
+            {
+               path = p;
+               if( fc::exists( path ) )
+                  fc::remove( path );
+               file.open( path );
+               file.resize( sizeof( hash_table_header ) + capacity * sizeof( Entry ) );
+
+               auto& h = header();
+               h.magic = magic_number;
+               h.version = current_version;
+               h.entry_size = sizeof( Entry );
+               h.capacity = capacity;
+            }
+
+            void grow()
+            {
+               fc::path final_path = path;
+               fc::path tmp = path.generic_string() + ".tmp";
+
+               mapped_hash_table< Entry > bigger;
+               bigger.create( tmp, header().capacity * 2 );
+               for_each( [&]( const Entry& e ) { bigger.insert( e ); } );
+               bigger.header().log_size = header().log_size;
+               bigger.close();
+
+               file.close();
+               fc::rename( tmp, final_path );
+               path = final_path;
+               file.open( path );
+            }
+
+            fc::path       path;
+            mapped_file    file;
+      };
+
+      /**
+       * The operations filed under one key. Sequence numbers are split over pages of 4, 8, 16, ... operation
+       * numbers, so the page holding any sequence number is found without walking the sequence.
+       */
+      struct sequence_entry
+      {
+         static const uint32_t inline_pages = 4;
+         static const uint32_t max_pages = 32;
+
+         uint64_t    key_hash = 0;                ///< never zero for an entry in use
+         uint64_t    key_record = 0;              ///< offset in keys of the first record of the key
+         uint32_t    key_size = 0;
+         uint32_t    size = 0;                    ///< operations filed under the key
+         uint64_t    pages[ inline_pages ] = {};  ///< offsets in keys.pages of the first pages
+         uint64_t    directory = 0;               ///< offset in keys.pages of the offsets of the other pages, zero until needed
+
+         uint64_t hash()const { return key_hash; }
+         bool empty()const { return key_hash == 0; }
+      };
+
+      struct transaction_entry
+      {
+         transaction_id_type  trx_id;
+         uint32_t             block = 0;          ///< never zero for an entry in use
+         uint32_t             trx_in_block = 0;
+
+         uint64_t hash()const { return transaction_id_hash()( trx_id ); }
+         bool empty()const { return block == 0; }
+      };
+
+      class history_store_impl
+      {
+         public:
+            append_only_file     operations;
+            append_only_file     operation_index;
+            append_only_file     block_index;
+            append_only_file     keys;
+            append_only_file     transactions;
+
+            bool                 is_open = false;
+            bool                 read_only = false;
+            uint32_t             head_block = 0;
+            uint64_t             stored_operations = 0;
+
+            /// Operation numbers filed under each key, the first 8 bytes hold the allocated size
+            mapped_file                               sequence_pages;
+            mapped_hash_table< sequence_entry >       sequence_table;
+            mapped_hash_table< transaction_entry >    transaction_table;
+
+            /// The keys and transactions of the reversible blocks, and in a read only store those the indexes are missing
+            std::unordered_map< string, std::deque< uint64_t > >   recent_sequences;
+            std::unordered_map< transaction_id_type, std::pair< uint32_t, uint32_t >, transaction_id_hash >   recent_transactions;
+
+            std::deque< history_block >   reversible;
+            optional< history_block >     building;
+
+            /// Number of operations on disk up to and including block_num
+            uint64_t stored_operations_through( uint32_t block_num )const
+            {
+               return block_num ? block_index.read_u64( uint64_t( block_num - 1 ) * sizeof( uint64_t ) ) : 0;
+            }
+
+            history_operation read_operation( uint64_t operation_num )const
+            {
+               uint64_t begin = operation_num ? operation_index.read_u64( ( operation_num - 1 ) * sizeof( uint64_t ) ) : 0;
+               uint64_t end = operation_index.read_u64( operation_num * sizeof( uint64_t ) );
+
+               auto m = operations.map( end );
+               fc::datastream< const char* > ds( (const char*)m->get_address() + begin, end - begin );
+               history_operation result;
+               fc::raw::unpack( ds, result );
+               return result;
+            }
+
+            const history_operation& reversible_operation( uint64_t operation_num )const
+            {
+               uint64_t n = operation_num - stored_operations;
+               for( const auto& b : reversible )
+               {
+                  if( n < b.operations.size() )
+                     return b.operations[ n ];
+                  n -= b.operations.size();
+               }
+               FC_THROW_EXCEPTION( fc::out_of_range_exception, "Unknown history operation ${n}", ("n", operation_num) );
+            }
+
+            static uint64_t key_hash( const string& key )
+            {
+               uint64_t hash = fc::city_hash64( key.data(), key.size() );
+               return hash ? hash : 1;
+            }
+
+            string key_at( uint64_t key_record )const
+            {
+               auto m = keys.map( keys.size );
+               fc::datastream< const char* > ds( (const char*)m->get_address() + key_record, keys.size - key_record );
+               string key;
+               fc::raw::unpack( ds, key );
+               return key;
+            }
+
+            sequence_entry* find_sequence( const string& key )const
+            {
+               return sequence_table.lookup( key_hash( key ), [&]( const sequence_entry& e )
+               {
+                  return e.key_size == key.size() && key_at( e.key_record ) == key;
+               });
+            }
+
+            uint64_t page_u64( uint64_t offset )const
+            {
+               uint64_t result;
+               memcpy( (char*)&result, sequence_pages.data() + offset, sizeof( result ) );
+               return result;
+            }
+
+            void set_page_u64( uint64_t offset, uint64_t value )
+            {
+               memcpy( sequence_pages.data() + offset, (const char*)&value, sizeof( value ) );
+            }
+
+            /// Page of sequence number seq and its position in the page
+            static uint32_t page_of( uint32_t seq, uint32_t& pos )
+            {
+               uint32_t page = 0;
+               while( seq >= ( 4u << page ) )
+                  seq -= 4u << page++;
+               pos = seq;
+               return page;
+            }
+
+            uint64_t page_offset( const sequence_entry& e, uint32_t page )const
+            {
+               if( page < sequence_entry::inline_pages )
+                  return e.pages[ page ];
+               return page_u64( e.directory + ( page - sequence_entry::inline_pages ) * sizeof( uint64_t ) );
+            }
+
+            uint64_t sequence_at( const sequence_entry& e, uint32_t seq )const
+            {
+               uint32_t pos;
+               uint32_t page = page_of( seq, pos );
+               return page_u64( page_offset( e, page ) + pos * sizeof( uint64_t ) );
+            }
+
+            void reset_sequence_pages()
+            {
+               sequence_pages.resize( 0 );
+               sequence_pages.resize( 1024 * 1024 );
+               set_page_u64( 0, sizeof( uint64_t ) );
+            }
+
+            /// Zeroed space in keys.pages
+            uint64_t allocate_pages( uint64_t bytes )
+            {
+               uint64_t offset = page_u64( 0 );
+               if( offset + bytes > sequence_pages.size )
+                  sequence_pages.resize( std::max( sequence_pages.size * 2, offset + bytes ) );
+               set_page_u64( 0, offset + bytes );
+               return offset;
+            }
+
+            void file_operation( const string& key, uint64_t key_record, uint64_t operation_num )
+            {
+               sequence_entry* e = find_sequence( key );
+               if( !e )
+               {
+                  sequence_entry created;
+                  created.key_hash = key_hash( key );
+                  created.key_record = key_record;
+                  created.key_size = key.size();
+                  e = &sequence_table.insert( created );
+               }
+
+               // Filings indexed again after a crash may already be there
+               if( e->size && sequence_at( *e, e->size - 1 ) >= operation_num )
+                  return;
+
+               uint32_t pos;
+               uint32_t page = page_of( e->size, pos );
+               FC_ASSERT( page < sequence_entry::max_pages, "History sequence ${k} is full", ("k", key) );
+               if( pos == 0 )
+               {
+                  uint64_t offset = allocate_pages( ( uint64_t( 4 ) << page ) * sizeof( uint64_t ) );
+                  if( page < sequence_entry::inline_pages )
+                  {
+                     e->pages[ page ] = offset;
+                  }
+                  else
+                  {
+                     if( !e->directory )
+                        e->directory = allocate_pages( ( sequence_entry::max_pages - sequence_entry::inline_pages ) * sizeof( uint64_t ) );
+                     set_page_u64( e->directory + ( page - sequence_entry::inline_pages ) * sizeof( uint64_t ), offset );
+                  }
+               }
+
+               set_page_u64( page_offset( *e, page ) + pos * sizeof( uint64_t ), operation_num );
+               ++e->size;
+            }
+
+            void index_transaction( const transaction_id_type& trx_id, uint32_t block, uint32_t trx_in_block )
+            {
+               transaction_entry entry;
+               entry.trx_id = trx_id;
+               if( transaction_table.lookup( entry.hash(), [&]( const transaction_entry& e ) { return e.trx_id == trx_id; } ) )
+                  return;
+
+               entry.block = block;
+               entry.trx_in_block = trx_in_block;
+               transaction_table.insert( entry );
+            }
+
+            /// Open the indexes and index the records appended after their last update, cutting off uncommitted ones
+            void open_indexes( const fc::path& dir )
+            {
+               if( !sequence_table.open( dir / "keys.index", keys.size ) )
+                  ilog( "Indexing history keys, this only happens once" );
+               sequence_pages.open( dir / "keys.pages" );
+               if( sequence_table.header().log_size == 0 || sequence_pages.size < sizeof( uint64_t ) )
+               {
+                  sequence_table.close();
+                  fc::remove( dir / "keys.index" );
+                  sequence_table.open( dir / "keys.index", 0 );
+                  reset_sequence_pages();
+               }
+
+               uint64_t keys_size = keys.scan< history_key_record >( sequence_table.header().log_size,
+                  [&]( const history_key_record& r, uint64_t offset )
+               {
+                  if( r.operation >= stored_operations )
+                     return false;
+                  file_operation( r.key, offset, r.operation );
+                  return true;
+               });
+               keys.truncate( keys_size );
+               sequence_table.header().log_size = keys_size;
+
+               if( !transaction_table.open( dir / "transactions.index", transactions.size ) )
+                  ilog( "Indexing history transactions, this only happens once" );
+
+               uint64_t transactions_size = transactions.scan< history_transaction_record >( transaction_table.header().log_size,
+                  [&]( const history_transaction_record& r, uint64_t )
+               {
+                  if( r.block > head_block )
+                     return false;
+                  index_transaction( r.trx_id, r.block, r.trx_in_block );
+                  return true;
+               });
+               transactions.truncate( transactions_size );
+               transaction_table.header().log_size = transactions_size;
+            }
+
+            /**
+             * Map the indexes read only, if they are there, and keep the committed records appended after their
+             * last update in memory. Nothing is written, so a missing index is not built but read into memory.
+             */
+            void open_indexes_read_only( const fc::path& dir )
+            {
+               if( sequence_table.open( dir / "keys.index", keys.size, true ) && fc::exists( dir / "keys.pages" ) )
+                  sequence_pages.open( dir / "keys.pages", true );
+               if( sequence_pages.size < sizeof( uint64_t ) )
+                  sequence_table.close();
+               if( !sequence_table.is_mapped() )
+                  wlog( "History key index is missing, reading all keys into memory" );
+
+               keys.scan< history_key_record >( sequence_table.is_mapped() ? sequence_table.header().log_size : 0,
+                  [&]( const history_key_record& r, uint64_t )
+               {
+                  if( r.operation >= stored_operations )
+                     return false;
+
+                  // Filings indexed before a crash may be in the table already
+                  auto itr = recent_sequences.find( r.key );
+                  if( itr != recent_sequences.end() )
+                  {
+                     if( itr->second.back() < r.operation )
+                        itr->second.push_back( r.operation );
+                     return true;
+                  }
+
+                  const sequence_entry* e = find_sequence( r.key );
+                  if( !e || !e->size || sequence_at( *e, e->size - 1 ) < r.operation )
+                     recent_sequences[ r.key ].push_back( r.operation );
+                  return true;
+               });
+
+               if( !transaction_table.open( dir / "transactions.index", transactions.size, true ) )
+                  wlog( "History transaction index is missing, reading all transactions into memory" );
+
+               transactions.scan< history_transaction_record >( transaction_table.is_mapped() ? transaction_table.header().log_size : 0,
+                  [&]( const history_transaction_record& r, uint64_t )
+               {
+                  if( r.block > head_block )
+                     return false;
+
+                  transaction_entry entry;
+                  entry.trx_id = r.trx_id;
+                  if( !transaction_table.lookup( entry.hash(), [&]( const transaction_entry& e ) { return e.trx_id == r.trx_id; } ) )
+                     recent_transactions.emplace( r.trx_id, std::make_pair( r.block, r.trx_in_block ) );
+                  return true;
+               });
+            }
+
+            void write_block( const history_block& b )
+            {
+               // Blocks the store never saw, e.g. those applied before history was enabled, have no operations
+               while( head_block + 1 < b.block_num )
+               {
+                  block_index.append( stored_operations );
+                  ++head_block;
+               }
+
+               uint64_t first = stored_operations;
+               transaction_id_type last_trx_id;
+
+               for( const auto& op : b.operations )
+               {
+                  auto data = fc::raw::pack( op );
+                  operations.append( data.data(), data.size() );
+                  operation_index.append( operations.size );
+
+                  if( op.trx_id != transaction_id_type() && op.trx_id != last_trx_id )
+                  {
+                     auto record = fc::raw::pack( history_transaction_record{ op.trx_id, op.block, op.trx_in_block } );
+                     transactions.append( record.data(), record.size() );
+                     last_trx_id = op.trx_id;
+                  }
+               }
+
+               vector< uint64_t > key_records;
+               key_records.reserve( b.keys.size() );
+               for( const auto& k : b.keys )
+               {
+                  key_records.push_back( keys.size );
+                  auto record = fc::raw::pack( history_key_record{ k.first, first + k.second } );
+                  keys.append( record.data(), record.size() );
+               }
+
+               operations.flush();
+               operation_index.flush();
+               keys.flush();
+               transactions.flush();
+
+               // The block is only committed once its entry in the block index is written
+               block_index.append( first + b.operations.size() );
+               block_index.flush();
+
+               // The indexes are updated after the commit, open() indexes whatever they missed again
+               for( size_t i = 0; i < b.keys.size(); ++i )
+                  file_operation( b.keys[i].first, key_records[i], first + b.keys[i].second );
+               sequence_table.header().log_size = keys.size;
+
+               for( const auto& op : b.operations )
+               {
+                  if( op.trx_id != transaction_id_type() )
+                     index_transaction( op.trx_id, op.block, op.trx_in_block );
+               }
+               transaction_table.header().log_size = transactions.size;
+
+               stored_operations += b.operations.size();
+               head_block = b.block_num;
+            }
+      };
+   }
+
+   history_store::history_store()
+   :my( new detail::history_store_impl() )
+   {}
+
+   history_store::~history_store() {}
+
+   void history_store::open( const fc::path& dir, bool read_only )
+   { try {
+      close();
+
+      if( !read_only )
+         fc::create_directories( dir );
+      my->read_only = read_only;
+      my->operations.open( dir / "operations", read_only );
+      my->operation_index.open( dir / "operations.index", read_only );
+      my->block_index.open( dir / "blocks.index", read_only );
+      my->keys.open( dir / "keys", read_only );
+      my->transactions.open( dir / "transactions", read_only );
+
+      // blocks.index is appended last, so everything past the operations it counts belongs to a block that was never committed.
+      // A read only store leaves it in place and reads no further than the committed blocks.
+      my->head_block = my->block_index.size / sizeof( uint64_t );
+      if( !read_only )
+         my->block_index.truncate( my->head_block * sizeof( uint64_t ) );
+      my->stored_operations = my->stored_operations_through( my->head_block );
+
+      FC_ASSERT( my->operation_index.size >= my->stored_operations * sizeof( uint64_t ),
+         "History operation index is missing committed operations", ("operations", my->stored_operations)("index_size", my->operation_index.size) );
+      if( !read_only )
+         my->operation_index.truncate( my->stored_operations * sizeof( uint64_t ) );
+
+      uint64_t operations_size = my->stored_operations ? my->operation_index.read_u64( ( my->stored_operations - 1 ) * sizeof( uint64_t ) ) : 0;
+      FC_ASSERT( my->operations.size >= operations_size, "History operations file is missing committed operations",
+         ("size", my->operations.size)("expected", operations_size) );
+      if( !read_only )
+         my->operations.truncate( operations_size );
+
+      if( read_only )
+         my->open_indexes_read_only( dir );
+      else
+         my->open_indexes( dir );
+
+      my->is_open = true;
+
+      ilog( "Opened history store with ${o} operations under ${k} keys up to block ${b}",
+         ("o", my->stored_operations)("k", my->sequence_table.is_mapped() ? my->sequence_table.header().count : 0)("b", my->head_block) );
+   } FC_CAPTURE_AND_RETHROW( (dir)(read_only) ) }
+
+   void history_store::close()
+   {
+      my.reset( new detail::history_store_impl() );
+   }
+
+   bool history_store::is_open()const
+   {
+      return my->is_open;
+   }
+
+   uint32_t history_store::head_block_num()const
+   {
+      return my->head_block;
+   }
+
+   void history_store::start_block( uint32_t block_num )
+   {
+      if( !my->is_open || my->read_only )
+         return;
+
+      pop_blocks( block_num );
+      my->building.reset();
+
+      if( block_num > my->head_block )
+      {
+         my->building = detail::history_block();
+         my->building->block_num = block_num;
+      }
+   }
+
+   void history_store::add_operation( const operation_notification& note, fc::time_point_sec timestamp, const string& key )
+   {
+      if( !my->building )
+         return;
+
+      auto& b = *my->building;
+      if( b.operations.empty()
+         || b.operations.back().trx_id != note.trx_id
+         || b.operations.back().trx_in_block != note.trx_in_block
+         || b.operations.back().op_in_trx != note.op_in_trx
+         || b.operations.back().virtual_op != note.virtual_op )
+      {
+         b.operations.emplace_back();
+         auto& op = b.operations.back();
+         op.trx_id       = note.trx_id;
+         op.block        = note.block;
+         op.trx_in_block = note.trx_in_block;
+         op.op_in_trx    = note.op_in_trx;
+         op.virtual_op   = note.virtual_op;
+         op.timestamp    = timestamp;
+         op.op           = note.op;
+      }
+
+      // An operation impacting several dapps files shared keys once per dapp, keep only the first filing
+      // so the reversible view counts it once, as the sequence files do once the block is irreversible
+      uint32_t operation_index = b.operations.size() - 1;
+      for( auto itr = b.keys.rbegin(); itr != b.keys.rend() && itr->second == operation_index; ++itr )
+      {
+         if( itr->first == key )
+            return;
+      }
+
+      b.keys.emplace_back( key, operation_index );
+   }
+
+   uint32_t history_store::pending_operation_count()const
+   {
+      return my->building ? my->building->operations.size() : 0;
+   }
+
+   void history_store::discard_pending_operations( uint32_t count )
+   {
+      if( !my->building )
+         return;
+
+      auto& b = *my->building;
+      while( b.keys.size() && b.keys.back().second >= count )
+         b.keys.pop_back();
+      if( b.operations.size() > count )
+         b.operations.resize( count );
+   }
+
+   void history_store::finish_block()
+   {
+      if( !my->building )
+         return;
+
+      uint64_t first = operation_count();
+      for( const auto& k : my->building->keys )
+         my->recent_sequences[ k.first ].push_back( first + k.second );
+      for( const auto& op : my->building->operations )
+      {
+         if( op.trx_id != transaction_id_type() )
+            my->recent_transactions.emplace( op.trx_id, std::make_pair( op.block, op.trx_in_block ) );
+      }
+
+      my->reversible.push_back( std::move( *my->building ) );
+      my->building.reset();
+   }
+
+   void history_store::pop_blocks( uint32_t block_num )
+   {
+      while( my->reversible.size() && my->reversible.back().block_num >= block_num )
+      {
+         const auto& b = my->reversible.back();
+         for( auto itr = b.keys.rbegin(); itr != b.keys.rend(); ++itr )
+         {
+            auto seq = my->recent_sequences.find( itr->first );
+            seq->second.pop_back();
+            if( seq->second.empty() )
+               my->recent_sequences.erase( seq );
+         }
+         for( const auto& op : b.operations )
+            my->recent_transactions.erase( op.trx_id );
+
+         my->reversible.pop_back();
+      }
+
+      if( my->building && my->building->block_num >= block_num )
+         my->building.reset();
+   }
+
+   void history_store::commit( uint32_t last_irreversible_block )
+   { try {
+      while( my->reversible.size() && my->reversible.front().block_num <= last_irreversible_block )
+      {
+         const auto& b = my->reversible.front();
+         if( b.block_num > my->head_block )
+            my->write_block( b );
+
+         for( const auto& k : b.keys )
+         {
+            auto seq = my->recent_sequences.find( k.first );
+            seq->second.pop_front();
+            if( seq->second.empty() )
+               my->recent_sequences.erase( seq );
+         }
+         for( const auto& op : b.operations )
+            my->recent_transactions.erase( op.trx_id );
+
+         my->reversible.pop_front();
+      }
+   } FC_CAPTURE_AND_RETHROW( (last_irreversible_block) ) }
+
+   uint64_t history_store::operation_count()const
+   {
+      uint64_t count = my->stored_operations;
+      for( const auto& b : my->reversible )
+         count += b.operations.size();
+      return count;
+   }
+
+   history_operation history_store::get_operation( uint64_t operation_num )const
+   {
+      if( operation_num < my->stored_operations )
+         return my->read_operation( operation_num );
+      return my->reversible_operation( operation_num );
+   }
+
+   vector< history_operation > history_store::get_block_operations( uint32_t block_num )const
+   {
+      vector< history_operation > result;
+
+      if( block_num > 0 && block_num <= my->head_block )
+      {
+         uint64_t end = my->stored_operations_through( block_num );
+         for( uint64_t n = my->stored_operations_through( block_num - 1 ); n < end; ++n )
+            result.push_back( my->read_operation( n ) );
+      }
+      else
+      {
+         for( const auto& b : my->reversible )
+         {
+            if( b.block_num == block_num )
+               result = b.operations;
+         }
+      }
+
+      return result;
+   }
+
+   uint32_t history_store::sequence_size( const string& key )const
+   {
+      if( !my->is_open )
+         return 0;
+
+      uint32_t size = 0;
+
+      if( const detail::sequence_entry* stored = my->find_sequence( key ) )
+         size = stored->size;
+
+      auto itr = my->recent_sequences.find( key );
+      if( itr != my->recent_sequences.end() )
+         size += itr->second.size();
+
+      return size;
+   }
+
+   vector< std::pair< uint32_t, history_operation > > history_store::get_sequence( const string& key, uint64_t from, uint32_t limit )const
+   {
+      vector< std::pair< uint32_t, history_operation > > result;
+      if( !my->is_open )
+         return result;
+
+      const detail::sequence_entry* stored = my->find_sequence( key );
+      uint64_t stored_size = stored ? stored->size : 0;
+
+      static const std::deque< uint64_t > empty;
+      auto itr = my->recent_sequences.find( key );
+      const std::deque< uint64_t >& recent = itr != my->recent_sequences.end() ? itr->second : empty;
+
+      uint64_t total = stored_size + recent.size();
+      if( total == 0 )
+         return result;
+
+      uint64_t start = std::min( from, total - 1 );
+      uint64_t stop = start > limit ? start - limit : 0;
+      result.reserve( start - stop + 1 );
+
+      for( uint64_t seq = start + 1; seq-- > stop; )
+      {
+         uint64_t operation_num = seq < stored_size ? my->sequence_at( *stored, seq ) : recent[ seq - stored_size ];
+         result.emplace_back( seq, get_operation( operation_num ) );
+      }
+
+      return result;
+   }
+
+   optional< std::pair< uint32_t, uint32_t > > history_store::find_transaction( const transaction_id_type& id )const
+   {
+      auto itr = my->recent_transactions.find( id );
+      if( itr != my->recent_transactions.end() )
+         return itr->second;
+
+      if( my->is_open )
+      {
+         detail::transaction_entry entry;
+         entry.trx_id = id;
+         if( const detail::transaction_entry* stored = my->transaction_table.lookup( entry.hash(), [&]( const detail::transaction_entry& e ) { return e.trx_id == id; } ) )
+            return std::make_pair( stored->block, stored->trx_in_block );
+      }
+
+      return optional< std::pair< uint32_t, uint32_t > >();
+   }
+
+   history_store_stats history_store::get_stats()const
+   { try {
+      history_store_stats stats;
+      stats.head_block = my->head_block;
+      stats.operations = my->stored_operations;
+      stats.operation_bytes = my->stored_operations ? my->operation_index.read_u64( ( my->stored_operations - 1 ) * sizeof( uint64_t ) ) : 0;
+
+      // One bit per owner for every operation on disk
+      vector< string > owners;
+      vector< uint32_t > operation_owners( my->stored_operations );
+
+      auto owner_bit = [&]( const string& key ) -> uint32_t
+      {
+         string owner = history_key_owner( key );
+         auto itr = std::find( owners.begin(), owners.end(), owner );
+         if( itr == owners.end() )
+         {
+            FC_ASSERT( owners.size() < 32, "Too many history key owners" );
+            owners.push_back( owner );
+            return owners.size() - 1;
+         }
+         return itr - owners.begin();
+      };
+
+      my->sequence_table.for_each( [&]( const detail::sequence_entry& seq )
+      {
+         uint32_t bit = owner_bit( my->key_at( seq.key_record ) );
+         stats.filings += seq.size;
+         for( uint32_t n = 0; n < seq.size; ++n )
+            operation_owners[ my->sequence_at( seq, n ) ] |= 1u << bit;
+      });
+
+      // Filings the index is missing, only operations on disk are counted
+      for( const auto& seq : my->recent_sequences )
+      {
+         uint32_t bit = owner_bit( seq.first );
+         for( uint64_t operation_num : seq.second )
+         {
+            if( operation_num < my->stored_operations )
+            {
+               stats.filings += 1;
+               operation_owners[ operation_num ] |= 1u << bit;
+            }
+         }
+      }
+
+      uint64_t begin = 0;
+      for( uint64_t n = 0; n < my->stored_operations; ++n )
+      {
+         uint64_t end = my->operation_index.read_u64( n * sizeof( uint64_t ) );
+         uint64_t bytes = end - begin;
+         begin = end;
+
+         std::bitset< 32 > filed_by( operation_owners[ n ] );
+         for( uint32_t bit = 0; bit < owners.size(); ++bit )
+         {
+            if( filed_by[ bit ] )
+            {
+               stats.owner_operations[ owners[ bit ] ] += 1;
+               stats.owner_bytes[ owners[ bit ] ] += bytes;
+            }
+         }
+
+         if( filed_by.count() > 1 )
+         {
+            stats.shared_operations += 1;
+            stats.shared_bytes_saved += ( filed_by.count() - 1 ) * bytes;
+         }
+      }
+
+      return stats;
+   } FC_CAPTURE_AND_RETHROW() }
+
+} }
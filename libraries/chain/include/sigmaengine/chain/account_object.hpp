@@ -9,6 +9,7 @@
 #include <sigmaengine/chain/shared_authority.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/ranked_index.hpp>
 
 #include <numeric>
 
@@ -159,7 +160,8 @@ namespace sigmaengine { namespace chain {
             >,
             composite_key_compare< std::greater< time_point_sec >, std::less< account_id_type > >
          >,
-         ordered_unique< tag< by_balance >,
+         /// Ranked so the rich list can be paged with nth() and an account's place found with rank()
+         ranked_unique< tag< by_balance >,
             composite_key< account_object,
                member< account_object, asset, &account_object::balance >,
                member< account_object, account_id_type, &account_object::id >
@@ -31,10 +31,42 @@ namespace sigmaengine { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * A second sidecar file, block_log.headers, holds one fixed size record per block with the block id,
+    * timestamp, signing bobserver, transaction count and packed size. Record n lives at
+    * header_record_size * (n - 1), so header only queries never unpack a block. Like the index it is
+    * rebuilt from the main file whenever it is missing or does not match the head block.
+    *
+    * Appends go through append only streams that are flushed after every block. Reads go through read
+    * only memory mappings of both files, so reading never has to reopen the streams and readers on other
+    * threads do not contend with the writer. A mapping is only replaced when a read goes past its end.
     */
 
    class block_log {
       public:
+         /**
+          * The packed bytes of a single block, pointing directly into the mapped block log. The view
+          * holds a reference to its mapping and remains valid after the log grows or is remapped.
+          */
+         struct serialized_block
+         {
+            std::shared_ptr< const void > mapping;
+            const char*                   data = nullptr;
+            size_t                        size = 0;
+         };
+
+         /**
+          * A fixed size summary of a block, read from the header sidecar file.
+          */
+         struct header_record
+         {
+            block_id_type        id;
+            fc::time_point_sec   timestamp;
+            account_name_type    bobserver;
+            uint32_t             transaction_count = 0;
+            uint32_t             byte_size = 0;
+         };
+
          block_log();
          ~block_log();
 
@@ -47,6 +79,18 @@ namespace sigmaengine { namespace chain {
          std::pair< signed_block, uint64_t > read_block( uint64_t file_pos )const;
          optional< signed_block > read_block_by_num( uint32_t block_num )const;
 
+         /**
+          * Return the packed bytes of a block without unpacking them, or an invalid optional if the
+          * block is not in the log.
+          */
+         optional< serialized_block > read_serialized_block_by_num( uint32_t block_num )const;
+
+         /**
+          * Return the header record of a block without touching the main file, or an invalid optional if
+          * the block is not in the log.
+          */
+         optional< header_record > read_header_by_num( uint32_t block_num )const;
+
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
@@ -56,8 +100,12 @@ namespace sigmaengine { namespace chain {
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
+         /** Size of a header record on disk: id, timestamp, 16 byte bobserver name, transaction count, byte size */
+         static const uint64_t header_record_size = 20 + 4 + 16 + 4 + 4;
+
       private:
          void construct_index();
+         void construct_header_index( uint32_t first_block );
 
          std::unique_ptr<detail::block_log_impl> my;
    };
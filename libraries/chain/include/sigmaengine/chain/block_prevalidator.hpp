@@ -0,0 +1,62 @@
+#pragma once
+#include <sigmaengine/protocol/block.hpp>
+
+#include <sigmaengine/chain/signature_recovery_pool.hpp>
+
+#include <memory>
+
+namespace sigmaengine { namespace chain {
+
+   using namespace sigmaengine::protocol;
+
+   namespace detail { class block_prevalidator_impl; }
+
+   /**
+    * The parts of validating a block that do not depend on chain state, computed ahead of time.
+    * Values that could not be computed are left unset, and push_block computes them itself.
+    * The block id only covers the header, so the results are used for a body only when its
+    * merkle root matches merkle_root.
+    */
+   struct prevalidated_block
+   {
+      block_id_type                        id;
+      optional< checksum_type >            merkle_root;
+      optional< fc::ecc::public_key >      signee;
+
+      /// Empty when the transaction signatures were not recovered
+      vector< recovered_signature_keys >   transaction_keys;
+   };
+
+   typedef std::shared_ptr< const prevalidated_block > prevalidated_block_ptr;
+
+   /* Computes block ids, merkle roots, block signees and transaction signer keys for blocks that
+    * are waiting to be pushed, on a fixed pool of worker threads. The P2P layer submits sync blocks
+    * as they arrive, so while the chain applies one block the workers are already checking the
+    * ones after it, and push_block only has to compare the results.
+    *
+    * Results that are never taken are dropped, oldest first, once max_blocks blocks are held.
+    */
+   class block_prevalidator
+   {
+      public:
+         block_prevalidator( uint32_t worker_threads, uint32_t max_blocks );
+         ~block_prevalidator();
+
+         /**
+          * Queue block for the workers under the id it was announced with and return immediately. The
+          * workers compute the real id, so a block announced under the wrong id is never taken.
+          * Does nothing for an id that is already held.
+          */
+         void submit( const block_id_type& id, const signed_block& block, bool recover_transaction_keys );
+
+         /**
+          * Remove and return the results for block id. Waits for a block a worker is busy with, and
+          * returns null for a block that was never submitted or that no worker has started on yet.
+          */
+         prevalidated_block_ptr take( const block_id_type& id );
+
+      private:
+         std::unique_ptr< detail::block_prevalidator_impl > my;
+   };
+
+} }
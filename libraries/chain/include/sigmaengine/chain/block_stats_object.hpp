@@ -0,0 +1,56 @@
+#pragma once
+#include <sigmaengine/chain/sigmaengine_object_types.hpp>
+
+namespace sigmaengine { namespace chain {
+
+   /**
+    *  @brief running transaction and operation counts as of one recent block
+    *  @ingroup object
+    *
+    *  One object is created for every applied block and removed once it is more than
+    *  retained_blocks behind the head block. The totals are cumulative from genesis, so the
+    *  number of operations applied after a block is the difference between the head block
+    *  totals and that block's totals.
+    */
+   class block_stats_object : public object< block_stats_object_type, block_stats_object >
+   {
+      public:
+         template< typename Constructor, typename Allocator >
+         block_stats_object( Constructor&& c, allocator< Allocator > a )
+         {
+            c( *this );
+         }
+
+         block_stats_object(){};
+
+         /// Enough history for the 16 one day windows of database_api::get_transaction_day_count
+         static const uint32_t retained_blocks = SIGMAENGINE_BLOCKS_PER_DAY * 17;
+
+         id_type        id;
+         uint32_t       block_num = 0;
+         time_point_sec timestamp;
+
+         uint32_t       transaction_count = 0;        ///< transactions in this block
+         uint32_t       operation_count = 0;          ///< operations in this block, including virtual operations
+         uint32_t       virtual_operation_count = 0;  ///< virtual operations in this block
+         uint64_t       total_transactions = 0;       ///< transactions up to and including this block
+         uint64_t       total_operations = 0;         ///< operations up to and including this block
+   };
+
+   struct by_block_num;
+
+   typedef multi_index_container<
+      block_stats_object,
+      indexed_by<
+         ordered_unique< tag< by_id >,
+            member< block_stats_object, block_stats_id_type, &block_stats_object::id > >,
+         ordered_unique< tag< by_block_num >,
+            member< block_stats_object, uint32_t, &block_stats_object::block_num > >
+      >,
+      allocator< block_stats_object >
+   > block_stats_index;
+
+} } // sigmaengine::chain
+
+FC_REFLECT( sigmaengine::chain::block_stats_object, (id)(block_num)(timestamp)(transaction_count)(operation_count)(virtual_operation_count)(total_transactions)(total_operations) )
+CHAINBASE_SET_INDEX_TYPE( sigmaengine::chain::block_stats_object, sigmaengine::chain::block_stats_index )
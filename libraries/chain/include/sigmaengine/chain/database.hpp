@@ -7,7 +7,13 @@
 #include <sigmaengine/chain/node_property_object.hpp>
 #include <sigmaengine/chain/fork_database.hpp>
 #include <sigmaengine/chain/block_log.hpp>
+#include <sigmaengine/chain/block_stats_object.hpp>
+#include <sigmaengine/chain/history_store.hpp>
+#include <sigmaengine/chain/recent_transaction_cache.hpp>
 #include <sigmaengine/chain/operation_notification.hpp>
+#include <sigmaengine/chain/precomputed_transaction.hpp>
+#include <sigmaengine/chain/signature_recovery_pool.hpp>
+#include <sigmaengine/chain/block_prevalidator.hpp>
 
 #include <sigmaengine/protocol/protocol.hpp>
 #include <sigmaengine/protocol/hardfork.hpp>
@@ -17,7 +23,9 @@
 
 #include <fc/log/logger.hpp>
 
+#include <future>
 #include <map>
+#include <unordered_map>
 
 namespace sigmaengine { namespace chain {
 
@@ -30,11 +38,20 @@ namespace sigmaengine { namespace chain {
 
    class database_impl;
    class custom_operation_interpreter;
+   struct captured_snapshot;
+   struct replayed_block;
 
    namespace util {
       struct comment_reward_context;
    }
 
+   /// State the pending transactions' checks depend on that changed since they were last applied
+   struct pending_transaction_changes
+   {
+      flat_set< account_name_type >   authorities;        ///< accounts whose authority object changed
+      flat_set< uint32_t >            block_summaries;    ///< TaPoS slots that now refer to another block
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -88,6 +105,23 @@ namespace sigmaengine { namespace chain {
           */
          void reindex( const fc::path& data_dir, const fc::path& shared_mem_dir, uint64_t shared_file_size = (1024l*1024l*1024l*8l) );
 
+         /**
+          * @brief Rebuild object graph from a snapshot and open database
+          *
+          * The shared memory file is wiped and every index is loaded from snapshot_file. Blocks in the block log
+          * after the snapshot block are then replayed. When this method exits successfully, the database will be open.
+          */
+         void open_from_snapshot( const fc::path& data_dir, const fc::path& shared_mem_dir, const fc::path& snapshot_file, uint64_t shared_file_size = (1024l*1024l*1024l*8l) );
+
+         /**
+          * Write a snapshot of the state as of the last irreversible block (the head block while replaying).
+          * The file is written under a temporary name and renamed once complete.
+          */
+         void write_snapshot( const fc::path& snapshot_file );
+
+         /** Newest snapshot written by set_snapshot_interval in dir, or an empty path if there is none */
+         static fc::path latest_snapshot( const fc::path& dir );
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -109,6 +143,19 @@ namespace sigmaengine { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+
+         /**
+          *  Header only lookups. Irreversible blocks are answered from the block log without unpacking
+          *  their transactions.
+          */
+         optional< signed_block_header > fetch_block_header_by_number( uint32_t num )const;
+         optional< fc::time_point_sec >  fetch_block_time_by_id( const block_id_type& id )const;
+
+         /**
+          *  @return the packed bytes of a block. Irreversible blocks are copied straight out of the
+          *  block log without being unpacked; only the header is decoded to check the id.
+          */
+         optional< vector< char > > fetch_serialized_block_by_id( const block_id_type& id )const;
          const signed_transaction   get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -134,6 +181,20 @@ namespace sigmaengine { namespace chain {
          const bobserver_schedule_object&       get_bobserver_schedule_object()const;
          const hardfork_property_object&        get_hardfork_property_object()const;
 
+         /**
+          *  The block_stats_object of the newest retained block at or before block_num, or nullptr
+          *  if block_num is older than the retained history.
+          */
+         const block_stats_object*              find_block_stats( uint32_t block_num )const;
+
+         /**
+          *  Operation history recorded by the history plugins. Only opened when a plugin called
+          *  enable_history_store() before the database was opened.
+          */
+         history_store&                         get_history_store();
+         const history_store&                   get_history_store()const;
+         void                                   enable_history_store();
+
          void max_bandwidth_per_share()const;
 
          /**
@@ -150,7 +211,21 @@ namespace sigmaengine { namespace chain {
          void push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          void _maybe_warn_multiple_production( uint32_t height )const;
          bool _push_block( const signed_block& b );
-         void _push_transaction( const signed_transaction& trx );
+         void _push_transaction( const precomputed_transaction& trx );
+
+         /**
+          * What changed in the chain state since the pending transactions were last applied, when the
+          * only changes are blocks pushed on top of that state. Unset after a block was popped or when
+          * the undo history no longer reaches back far enough.
+          */
+         optional< pending_transaction_changes > get_pending_transaction_changes()const;
+
+         /**
+          * Apply a pending transaction again after a new head block. With changes set, validate() and the
+          * authority and TaPoS checks are skipped when none of the changes can affect their outcome;
+          * the dupe and expiration checks and the evaluation itself always run.
+          */
+         void _repush_pending_transaction( const precomputed_transaction& trx, const optional< pending_transaction_changes >& changes );
 
          signed_block generate_block(
             const fc::time_point_sec when,
@@ -308,6 +383,12 @@ namespace sigmaengine { namespace chain {
          void set_custom_operation_interpreter( const std::string& id, std::shared_ptr< custom_operation_interpreter > registry );
          std::shared_ptr< custom_operation_interpreter > get_custom_evaluator( const std::string& id );
 
+         /**
+          * The notification of the operation currently being evaluated, so a custom operation interpreter
+          * can reuse the inner operations observers already decoded from it. nullptr outside apply_operation.
+          */
+         const operation_notification* current_operation_notification()const { return _current_op_note; }
+
          /// Reset the object graph in-memory
          void initialize_indexes();
          void init_schema();
@@ -315,7 +396,7 @@ namespace sigmaengine { namespace chain {
 
          /** when popping a block, the transactions that were removed get cached here so they
           * can be reapplied at the proper time */
-         std::deque< signed_transaction >       _popped_tx;
+         std::deque< precomputed_transaction >  _popped_tx;
 
          bool has_hardfork( uint32_t hardfork )const;
          
@@ -337,6 +418,74 @@ namespace sigmaengine { namespace chain {
          const std::string& get_json_schema() const;
 
          void set_flush_interval( uint32_t flush_blocks );
+
+         /**
+          * Number of worker threads used by reindex() to read and unpack blocks ahead of the
+          * applier, and the maximum number of blocks allowed in flight. Zero threads replays
+          * serially on the calling thread.
+          */
+         void set_replay_threads( uint32_t threads, uint32_t queue_size = 1024 );
+
+         /**
+          * Number of worker threads push_block uses to recover transaction signer keys before it
+          * takes the write lock. Zero recovers them inline during the authority check.
+          */
+         void set_signature_recovery_threads( uint32_t threads );
+
+         /**
+          * Number of worker threads that run the checks of blocks submitted through prevalidate_block
+          * ahead of push_block, and the most blocks they hold. Zero threads disables prevalidation.
+          */
+         void set_block_prevalidation_threads( uint32_t threads, uint32_t max_blocks = 2048 );
+
+         /**
+          * Queue a block that is about to be pushed, such as a sync block that arrived ahead of the
+          * blocks before it, for the checks that do not depend on chain state. Safe to call from any thread.
+          */
+         void prevalidate_block( const block_id_type& id, const signed_block& block, bool recover_transaction_keys );
+
+         /**
+          * When set, generate_block applies the pending transactions once, inside the undo session
+          * that becomes the new head block's, instead of selecting them in a throwaway session and
+          * applying the finished block again through push_block. pre_apply_block is then emitted with
+          * the finished block after its transactions were applied, right before it becomes the head.
+          * on_applied_transaction is still emitted for each included transaction, as it is applied.
+          */
+         void set_single_pass_block_production( bool single_pass );
+
+         /**
+          * Number of recently applied transactions kept packed in process memory for get_recent_transaction.
+          * Zero disables the cache.
+          */
+         void set_recent_transaction_cache_size( uint32_t size );
+
+         /**
+          * Write a snapshot to dir each time the last irreversible block passes a multiple of interval,
+          * keeping the newest keep snapshots. Zero disables snapshots. The state is captured in memory while
+          * the block is applied and the file is written on a separate thread; a snapshot falling due while the
+          * previous one is still being written is skipped.
+          */
+         void set_snapshot_interval( uint32_t interval, const fc::path& dir, uint32_t keep = 2 );
+
+         /**
+          * Have show_free_memory log the page faults and dTLB misses per block of the thread applying
+          * blocks, averaged over every interval blocks. Zero disables the report.
+          */
+         void set_page_fault_report_interval( uint32_t interval );
+
+         /**
+          * Grow the shared memory file by increment bytes, between two blocks, whenever its free memory
+          * falls below min_free, instead of waiting for a restart with a larger shared-file-size.
+          * Zero min_free disables growing.
+          */
+         void set_shared_memory_growth( uint64_t min_free, uint64_t increment );
+
+         /**
+          * Keep the account authority objects found while checking the signatures of a block for the rest
+          * of the block, so an account signing many of its transactions or named in many multisig
+          * authorities is looked up once per block instead of once per check.
+          */
+         void set_block_authority_cache( bool enabled );
          void show_free_memory( bool force );
          // bool skip_transaction_delta_check = true;
 
@@ -364,22 +513,44 @@ namespace sigmaengine { namespace chain {
       private:
          optional< chainbase::database::session > _pending_tx_session;
 
+         /// Revision of the head state _pending_tx_session was started on, -1 once a block was popped
+         int64_t                                  _pending_tx_base_revision = -1;
+
+         bool authorities_changed( const signed_transaction& trx, const flat_set< account_name_type >& changed )const;
+
          void apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
+         void flush_and_snapshot( uint32_t block_num );
+         std::shared_ptr< captured_snapshot > capture_snapshot()const;
+         void finish_snapshot_write();
+
+         /// Called with the write lock held between blocks, when no object references are held
+         void maybe_grow_shared_memory();
+
+         void replay_blocks( const fc::path& data_dir, uint32_t first_block, uint32_t skip );
+         uint32_t snapshot_block_num()const;
          void apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          void _apply_block( const signed_block& next_block );
          void _apply_transaction( const signed_transaction& trx );
+         void _apply_transaction( const precomputed_transaction& trx );
+
+         /// The authority object of an account signing a transaction, through the block authority cache while a block is applied
+         const account_authority_object& get_signing_authority( const string& name );
          void apply_operation( const operation& op );
 
 
          ///Steps involved in applying a new block
          ///@{
 
-         const bobserver_object& validate_block_header( uint32_t skip, const signed_block& next_block )const;
-         void create_block_summary(const signed_block& next_block);
+         const bobserver_object& validate_block_header( uint32_t skip, const signed_block& next_block, const prevalidated_block* prevalidated = nullptr )const;
+         void validate_block_size( const signed_block& next_block )const;
+         void start_block( const signed_block& next_block );
+         void finish_block( const signed_block& next_block, const block_id_type& next_block_id, const bobserver_object& signing_bobserver );
+         void create_block_summary( const signed_block& next_block, const block_id_type& next_block_id );
+         void update_block_stats( const signed_block& next_block );
 
          void clear_null_account_balance();
 
-         void update_global_dynamic_data( const signed_block& b );
+         void update_global_dynamic_data( const signed_block& b, const block_id_type& b_id );
          void update_signing_bobserver(const bobserver_object& signing_bobserver, const signed_block& new_block);
          void update_last_irreversible_block();
          void clear_expired_transactions();
@@ -393,12 +564,14 @@ namespace sigmaengine { namespace chain {
 
          std::unique_ptr< database_impl > _my;
 
-         vector< signed_transaction >  _pending_tx;
+         vector< precomputed_transaction >  _pending_tx;
          fork_database                 _fork_db;
          fc::time_point_sec            _hardfork_times[ SIGMAENGINE_NUM_HARDFORKS + 1 ];
          protocol::hardfork_version    _hardfork_versions[ SIGMAENGINE_NUM_HARDFORKS + 1 ];
 
          block_log                     _block_log;
+         history_store                 _history;
+         bool                          _history_enabled = false;
 
          // this function needs access to _plugin_index_signal
          template< typename MultiIndexType >
@@ -411,6 +584,9 @@ namespace sigmaengine { namespace chain {
          uint16_t                      _current_trx_in_block = 0;
          uint16_t                      _current_op_in_trx    = 0;
          uint16_t                      _current_virtual_op   = 0;
+         const operation_notification* _current_op_note = nullptr;
+         uint32_t                      _current_block_op_count = 0;
+         uint32_t                      _current_block_virtual_op_count = 0;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
@@ -419,8 +595,52 @@ namespace sigmaengine { namespace chain {
          uint32_t                      _flush_blocks = 0;
          uint32_t                      _next_flush_block = 0;
 
+         uint32_t                      _snapshot_interval = 0;
+         uint32_t                      _snapshots_to_keep = 2;
+         uint32_t                      _next_snapshot_block = 0;
+         fc::path                      _snapshot_dir;
+
+         /// Writes the last captured snapshot to _snapshot_dir and prunes old ones, off the write lock
+         std::future< void >           _snapshot_write;
+
+         bool                          _single_pass_block_production = true;
+
+         recent_transaction_cache      _recent_transactions;
+
+         uint32_t                      _replay_threads = 0;
+         uint32_t                      _replay_queue_size = 1024;
+
+         /// Set by reindex() while applying a block whose ids were precomputed by the replay pipeline
+         const replayed_block*         _replay_block = nullptr;
+
+         std::unique_ptr< signature_recovery_pool >   _signature_recovery_pool;
+
+         std::unique_ptr< block_prevalidator >        _block_prevalidator;
+
+         /// Checks run ahead of time for the block push_block is pushing
+         prevalidated_block_ptr                       _pushed_block;
+
+         /// Set by _apply_block while applying the block whose signer keys were recovered ahead of time
+         const vector< recovered_signature_keys >*    _block_signature_keys = nullptr;
+
+         /**
+          * Only used by _apply_block. Account authority objects are never removed and stay in place when
+          * modified, so a cached object shows authority changes made earlier in the block, and a failed
+          * transaction fails the whole block, which clears the cache before anything created in it is undone.
+          */
+         bool                                                                    _block_authority_cache_enabled = false;
+         bool                                                                    _block_authority_cache_active = false;
+         std::unordered_map< string, const account_authority_object* >          _block_authority_cache;
+
          uint32_t                      _last_free_gb_printed = 0;
 
+         uint64_t                      _shared_memory_min_free = 0;
+         uint64_t                      _shared_memory_increment = 0;
+
+         uint32_t                      _page_fault_report_interval = 0;
+         uint32_t                      _page_fault_report_block = 0;
+         chainbase::mapping_stats      _page_fault_report_stats;
+
          flat_map< std::string, std::shared_ptr< custom_operation_interpreter > >   _custom_operation_interpreters;
          std::string                   _json_schema;
 
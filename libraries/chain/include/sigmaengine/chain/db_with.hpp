@@ -45,7 +45,7 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<signed_transaction>&& pending_transactions )
+   pending_transactions_restorer( database& db, std::vector<precomputed_transaction>&& pending_transactions )
       : _db(db), _pending_transactions( std::move(pending_transactions) )
    {
       _db.clear_pending();
@@ -53,6 +53,11 @@ struct pending_transactions_restorer
 
    ~pending_transactions_restorer()
    {
+      // Taken before anything is pushed again, since that starts a new pending session
+      auto changes = _db.get_pending_transaction_changes();
+      if( _db._popped_tx.size() )
+         changes.reset();
+
       for( const auto& tx : _db._popped_tx )
       {
          try {
@@ -65,25 +70,27 @@ struct pending_transactions_restorer
          }
       }
       _db._popped_tx.clear();
-      for( const signed_transaction& tx : _pending_transactions )
+      for( const precomputed_transaction& tx : _pending_transactions )
       {
          try
          {
             if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
+               // Only checks whose inputs changed since the transaction was last applied are repeated
+               _db._repush_pending_transaction( tx, changes );
             }
          }
          catch( const transaction_exception& e )
          {
+            // Later transactions may have been checked against state this one created
+            changes.reset();
             dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
                ("b", _db.head_block_id())("n", _db.head_block_num())("t", _db.head_block_time()) );
             dlog( "The invalid transaction caused exception ${e}", ("e", e.to_detail_string()) );
-            dlog( "${t}", ("t", tx) );
+            dlog( "${t}", ("t", tx.get_transaction()) );
          }
          catch( const fc::exception& e )
          {
+            changes.reset();
 
             /*
             dlog( "Pending transaction became invalid after switching to block ${b} ${n} ${t}",
@@ -96,7 +103,7 @@ struct pending_transactions_restorer
    }
 
    database& _db;
-   std::vector< signed_transaction > _pending_transactions;
+   std::vector< precomputed_transaction > _pending_transactions;
 };
 
 /**
@@ -126,7 +133,7 @@ void with_skip_flags(
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<signed_transaction>&& pending_transactions,
+   std::vector<precomputed_transaction>&& pending_transactions,
    Lambda callback )
 {
     pending_transactions_restorer restorer( db, std::move(pending_transactions) );
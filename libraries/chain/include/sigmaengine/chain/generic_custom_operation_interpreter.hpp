@@ -7,6 +7,7 @@
 #include <sigmaengine/chain/evaluator.hpp>
 #include <sigmaengine/chain/evaluator_registry.hpp>
 #include <sigmaengine/chain/custom_operation_interpreter.hpp>
+#include <sigmaengine/chain/operation_notification.hpp>
 
 #include <graphene/schema/schema.hpp>
 
@@ -67,10 +68,7 @@ class generic_custom_operation_interpreter
       {
          try
          {
-            std::vector< CustomOperationType > custom_operations;
-            
-            get_inner_operation( outer_o, custom_operations );
-            apply_operations( custom_operations, operation( outer_o ) );
+            apply_custom_json( outer_o );
          } FC_CAPTURE_AND_RETHROW( (outer_o) )
       }
 
@@ -78,10 +76,7 @@ class generic_custom_operation_interpreter
       {
          try
          {
-            std::vector< CustomOperationType > custom_operations;
-            
-            get_inner_operation( outer_o, custom_operations );
-            apply_operations( custom_operations, operation( outer_o ) );
+            apply_custom_json( outer_o );
          } FC_CAPTURE_AND_RETHROW( (outer_o) )
       }
 
@@ -103,33 +98,21 @@ class generic_custom_operation_interpreter
       }
 
    private:
-      void get_inner_operation( const protocol::custom_json_operation& outer_op, std::vector< CustomOperationType >& custom_operations )
-      {
-         fc::variant v = fc::json::from_string( outer_op.json );
-
-         if( v.is_array() && v.size() > 0 && v.get_array()[0].is_array() )
-         {
-            from_variant( v, custom_operations );
-         }
-         else
-         {
-            custom_operations.emplace_back();
-            from_variant( v, custom_operations[0] );
-         }
-      }
-
-      void get_inner_operation( const protocol::custom_json_dapp_operation& outer_op, std::vector< CustomOperationType >& custom_operations )
+      template< typename CustomJsonOperation >
+      void apply_custom_json( const CustomJsonOperation& outer_o )
       {
-         fc::variant v = fc::json::from_string( outer_op.json );
-
-         if( v.is_array() && v.size() > 0 && v.get_array()[0].is_array() )
+         // Reuse the inner operations already decoded for observers of the operation being applied
+         const operation_notification* note = this->_db.current_operation_notification();
+         if( note != nullptr && note->op.which() == operation::tag< CustomJsonOperation >::value
+            && &note->op.get< CustomJsonOperation >() == &outer_o )
          {
-            from_variant( v, custom_operations );
+            apply_operations( note->template inner_operations< CustomOperationType >(), note->op );
          }
          else
          {
-            custom_operations.emplace_back();
-            from_variant( v, custom_operations[0] );
+            operation outer_op( outer_o );
+            operation_notification outer_note( outer_op );
+            apply_operations( outer_note.template inner_operations< CustomOperationType >(), outer_op );
          }
       }
 
@@ -0,0 +1,171 @@
+#pragma once
+#include <fc/filesystem.hpp>
+
+#include <sigmaengine/protocol/operations.hpp>
+
+namespace sigmaengine { namespace chain {
+
+   using namespace sigmaengine::protocol;
+
+   struct operation_notification;
+
+   namespace detail { class history_store_impl; }
+
+   /**
+    * One operation as kept by the history store, with the location it was applied at.
+    */
+   struct history_operation
+   {
+      transaction_id_type  trx_id;
+      uint32_t             block = 0;
+      uint32_t             trx_in_block = 0;
+      uint16_t             op_in_trx = 0;
+      uint64_t             virtual_op = 0;
+      time_point_sec       timestamp;
+      operation            op;
+   };
+
+   /**
+    * Size of the operations on disk and how they are shared between owners. The owner of a key is the
+    * part of the key before the first '/', e.g. "account" for the account_history plugin and "dapp" for
+    * the dapp_history plugin.
+    */
+   struct history_store_stats
+   {
+      uint32_t                   head_block = 0;
+      uint64_t                   operations = 0;            ///< operations on disk
+      uint64_t                   operation_bytes = 0;       ///< packed size of the operations on disk
+      uint64_t                   filings = 0;               ///< (key, operation) pairs on disk
+      map< string, uint64_t >    owner_operations;          ///< operations filed by each owner
+      map< string, uint64_t >    owner_bytes;               ///< packed size of the operations filed by each owner
+      uint64_t                   shared_operations = 0;     ///< operations filed by more than one owner
+      uint64_t                   shared_bytes_saved = 0;    ///< packed bytes a copy per owner would have added
+   };
+
+   /* The history store is an append only, block indexed log of the operations the history plugins
+    * record, kept on disk next to the block log instead of in shared memory. Operations are numbered
+    * from 0 in the order they were applied. Every operation is filed under one or more keys, and the
+    * operations filed under a key form a sequence numbered from 0, oldest first. An operation is one
+    * shared record no matter how many keys or plugins file it, and it is packed once, when its block
+    * is written.
+    *
+    * The database opens a block for recording at the start of every applied block and closes it once
+    * the block's virtual operations are in. Finished blocks stay in memory while they are reversible
+    * and are replaced when a fork applies another block at the same height. Only blocks that became
+    * irreversible are written, so nothing on disk ever needs to be undone. Reads see the irreversible
+    * blocks on disk followed by the reversible blocks in memory.
+    *
+    * The directory holds these files:
+    *  - operations:          the packed operations
+    *  - operations.index:    the end offset in operations of each operation, 8 bytes per operation
+    *  - blocks.index:        the number of operations up to and including each block, 8 bytes per block
+    *  - keys:                (key, operation number) pairs in the order they were filed
+    *  - transactions:        (transaction id, block, transaction in block) for each recorded transaction
+    *  - keys.index:          hash table from each key to the pages of its sequence in keys.pages
+    *  - keys.pages:          the operation numbers of each sequence
+    *  - transactions.index:  hash table from transaction id to block and transaction in block
+    *
+    * blocks.index is appended last and decides how much of the other files is committed. Anything past
+    * it is cut off when the store is opened. The index files are mapped and updated after each block is
+    * committed, and record how much of keys and transactions they cover, so open() only indexes what was
+    * appended after their last update. Missing index files are rebuilt from keys and transactions. The
+    * keys and transactions of the reversible blocks are indexed in memory.
+    *
+    * Like the rest of the chain state, the store is written under the database write lock and read
+    * under the read lock.
+    */
+   class history_store
+   {
+      public:
+         history_store();
+         ~history_store();
+
+         /**
+          * Open the store in dir, cutting off anything a crash left past the last committed block. A read
+          * only store never writes to dir: it reads up to the last committed block, keeps what the indexes
+          * are missing in memory and records no blocks. Use it to inspect the store of a stopped node.
+          */
+         void open( const fc::path& dir, bool read_only = false );
+         void close();
+         bool is_open()const;
+
+         /// Last block written to disk
+         uint32_t head_block_num()const;
+
+         /**
+          * Start recording the operations of block_num, dropping any reversible blocks at or above it.
+          * Blocks that are already on disk are not recorded again.
+          */
+         void start_block( uint32_t block_num );
+
+         /**
+          * File the operation of note under key in the block being recorded. An operation filed under
+          * several keys is stored once, and filing it under the same key again does nothing. Does
+          * nothing outside of a block either, so operations of pending transactions are never recorded.
+          */
+         void add_operation( const operation_notification& note, fc::time_point_sec timestamp, const string& key );
+
+         /// Number of operations recorded so far in the current block
+         uint32_t pending_operation_count()const;
+
+         /// Forget the operations recorded in the current block after the first count, e.g. those of a transaction that failed
+         void discard_pending_operations( uint32_t count );
+
+         /// Finish the block being recorded. It stays in memory until commit() is called with a block at or above it
+         void finish_block();
+
+         /// Drop the reversible blocks at or above block_num
+         void pop_blocks( uint32_t block_num );
+
+         /// Write the reversible blocks up to and including last_irreversible_block to disk
+         void commit( uint32_t last_irreversible_block );
+
+         /// Total number of operations, including those of reversible blocks
+         uint64_t operation_count()const;
+         history_operation get_operation( uint64_t operation_num )const;
+         vector< history_operation > get_block_operations( uint32_t block_num )const;
+
+         /// Number of operations filed under key
+         uint32_t sequence_size( const string& key )const;
+
+         /**
+          * The operations filed under key with sequence numbers in [from - limit, from], newest first. A from
+          * past the end of the sequence starts at the newest operation.
+          */
+         vector< std::pair< uint32_t, history_operation > > get_sequence( const string& key, uint64_t from, uint32_t limit )const;
+
+         /// Block number and position in the block of a transaction with recorded operations
+         optional< std::pair< uint32_t, uint32_t > > find_transaction( const transaction_id_type& id )const;
+
+         /// Walks every filing on disk, meant for offline inspection rather than a running node
+         history_store_stats get_stats()const;
+
+      private:
+         std::unique_ptr< detail::history_store_impl > my;
+   };
+
+   inline string history_key_owner( const string& key )
+   {
+      return key.substr( 0, key.find( '/' ) );
+   }
+
+   /// Keys the account_history plugin files an operation under for each account it impacts
+   inline string account_history_key( const account_name_type& account )
+   {
+      return "account/" + string( account );
+   }
+
+   inline string account_history_key( const account_name_type& account, uint32_t op_tag )
+   {
+      return account_history_key( account ) + "/" + std::to_string( op_tag );
+   }
+
+   inline string account_history_key( const account_name_type& account, uint32_t op_tag, asset_symbol_type symbol )
+   {
+      return account_history_key( account, op_tag ) + "/" + std::to_string( symbol );
+   }
+
+} }
+
+FC_REFLECT( sigmaengine::chain::history_operation, (trx_id)(block)(trx_in_block)(op_in_trx)(virtual_op)(timestamp)(op) )
+FC_REFLECT( sigmaengine::chain::history_store_stats, (head_block)(operations)(operation_bytes)(filings)(owner_operations)(owner_bytes)(shared_operations)(shared_bytes_saved) )
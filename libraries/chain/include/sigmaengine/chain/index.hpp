@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sigmaengine/chain/database.hpp>
+#include <sigmaengine/chain/snapshot.hpp>
 
 namespace sigmaengine { namespace chain {
 
@@ -8,6 +9,7 @@ template< typename MultiIndexType >
 void _add_index_impl( database& db )
 {
    db.add_index< MultiIndexType >();
+   db.add_index_extension< MultiIndexType >( std::make_shared< snapshot_index< MultiIndexType > >( db ) );
 }
 
 template< typename MultiIndexType >
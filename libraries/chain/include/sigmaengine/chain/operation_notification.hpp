@@ -4,6 +4,11 @@
 
 #include <sigmaengine/chain/sigmaengine_object_types.hpp>
 
+#include <fc/io/json.hpp>
+
+#include <memory>
+#include <typeindex>
+
 namespace sigmaengine { namespace chain {
 
 struct operation_notification
@@ -16,6 +21,91 @@ struct operation_notification
    uint16_t            op_in_trx = 0;
    uint64_t            virtual_op = 0;
    const operation&    op;
+
+   /**
+    * The json payload of a custom_json_operation or custom_json_dapp_operation. It is parsed on
+    * first use and shared by the custom operation interpreter and every observer of this notification.
+    */
+   const fc::variant& custom_json()const
+   {
+      if( !_custom_json )
+      {
+         if( op.which() == operation::tag< custom_json_operation >::value )
+            _custom_json = std::make_shared< fc::variant >( fc::json::from_string( op.get< custom_json_operation >().json ) );
+         else if( op.which() == operation::tag< custom_json_dapp_operation >::value )
+            _custom_json = std::make_shared< fc::variant >( fc::json::from_string( op.get< custom_json_dapp_operation >().json ) );
+         else
+            FC_ASSERT( false, "Operation does not have a custom json payload" );
+      }
+
+      return *_custom_json;
+   }
+
+   /**
+    * The custom json payload decoded as inner operations of CustomOperationType. The payload is either
+    * a single inner operation or an array of them. Each type is decoded at most once; a payload that
+    * does not decode as CustomOperationType throws the same exception every time it is asked for.
+    */
+   template< typename CustomOperationType >
+   const vector< CustomOperationType >& inner_operations()const
+   {
+      const auto& decoded = decode_inner_operations< CustomOperationType >();
+      if( decoded.error )
+         decoded.error->dynamic_rethrow_exception();
+      return *std::static_pointer_cast< const vector< CustomOperationType > >( decoded.operations );
+   }
+
+   /** Like inner_operations(), but returns nullptr instead of throwing */
+   template< typename CustomOperationType >
+   const vector< CustomOperationType >* find_inner_operations()const
+   {
+      const auto& decoded = decode_inner_operations< CustomOperationType >();
+      if( decoded.error )
+         return nullptr;
+      return std::static_pointer_cast< const vector< CustomOperationType > >( decoded.operations ).get();
+   }
+
+   private:
+      struct decoded_operations
+      {
+         std::shared_ptr< const void > operations;
+         fc::exception_ptr             error;
+      };
+
+      template< typename CustomOperationType >
+      const decoded_operations& decode_inner_operations()const
+      {
+         auto& decoded = _inner_operations[ std::type_index( typeid( CustomOperationType ) ) ];
+         if( decoded.operations || decoded.error )
+            return decoded;
+
+         try
+         {
+            auto operations = std::make_shared< vector< CustomOperationType > >();
+            const fc::variant& v = custom_json();
+
+            if( v.is_array() && v.size() > 0 && v.get_array()[0].is_array() )
+            {
+               from_variant( v, *operations );
+            }
+            else
+            {
+               operations->emplace_back();
+               from_variant( v, operations->back() );
+            }
+
+            decoded.operations = operations;
+         }
+         catch( const fc::exception& e )
+         {
+            decoded.error = e.dynamic_copy_exception();
+         }
+
+         return decoded;
+      }
+
+      mutable std::shared_ptr< const fc::variant >                     _custom_json;
+      mutable flat_map< std::type_index, decoded_operations >          _inner_operations;
 };
 
 } }
@@ -0,0 +1,65 @@
+#pragma once
+#include <sigmaengine/protocol/transaction.hpp>
+
+#include <memory>
+
+namespace sigmaengine { namespace chain {
+
+   using namespace sigmaengine::protocol;
+
+   /**
+    * A signed transaction together with the values that are otherwise recomputed by every stage
+    * that touches it: the packed bytes, the transaction id, the signature digest and the recovered
+    * signer keys. Each value is computed at most once, on first use.
+    *
+    * The transaction is packed once, and the id and signature digest are both hashed from the
+    * unsigned prefix of those packed bytes instead of packing the transaction again. Copies share
+    * the owned transaction but not the cache, so a precomputed_transaction should be passed by
+    * reference once its values are in use.
+    */
+   class precomputed_transaction
+   {
+      public:
+         /** Copy trx, for transactions that outlive the caller such as pending and popped transactions */
+         explicit precomputed_transaction( const signed_transaction& trx );
+
+         /**
+          * Refer to trx without copying it; trx must outlive the result. A known id, such as one
+          * computed by the replay pipeline, is used instead of hashing the transaction.
+          */
+         static precomputed_transaction borrow( const signed_transaction& trx, const transaction_id_type* id = nullptr );
+
+         /**
+          * Refer to trx without copying it, keeping owner alive for as long as any copy of the result
+          * exists. Used for the transactions of popped blocks, which stay in the fork database's blocks.
+          */
+         static precomputed_transaction share( std::shared_ptr< const void > owner, const signed_transaction& trx );
+
+         const signed_transaction&           get_transaction()const { return *_trx; }
+         const vector< char >&               packed()const;
+         const transaction_id_type&          id()const;
+         const digest_type&                  sig_digest( const chain_id_type& chain_id )const;
+
+         /** Same result and exceptions as signed_transaction::get_signature_keys() */
+         const flat_set< public_key_type >&  signature_keys( const chain_id_type& chain_id )const;
+
+         /** Process wide count of packs and hashes computed, and of cached values handed out instead */
+         static uint64_t computed_count();
+         static uint64_t reused_count();
+
+      private:
+         precomputed_transaction() {}
+
+         size_t unsigned_size()const;
+
+         std::shared_ptr< const signed_transaction >   _owned;
+         const signed_transaction*                     _trx = nullptr;
+
+         mutable optional< vector< char > >              _packed;
+         mutable optional< transaction_id_type >         _id;
+         mutable optional< chain_id_type >               _sig_chain_id;
+         mutable digest_type                             _sig_digest;
+         mutable optional< flat_set< public_key_type > > _signature_keys;
+   };
+
+} }
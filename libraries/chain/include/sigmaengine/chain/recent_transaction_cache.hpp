@@ -0,0 +1,90 @@
+#pragma once
+#include <sigmaengine/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+namespace sigmaengine { namespace chain {
+
+   namespace bmi = boost::multi_index;
+
+   using sigmaengine::protocol::transaction_id_type;
+
+   /**
+    * The packed form of recently applied transactions, kept in process memory so they can be served to
+    * peers. It holds at most max_size transactions, dropping the oldest first, and drops transactions
+    * once they expire. The cache is not part of the chain state and is not undone when blocks are popped.
+    *
+    * Written under the database write lock and read under the read lock, so lookups do not reorder it.
+    */
+   class recent_transaction_cache
+   {
+      public:
+         void set_max_size( size_t max_size )
+         {
+            _max_size = max_size;
+            trim();
+         }
+
+         void add( const transaction_id_type& id, fc::time_point_sec expiration, const vector< char >& packed_trx )
+         {
+            if( _max_size == 0 )
+               return;
+
+            _entries.push_back( entry{ id, expiration, packed_trx } );
+            trim();
+         }
+
+         const vector< char >* find( const transaction_id_type& id )const
+         {
+            const auto& by_id = _entries.get< by_trx_id >();
+            auto itr = by_id.find( id );
+            return itr != by_id.end() ? &itr->packed_trx : nullptr;
+         }
+
+         void remove_expired( fc::time_point_sec now )
+         {
+            auto& by_exp = _entries.get< by_expiration >();
+            while( !by_exp.empty() && now > by_exp.begin()->expiration )
+               by_exp.erase( by_exp.begin() );
+         }
+
+         void clear()
+         {
+            _entries.clear();
+         }
+
+      private:
+         void trim()
+         {
+            while( _entries.size() > _max_size )
+               _entries.pop_front();
+         }
+
+         struct entry
+         {
+            transaction_id_type  trx_id;
+            fc::time_point_sec   expiration;
+            vector< char >       packed_trx;
+         };
+
+         struct by_trx_id;
+         struct by_expiration;
+
+         typedef boost::multi_index_container<
+            entry,
+            bmi::indexed_by<
+               bmi::sequenced<>,
+               bmi::hashed_unique< bmi::tag< by_trx_id >, bmi::member< entry, transaction_id_type, &entry::trx_id >, std::hash< transaction_id_type > >,
+               bmi::ordered_non_unique< bmi::tag< by_expiration >, bmi::member< entry, fc::time_point_sec, &entry::expiration > >
+            >
+         > entry_container;
+
+         entry_container _entries;
+         size_t          _max_size = 0;
+   };
+
+} } // sigmaengine::chain
@@ -0,0 +1,63 @@
+#pragma once
+#include <fc/filesystem.hpp>
+#include <sigmaengine/protocol/block.hpp>
+
+#include <memory>
+
+namespace sigmaengine { namespace chain {
+
+   using namespace sigmaengine::protocol;
+
+   namespace detail { class replay_pipeline_impl; }
+
+   /**
+    * A block read back from the block log by the replay pipeline, together with
+    * the values the worker threads computed for it ahead of the applier.
+    */
+   struct replayed_block
+   {
+      uint32_t                      block_num = 0;
+      uint64_t                      byte_size = 0;
+      signed_block                  block;
+      block_id_type                 block_id;
+      vector< transaction_id_type > trx_ids;
+   };
+
+   typedef std::shared_ptr< const replayed_block > replayed_block_ptr;
+
+   /* The replay pipeline feeds database::reindex. One reader thread walks the block log using
+    * the positions in block_log.index and hands the raw packed bytes to a pool of worker
+    * threads. The workers unpack the block, compute the block id, the transaction ids and
+    * the transaction merkle root (which is checked against the header), and park the result
+    * in a reorder buffer. The applier thread pulls blocks strictly in order with next().
+    *
+    * The number of blocks in flight (read but not yet consumed) is bounded by queue_size so
+    * memory use stays flat no matter how far ahead the readers get.
+    *
+    *  reader --> [ raw queue ] --> workers --> [ reorder buffer ] --> next() --> apply_block
+    */
+   class replay_pipeline
+   {
+      public:
+         replay_pipeline( const fc::path& block_file, uint32_t first_block, uint32_t last_block,
+                          uint32_t worker_threads, uint32_t queue_size );
+         ~replay_pipeline();
+
+         /**
+          * Block until the next block in sequence is available and return it. Any exception
+          * raised by the reader or a worker is rethrown here. Returns nullptr once last_block
+          * has been returned.
+          */
+         replayed_block_ptr next();
+
+         /** Number of blocks read from disk but not yet returned by next() */
+         uint32_t in_flight()const;
+
+         /** Total packed bytes returned by next() so far */
+         uint64_t bytes_consumed()const;
+
+      private:
+         std::unique_ptr< detail::replay_pipeline_impl > my;
+   };
+
+} }
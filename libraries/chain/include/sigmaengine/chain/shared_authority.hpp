@@ -4,6 +4,7 @@
 
 namespace sigmaengine { namespace chain {
    using sigmaengine::protocol::authority;
+   using sigmaengine::protocol::authority_view;
    using sigmaengine::protocol::public_key_type;
    using sigmaengine::protocol::account_name_type;
    using sigmaengine::protocol::weight_type;
@@ -56,6 +57,10 @@ namespace sigmaengine { namespace chain {
 
       operator authority()const;
 
+      /// Views the authority in place, for checking signatures without copying it out of shared memory
+      operator authority_view()const & { return authority_view( weight_threshold, account_auths, key_auths ); }
+      operator authority_view()const && = delete;
+
       shared_authority& operator=( const authority& a );
 
       void add_authority( const public_key_type& k, weight_type w );
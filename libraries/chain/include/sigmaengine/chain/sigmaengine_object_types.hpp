@@ -72,8 +72,6 @@ class transaction_object;
 class block_summary_object;
 class bobserver_schedule_object;
 class bobserver_vote_object;
-class operation_object;
-class account_history_object;
 class hardfork_property_object;
 class owner_authority_history_object;
 class account_recovery_request_object;
@@ -97,8 +95,6 @@ typedef oid< transaction_object                     > transaction_object_id_type
 typedef oid< block_summary_object                   > block_summary_id_type;
 typedef oid< bobserver_schedule_object              > bobserver_schedule_id_type;
 typedef oid< bobserver_vote_object                  > bobserver_vote_id_type;
-typedef oid< operation_object                       > operation_id_type;
-typedef oid< account_history_object                 > account_history_id_type;
 typedef oid< hardfork_property_object               > hardfork_property_id_type;
 typedef oid< owner_authority_history_object         > owner_authority_history_id_type;
 typedef oid< account_recovery_request_object        > account_recovery_request_id_type;
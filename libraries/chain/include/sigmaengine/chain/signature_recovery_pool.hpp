@@ -0,0 +1,47 @@
+#pragma once
+#include <sigmaengine/protocol/transaction.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <memory>
+
+namespace sigmaengine { namespace chain {
+
+   using namespace sigmaengine::protocol;
+
+   namespace detail { class signature_recovery_pool_impl; }
+
+   /**
+    * The public keys recovered from the signatures of one transaction, or the exception that
+    * get_signature_keys() threw for it.
+    */
+   struct recovered_signature_keys
+   {
+      flat_set< public_key_type > keys;
+      fc::exception_ptr           error;
+   };
+
+   /* Recovers the signer keys of every transaction in a block on a fixed pool of worker threads.
+    * database::push_block runs it before taking the write lock, so that the authority check in
+    * _apply_transaction only has to compare the recovered key sets against the account authorities.
+    *
+    * The calling thread works alongside the pool and recover() returns once every transaction has
+    * been processed. Only one recover() runs at a time.
+    */
+   class signature_recovery_pool
+   {
+      public:
+         signature_recovery_pool( uint32_t worker_threads );
+         ~signature_recovery_pool();
+
+         /**
+          * Return the recovered keys of each transaction, in the order of trxs. A transaction with a
+          * bad or duplicate signature has its exception stored rather than thrown.
+          */
+         vector< recovered_signature_keys > recover( const vector< signed_transaction >& trxs, const chain_id_type& chain_id );
+
+      private:
+         std::unique_ptr< detail::signature_recovery_pool_impl > my;
+   };
+
+} }
@@ -0,0 +1,274 @@
+#pragma once
+#include <sigmaengine/chain/database.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/core/demangle.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+
+namespace sigmaengine { namespace chain {
+
+   /* A snapshot is a portable dump of every chainbase index as of one block in the block log.
+    * Objects are written with fc::raw, so unlike shared_memory.bin a snapshot can be loaded by a
+    * different build, compiler or operating system.
+    *
+    * +--------+-------------------------------------------------------------+-----+--------+
+    * | Header | Index 1: name, size, next id, object count, id + object ... | ... | Footer |
+    * +--------+-------------------------------------------------------------+-----+--------+
+    *
+    * Each index section records its own size, so an index the loading node does not have (for
+    * example one belonging to a plugin that is not enabled) is skipped. The footer repeats the
+    * magic number so a truncated file is rejected. Snapshots are written to a temporary file and
+    * renamed into place once complete.
+    */
+   struct snapshot_header
+   {
+      static const uint64_t   magic_number = 0x31504e5345474953; // "SIGESNP1"
+      static const uint32_t   current_version = 2;
+
+      uint64_t                magic = magic_number;
+      uint32_t                version = current_version;
+      chain_id_type           chain_id;
+      uint32_t                block_num = 0;
+      block_id_type           block_id;
+      fc::time_point_sec      timestamp;
+      uint32_t                index_count = 0;
+   };
+
+   /**
+    * Output stream buffer holding what abstract_snapshot_index::write wrote for one index. The bytes
+    * are kept in fixed size chunks, so a growing section is never moved or copied, and a capture needs
+    * little more memory than the serialized state. Seeking back over written bytes is supported, as
+    * write() patches the object count in once it is known.
+    */
+   class snapshot_section_buffer : public std::streambuf
+   {
+      public:
+         static const size_t chunk_size = 16 * 1024 * 1024;
+
+         uint64_t size()const { return _size; }
+         const vector< vector< char > >& chunks()const { return _chunks; }
+
+      protected:
+         std::streamsize xsputn( const char* data, std::streamsize count )override
+         {
+            std::streamsize left = count;
+            while( left > 0 )
+            {
+               size_t chunk = _pos / chunk_size;
+               size_t offset = _pos % chunk_size;
+               if( chunk == _chunks.size() )
+               {
+                  _chunks.emplace_back();
+                  _chunks.back().reserve( chunk_size );
+               }
+
+               vector< char >& c = _chunks[ chunk ];
+               size_t take = std::min< size_t >( left, chunk_size - offset );
+               if( offset + take > c.size() )
+                  c.resize( offset + take );
+               memcpy( c.data() + offset, data, take );
+
+               data += take;
+               left -= take;
+               _pos += take;
+            }
+            _size = std::max( _size, _pos );
+            return count;
+         }
+
+         int_type overflow( int_type c )override
+         {
+            if( traits_type::eq_int_type( c, traits_type::eof() ) )
+               return traits_type::not_eof( c );
+            char ch = traits_type::to_char_type( c );
+            xsputn( &ch, 1 );
+            return c;
+         }
+
+         pos_type seekoff( off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which )override
+         {
+            if( !( which & std::ios_base::out ) )
+               return pos_type( off_type( -1 ) );
+            int64_t base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::end ? int64_t( _size ) : int64_t( _pos );
+            return seekpos( pos_type( base + offset ), which );
+         }
+
+         pos_type seekpos( pos_type pos, std::ios_base::openmode which )override
+         {
+            if( !( which & std::ios_base::out ) || off_type( pos ) < 0 || uint64_t( off_type( pos ) ) > _size )
+               return pos_type( off_type( -1 ) );
+            _pos = uint64_t( off_type( pos ) );
+            return pos;
+         }
+
+      private:
+         vector< vector< char > >   _chunks;
+         uint64_t                   _size = 0;
+         uint64_t                   _pos = 0;
+   };
+
+   /**
+    * A snapshot captured in memory under the write lock, so the file can be written without holding it.
+    * Each section holds the type name of an index and what abstract_snapshot_index::write wrote for it.
+    */
+   struct captured_snapshot
+   {
+      snapshot_header                                                                     header;
+      vector< std::pair< std::string, std::unique_ptr< snapshot_section_buffer > > >    sections;
+
+      /** Write the snapshot under a temporary name and rename it to snapshot_file once complete */
+      void write( const fc::path& snapshot_file )const;
+   };
+
+   /*
+    * fc::raw falls back to operator<< and operator>> for classes that are neither reflected nor
+    * handled by an overload declared ahead of fc/io/raw.hpp. The snapshot streams live in this
+    * namespace so those operators are found by argument dependent lookup for the chainbase types
+    * that appear in objects.
+    */
+   struct snapshot_ostream
+   {
+      snapshot_ostream( std::ostream& o ) : out( o ) {}
+      void write( const char* d, size_t s ) { out.write( d, s ); }
+      void put( char c ) { out.put( c ); }
+
+      std::ostream& out;
+   };
+
+   struct snapshot_istream
+   {
+      snapshot_istream( std::istream& i ) : in( i ) {}
+      void read( char* d, size_t s ) { in.read( d, s ); }
+      void get( char& c ) { in.get( c ); }
+
+      std::istream& in;
+   };
+
+   template< typename T >
+   snapshot_ostream& operator<<( snapshot_ostream& s, const chainbase::oid< T >& id )
+   {
+      fc::raw::pack( s, id._id );
+      return s;
+   }
+
+   template< typename T >
+   snapshot_istream& operator>>( snapshot_istream& s, chainbase::oid< T >& id )
+   {
+      fc::raw::unpack( s, id._id );
+      return s;
+   }
+
+   inline snapshot_ostream& operator<<( snapshot_ostream& s, const shared_string& str )
+   {
+      fc::raw::pack( s, fc::unsigned_int( (uint32_t)str.size() ) );
+      if( str.size() )
+         s.write( str.data(), str.size() );
+      return s;
+   }
+
+   inline snapshot_istream& operator>>( snapshot_istream& s, shared_string& str )
+   {
+      fc::unsigned_int size;
+      fc::raw::unpack( s, size );
+      str.resize( size.value );
+      if( size.value )
+         s.read( &str[0], size.value );
+      return s;
+   }
+
+   /**
+    * Attached to every index by add_core_index and add_plugin_index, so the snapshot code can reach
+    * all indices without knowing their types.
+    */
+   class abstract_snapshot_index : public chainbase::index_extension
+   {
+      public:
+         virtual ~abstract_snapshot_index() {}
+
+         virtual std::string type_name()const = 0;
+
+         /** Write the next id, the object count and the objects as of the given revision */
+         virtual void write( std::ostream& out, int64_t revision )const = 0;
+
+         /** Create the objects written by write() in the (empty) index */
+         virtual void read( std::istream& in ) = 0;
+   };
+
+   template< typename MultiIndexType >
+   class snapshot_index : public abstract_snapshot_index
+   {
+      public:
+         typedef typename chainbase::generic_index< MultiIndexType >::value_type value_type;
+
+         snapshot_index( database& db ) : _db( db ) {}
+
+         virtual std::string type_name()const override
+         {
+            return boost::core::demangle( typeid( value_type ).name() );
+         }
+
+         virtual void write( std::ostream& out, int64_t revision )const override
+         {
+            const auto& idx = _db.get_index< MultiIndexType >();
+            snapshot_ostream s( out );
+
+            // The next id and count are only known after the walk, so they are patched in afterwards
+            auto counts_pos = out.tellp();
+            int64_t next_id = 0;
+            uint64_t count = 0;
+            fc::raw::pack( s, next_id );
+            fc::raw::pack( s, count );
+
+            next_id = idx.for_each_at_revision( revision, [&]( const value_type& obj )
+            {
+               fc::raw::pack( s, obj.id._id );
+               fc::raw::pack( s, obj );
+               ++count;
+            })._id;
+
+            auto end_pos = out.tellp();
+            out.seekp( counts_pos );
+            fc::raw::pack( s, next_id );
+            fc::raw::pack( s, count );
+            out.seekp( end_pos );
+         }
+
+         virtual void read( std::istream& in )override
+         {
+            auto& idx = _db.get_mutable_index< MultiIndexType >();
+            FC_ASSERT( idx.indices().empty(), "Cannot load a snapshot into a non-empty index", ("index", type_name()) );
+            snapshot_istream s( in );
+
+            int64_t next_id;
+            uint64_t count;
+            fc::raw::unpack( s, next_id );
+            fc::raw::unpack( s, count );
+
+            for( uint64_t i = 0; i < count; ++i )
+            {
+               int64_t id;
+               fc::raw::unpack( s, id );
+               idx.emplace( [&]( value_type& obj )
+               {
+                  fc::raw::unpack( s, obj );
+                  obj.id = typename value_type::id_type( id );
+               });
+            }
+
+            idx.set_next_id( typename value_type::id_type( next_id ) );
+         }
+
+      private:
+         database& _db;
+   };
+
+} }
+
+FC_REFLECT( sigmaengine::chain::snapshot_header, (magic)(version)(chain_id)(block_num)(block_id)(timestamp)(index_count) )
@@ -0,0 +1,121 @@
+#include <sigmaengine/chain/precomputed_transaction.hpp>
+#include <sigmaengine/protocol/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <atomic>
+
+namespace sigmaengine { namespace chain {
+
+   namespace detail {
+      static std::atomic< uint64_t > computed_count{ 0 };
+      static std::atomic< uint64_t > reused_count{ 0 };
+
+      inline void count( bool reused )
+      {
+         ( reused ? reused_count : computed_count ).fetch_add( 1, std::memory_order_relaxed );
+      }
+   }
+
+   precomputed_transaction::precomputed_transaction( const signed_transaction& trx )
+   :_owned( std::make_shared< signed_transaction >( trx ) )
+   {
+      _trx = _owned.get();
+   }
+
+   precomputed_transaction precomputed_transaction::borrow( const signed_transaction& trx, const transaction_id_type* id )
+   {
+      precomputed_transaction result;
+      result._trx = &trx;
+      if( id != nullptr )
+         result._id = *id;
+      return result;
+   }
+
+   precomputed_transaction precomputed_transaction::share( std::shared_ptr< const void > owner, const signed_transaction& trx )
+   {
+      precomputed_transaction result;
+      result._owned = std::shared_ptr< const signed_transaction >( std::move( owner ), &trx );
+      result._trx = &trx;
+      return result;
+   }
+
+   const vector< char >& precomputed_transaction::packed()const
+   {
+      detail::count( _packed.valid() );
+      if( !_packed.valid() )
+         _packed = fc::raw::pack( *_trx );
+      return *_packed;
+   }
+
+   size_t precomputed_transaction::unsigned_size()const
+   {
+      // signed_transaction packs the transaction fields first and the signatures last
+      return packed().size() - fc::raw::pack_size( _trx->signatures );
+   }
+
+   const transaction_id_type& precomputed_transaction::id()const
+   {
+      detail::count( _id.valid() );
+      if( !_id.valid() )
+      {
+         digest_type::encoder enc;
+         enc.write( packed().data(), unsigned_size() );
+         auto h = enc.result();
+         transaction_id_type result;
+         memcpy( result._hash, h._hash, std::min( sizeof( result ), sizeof( h ) ) );
+         _id = result;
+      }
+      return *_id;
+   }
+
+   const digest_type& precomputed_transaction::sig_digest( const chain_id_type& chain_id )const
+   {
+      bool cached = _sig_chain_id.valid() && *_sig_chain_id == chain_id;
+      detail::count( cached );
+      if( !cached )
+      {
+         digest_type::encoder enc;
+         fc::raw::pack( enc, chain_id );
+         enc.write( packed().data(), unsigned_size() );
+         _sig_digest = enc.result();
+         _sig_chain_id = chain_id;
+         _signature_keys.reset();
+      }
+      return _sig_digest;
+   }
+
+   const flat_set< public_key_type >& precomputed_transaction::signature_keys( const chain_id_type& chain_id )const
+   { try {
+      bool cached = _signature_keys.valid() && _sig_chain_id.valid() && *_sig_chain_id == chain_id;
+      if( cached )
+      {
+         detail::count( true );
+         return *_signature_keys;
+      }
+
+      detail::count( false );
+      const auto& d = sig_digest( chain_id );
+      flat_set< public_key_type > result;
+      for( const auto& sig : _trx->signatures )
+      {
+         SIGMAENGINE_ASSERT(
+            result.insert( fc::ecc::public_key( sig, d ) ).second,
+            tx_duplicate_sig,
+            "Duplicate Signature detected" );
+      }
+      _signature_keys = std::move( result );
+      return *_signature_keys;
+   } FC_CAPTURE_AND_RETHROW() }
+
+   uint64_t precomputed_transaction::computed_count()
+   {
+      return detail::computed_count.load( std::memory_order_relaxed );
+   }
+
+   uint64_t precomputed_transaction::reused_count()
+   {
+      return detail::reused_count.load( std::memory_order_relaxed );
+   }
+
+} } // sigmaengine::chain
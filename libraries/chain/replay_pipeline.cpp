@@ -0,0 +1,242 @@
+#include <sigmaengine/chain/replay_pipeline.hpp>
+#include <fc/io/raw.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace sigmaengine { namespace chain {
+
+   namespace detail {
+      struct raw_block
+      {
+         uint32_t       block_num = 0;
+         vector< char > data;
+      };
+
+      class replay_pipeline_impl {
+         public:
+            fc::path                                    block_file;
+            fc::path                                    index_file;
+            uint32_t                                    first_block = 0;
+            uint32_t                                    last_block = 0;
+            uint32_t                                    queue_size = 0;
+
+            std::vector< std::thread >                  threads;
+
+            mutable std::mutex                          mtx;
+            std::condition_variable                     reader_cv;
+            std::condition_variable                     worker_cv;
+            std::condition_variable                     consumer_cv;
+
+            std::deque< raw_block >                     raw_queue;
+            std::map< uint32_t, replayed_block_ptr >    ready;
+            uint32_t                                    next_to_consume = 0;
+            uint64_t                                    consumed_bytes = 0;
+            bool                                        reader_done = false;
+            bool                                        stopping = false;
+            fc::exception_ptr                           error;
+
+            void set_error( fc::exception_ptr e )
+            {
+               std::lock_guard< std::mutex > lock( mtx );
+               if( !error )
+                  error = e;
+               stopping = true;
+               reader_cv.notify_all();
+               worker_cv.notify_all();
+               consumer_cv.notify_all();
+            }
+
+            template< typename Lambda >
+            void guarded( Lambda&& l )
+            {
+               try
+               {
+                  l();
+               }
+               catch( const fc::exception& e )
+               {
+                  set_error( e.dynamic_copy_exception() );
+               }
+               catch( const std::exception& e )
+               {
+                  set_error( std::make_shared< fc::exception >( FC_LOG_MESSAGE( error, "${what}", ("what", e.what()) ) ) );
+               }
+               catch( ... )
+               {
+                  set_error( std::make_shared< fc::unhandled_exception >( FC_LOG_MESSAGE( error, "unknown exception in replay pipeline" ), std::current_exception() ) );
+               }
+            }
+
+            void read_loop()
+            {
+               guarded( [&]()
+               {
+                  std::ifstream block_stream( block_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+                  std::ifstream index_stream( index_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+                  block_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+                  index_stream.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+                  // The head block is terminated by its own position rather than by the next index entry
+                  const uint64_t indexed_blocks = fc::file_size( index_file ) / sizeof( uint64_t );
+                  const uint64_t end_of_log = fc::file_size( block_file ) - sizeof( uint64_t );
+                  FC_ASSERT( last_block <= indexed_blocks, "Block log index is shorter than the replay range",
+                     ("indexed_blocks", indexed_blocks)("last_block", last_block) );
+
+                  uint64_t pos;
+                  index_stream.seekg( sizeof( uint64_t ) * ( first_block - 1 ) );
+                  index_stream.read( (char*)&pos, sizeof( pos ) );
+
+                  for( uint32_t block_num = first_block; block_num <= last_block; ++block_num )
+                  {
+                     uint64_t next_pos = end_of_log + sizeof( uint64_t );
+                     if( block_num < indexed_blocks )
+                        index_stream.read( (char*)&next_pos, sizeof( next_pos ) );
+
+                     FC_ASSERT( next_pos > pos + sizeof( uint64_t ), "Corrupt block log index", ("block_num", block_num)("pos", pos)("next_pos", next_pos) );
+
+                     raw_block raw;
+                     raw.block_num = block_num;
+                     raw.data.resize( next_pos - pos - sizeof( uint64_t ) );
+                     block_stream.seekg( pos );
+                     block_stream.read( raw.data.data(), raw.data.size() );
+
+                     {
+                        std::unique_lock< std::mutex > lock( mtx );
+                        reader_cv.wait( lock, [&]() { return stopping || block_num - next_to_consume < queue_size; } );
+                        if( stopping )
+                           return;
+
+                        raw_queue.emplace_back( std::move( raw ) );
+                     }
+                     worker_cv.notify_one();
+
+                     pos = next_pos;
+                  }
+
+                  std::lock_guard< std::mutex > lock( mtx );
+                  reader_done = true;
+                  worker_cv.notify_all();
+               });
+            }
+
+            void work_loop()
+            {
+               guarded( [&]()
+               {
+                  while( true )
+                  {
+                     raw_block raw;
+                     {
+                        std::unique_lock< std::mutex > lock( mtx );
+                        worker_cv.wait( lock, [&]() { return stopping || reader_done || !raw_queue.empty(); } );
+                        if( stopping || raw_queue.empty() )
+                           return;
+
+                        raw = std::move( raw_queue.front() );
+                        raw_queue.pop_front();
+                     }
+
+                     auto result = std::make_shared< replayed_block >();
+                     result->block_num = raw.block_num;
+                     result->byte_size = raw.data.size();
+                     fc::datastream< const char* > ds( raw.data.data(), raw.data.size() );
+                     fc::raw::unpack( ds, result->block );
+
+                     FC_ASSERT( result->block.block_num() == raw.block_num, "Wrong block was read from block log.",
+                        ("returned", result->block.block_num())("expected", raw.block_num) );
+
+                     result->block_id = result->block.id();
+                     result->trx_ids.reserve( result->block.transactions.size() );
+                     for( const auto& trx : result->block.transactions )
+                        result->trx_ids.push_back( trx.id() );
+
+                     // Replay skips the merkle check on the applier, so it is verified here instead
+                     auto merkle_root = result->block.calculate_merkle_root();
+                     FC_ASSERT( result->block.transaction_merkle_root == merkle_root, "Merkle check failed",
+                        ("block_num", raw.block_num)("transaction_merkle_root", result->block.transaction_merkle_root)("calc", merkle_root) );
+
+                     {
+                        std::lock_guard< std::mutex > lock( mtx );
+                        ready[ raw.block_num ] = result;
+                     }
+                     consumer_cv.notify_all();
+                  }
+               });
+            }
+      };
+   }
+
+   replay_pipeline::replay_pipeline( const fc::path& block_file, uint32_t first_block, uint32_t last_block,
+                                     uint32_t worker_threads, uint32_t queue_size )
+   :my( new detail::replay_pipeline_impl() )
+   {
+      FC_ASSERT( first_block > 0 && first_block <= last_block, "Invalid replay range", ("first", first_block)("last", last_block) );
+      FC_ASSERT( worker_threads > 0 );
+      FC_ASSERT( queue_size > 0 );
+
+      my->block_file = block_file;
+      my->index_file = fc::path( block_file.generic_string() + ".index" );
+      my->first_block = first_block;
+      my->last_block = last_block;
+      my->queue_size = queue_size;
+      my->next_to_consume = first_block;
+
+      my->threads.emplace_back( [this]() { my->read_loop(); } );
+      for( uint32_t i = 0; i < worker_threads; ++i )
+         my->threads.emplace_back( [this]() { my->work_loop(); } );
+   }
+
+   replay_pipeline::~replay_pipeline()
+   {
+      {
+         std::lock_guard< std::mutex > lock( my->mtx );
+         my->stopping = true;
+      }
+      my->reader_cv.notify_all();
+      my->worker_cv.notify_all();
+
+      for( auto& t : my->threads )
+         t.join();
+   }
+
+   replayed_block_ptr replay_pipeline::next()
+   {
+      replayed_block_ptr result;
+      {
+         std::unique_lock< std::mutex > lock( my->mtx );
+         if( my->next_to_consume > my->last_block )
+            return result;
+
+         my->consumer_cv.wait( lock, [&]() { return my->error || my->ready.count( my->next_to_consume ); } );
+         if( my->error )
+            my->error->dynamic_rethrow_exception();
+
+         auto itr = my->ready.find( my->next_to_consume );
+         result = itr->second;
+         my->ready.erase( itr );
+         ++my->next_to_consume;
+         my->consumed_bytes += result->byte_size;
+      }
+      my->reader_cv.notify_one();
+
+      return result;
+   }
+
+   uint32_t replay_pipeline::in_flight()const
+   {
+      std::lock_guard< std::mutex > lock( my->mtx );
+      return my->raw_queue.size() + my->ready.size();
+   }
+
+   uint64_t replay_pipeline::bytes_consumed()const
+   {
+      std::lock_guard< std::mutex > lock( my->mtx );
+      return my->consumed_bytes;
+   }
+
+} } // sigmaengine::chain
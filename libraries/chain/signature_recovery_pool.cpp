@@ -0,0 +1,130 @@
+#include <sigmaengine/chain/signature_recovery_pool.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace sigmaengine { namespace chain {
+
+   namespace detail {
+      class signature_recovery_pool_impl {
+         public:
+            std::vector< std::thread >                  threads;
+
+            std::mutex                                  job_mutex;
+            std::mutex                                  mtx;
+            std::condition_variable                     work_cv;
+            std::condition_variable                     done_cv;
+
+            uint64_t                                    generation = 0;
+            uint32_t                                    busy_workers = 0;
+            bool                                        stopping = false;
+
+            const vector< signed_transaction >*         trxs = nullptr;
+            vector< recovered_signature_keys >*         results = nullptr;
+            chain_id_type                               chain_id;
+            std::atomic< uint32_t >                     next_trx{ 0 };
+
+            void recover_one( uint32_t i )
+            {
+               auto& result = (*results)[i];
+               try
+               {
+                  result.keys = (*trxs)[i].get_signature_keys( chain_id );
+               }
+               catch( const fc::exception& e )
+               {
+                  result.error = e.dynamic_copy_exception();
+               }
+               catch( const std::exception& e )
+               {
+                  result.error = std::make_shared< fc::exception >( FC_LOG_MESSAGE( error, "${what}", ("what", e.what()) ) );
+               }
+            }
+
+            void run_job()
+            {
+               uint32_t i;
+               while( ( i = next_trx.fetch_add( 1, std::memory_order_relaxed ) ) < trxs->size() )
+                  recover_one( i );
+            }
+
+            void work_loop()
+            {
+               uint64_t seen = 0;
+               while( true )
+               {
+                  {
+                     std::unique_lock< std::mutex > lock( mtx );
+                     work_cv.wait( lock, [&]() { return stopping || generation != seen; } );
+                     if( stopping )
+                        return;
+                     seen = generation;
+                  }
+
+                  run_job();
+
+                  std::lock_guard< std::mutex > lock( mtx );
+                  if( --busy_workers == 0 )
+                     done_cv.notify_all();
+               }
+            }
+      };
+   }
+
+   signature_recovery_pool::signature_recovery_pool( uint32_t worker_threads )
+   :my( new detail::signature_recovery_pool_impl() )
+   {
+      for( uint32_t i = 0; i < worker_threads; ++i )
+         my->threads.emplace_back( [this]() { my->work_loop(); } );
+   }
+
+   signature_recovery_pool::~signature_recovery_pool()
+   {
+      {
+         std::lock_guard< std::mutex > lock( my->mtx );
+         my->stopping = true;
+      }
+      my->work_cv.notify_all();
+
+      for( auto& t : my->threads )
+         t.join();
+   }
+
+   vector< recovered_signature_keys > signature_recovery_pool::recover( const vector< signed_transaction >& trxs, const chain_id_type& chain_id )
+   {
+      std::lock_guard< std::mutex > job_lock( my->job_mutex );
+
+      vector< recovered_signature_keys > results( trxs.size() );
+      my->trxs = &trxs;
+      my->results = &results;
+      my->chain_id = chain_id;
+      my->next_trx.store( 0, std::memory_order_relaxed );
+
+      if( !my->threads.empty() && trxs.size() > 1 )
+      {
+         {
+            std::lock_guard< std::mutex > lock( my->mtx );
+            my->busy_workers = my->threads.size();
+            ++my->generation;
+         }
+         my->work_cv.notify_all();
+
+         my->run_job();
+
+         // The workers reference results, so wait for all of them before returning it
+         std::unique_lock< std::mutex > lock( my->mtx );
+         my->done_cv.wait( lock, [&]() { return my->busy_workers == 0; } );
+      }
+      else
+      {
+         my->run_job();
+      }
+
+      my->trxs = nullptr;
+      my->results = nullptr;
+      return results;
+   }
+
+} } // sigmaengine::chain
@@ -12,6 +12,7 @@
 #include <boost/interprocess/sync/file_lock.hpp>
 
 #include <boost/multi_index_container.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <boost/chrono.hpp>
 #include <boost/config.hpp>
@@ -26,7 +27,9 @@
 #include <atomic>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <type_traits>
 #include <typeindex>
 #include <typeinfo>
 
@@ -126,30 +129,93 @@ namespace chainbase {
    template<typename Constructor, typename Allocator> \
    OBJECT_TYPE( Constructor&& c, Allocator&&  ) { c(*this); }
 
+   /**
+    * The changes an index went through in one revision. The value an object had before its first
+    * change in the revision is appended to an append-only log, and a hash from object id to change
+    * tells whether an object was touched already, so recording a change costs one hash lookup and,
+    * on first touch, one copy of the object into the log.
+    */
    template< typename value_type >
    class undo_state
    {
       public:
          typedef typename value_type::id_type                      id_type;
-         typedef allocator< std::pair<const id_type, value_type> > id_value_allocator_type;
-         typedef allocator< id_type >                              id_allocator_type;
+
+         enum change_type : uint8_t
+         {
+            created,
+            modified,
+            removed
+         };
+
+         struct change
+         {
+            change_type   type = created;
+            uint32_t      slot = 0;        ///< position of the old value in old_values, unused when created
+         };
+
+         struct id_hash
+         {
+            size_t operator()( const id_type& id )const { return boost::hash< int64_t >()( id._id ); }
+         };
+
+         typedef allocator< std::pair< const id_type, change > >  change_allocator_type;
+         typedef allocator< value_type >                          value_allocator_type;
+
+         typedef boost::unordered_map< id_type, change, id_hash, std::equal_to< id_type >, change_allocator_type >  id_change_map;
+         typedef boost::interprocess::deque< value_type, value_allocator_type >                                   value_log;
 
          template<typename T>
          undo_state( allocator<T> al )
-         :old_values( id_value_allocator_type( al.get_segment_manager() ) ),
-          removed_values( id_value_allocator_type( al.get_segment_manager() ) ),
-          new_ids( id_allocator_type( al.get_segment_manager() ) ){}
+         :changes( change_allocator_type( al.get_segment_manager() ) ),
+          old_values( value_allocator_type( al.get_segment_manager() ) ){}
 
-         typedef boost::interprocess::map< id_type, value_type, std::less<id_type>, id_value_allocator_type >  id_value_type_map;
-         typedef boost::interprocess::set< id_type, std::less<id_type>, id_allocator_type >                    id_type_set;
+         /** Appends v to the log and returns its slot */
+         template< typename Value >
+         uint32_t log( Value&& v )
+         {
+            old_values.push_back( std::forward< Value >( v ) );
+            return old_values.size() - 1;
+         }
 
-         id_value_type_map            old_values;
-         id_value_type_map            removed_values;
-         id_type_set                  new_ids;
+         id_change_map                changes;
+         value_log                    old_values;
          id_type                      old_next_id = 0;
          int64_t                      revision = 0;
    };
 
+   /**
+    * Undo bookkeeping shared by all indices of a database. Starting an undo session only moves the
+    * revision forward, an index adds an undo state for the current revision the first time it is
+    * written to in it and lists itself in touched, so undoing or squashing a revision only visits
+    * the indices that changed in it.
+    */
+   struct undo_context
+   {
+      struct touched_index
+      {
+         int64_t  revision = 0;
+         uint16_t type_id = 0;
+      };
+
+      typedef boost::interprocess::deque< touched_index, allocator< touched_index > > touched_index_deque;
+
+      /** Changes whenever the layout of the indices or their undo states changes */
+      static const uint32_t current_version = 2;
+
+      template<typename T>
+      undo_context( allocator<T> al )
+      :touched( allocator< touched_index >( al.get_segment_manager() ) ){}
+
+      /** true while there is a revision that can be undone */
+      bool enabled()const { return revision > committed_revision; }
+
+      uint32_t                version = current_version;
+      int64_t                 revision = 0;
+      int64_t                 committed_revision = 0;   ///< changes up to this revision can no longer be undone
+      touched_index_deque     touched;                  ///< indices holding an undo state, ordered by revision
+   };
+
    /**
     * The code we want to implement is this:
     *
@@ -173,6 +239,19 @@ namespace chainbase {
          int32_t& _target;
    };
 
+   /** An int_incrementer for a counter shared between threads */
+   class atomic_incrementer
+   {
+      public:
+         atomic_incrementer( std::atomic< uint32_t >& target ) : _target(target)
+         { ++_target; }
+         ~atomic_incrementer()
+         { --_target; }
+
+      private:
+         std::atomic< uint32_t >& _target;
+   };
+
    /**
     *  The value_type stored in the multiindex container must have a integer field with the name 'id'.  This will
     *  be the primary key and it will be assigned and managed by generic_index.
@@ -189,8 +268,8 @@ namespace chainbase {
          typedef bip::allocator< generic_index, segment_manager_type > allocator_type;
          typedef undo_state< value_type >                              undo_state_type;
 
-         generic_index( allocator<value_type> a )
-         :_stack(a),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::node_type) ),_size_of_this(sizeof(*this)){}
+         generic_index( allocator<value_type> a, undo_context* context )
+         :_stack(a),_context(context),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::node_type) ),_size_of_this(sizeof(*this)){}
 
          void validate()const {
             if( sizeof(typename MultiIndexType::node_type) != _size_of_value_type || sizeof(*this) != _size_of_this )
@@ -216,8 +295,8 @@ namespace chainbase {
                BOOST_THROW_EXCEPTION( std::logic_error("could not insert object, most likely a uniqueness constraint was violated") );
             }
 
-            ++_next_id;
             on_create( *insert_result.first );
+            ++_next_id;
             return *insert_result.first;
          }
 
@@ -249,118 +328,76 @@ namespace chainbase {
 
          const index_type& indices()const { return _indices; }
 
-         class session {
-            public:
-               session( session&& mv )
-               :_index(mv._index),_apply(mv._apply),_revision(mv._revision)
-               { 
-                  mv._apply = false; 
-               }
-
-               ~session() {
-                  if( _apply ) {
-                     _index.undo();
-                  }
-               }
-
-               /** leaves the UNDO state on the stack when session goes out of scope */
-               void push()   { _apply = false; }
-               /** combines this session with the prior session */
-               void squash() { if( _apply ) _index.squash(); _apply = false; }
-               void undo()   { if( _apply ) _index.undo();  _apply = false; }
-
-               session& operator = ( session&& mv ) {
-                  if( this == &mv ) return *this;
-                  if( _apply ) _index.undo();
-                  _apply = mv._apply;
-                  mv._apply = false;
-                  return *this;
-               }
-
-               int64_t revision()const { return _revision; }
-
-            private:
-               friend class generic_index;
-
-               session( generic_index& idx, int64_t revision )
-               :_index(idx),_revision(revision) {
-                  if( revision == -1 )
-                     _apply = false;
-               }
-
-               generic_index& _index;
-               bool           _apply = true;
-               int64_t        _revision = 0;
-         };
-
-         session start_undo_session( bool enabled ) {
-            if( enabled ) {
-               _stack.emplace_back( _indices.get_allocator() );
-               _stack.back().old_next_id = _next_id;
-               _stack.back().revision = ++_revision;
-               return session( *this, _revision );
-            } else {
-               return session( *this, -1 );
-            }
-         }
-
          const index_type& indicies()const { return _indices; }
-         int64_t revision()const { return _revision; }
+         int64_t revision()const { return _context->revision; }
 
 
          /**
           *  Restores the state to how it was prior to the current session discarding all changes
-          *  made between the last revision and the current revision.
+          *  made between the last revision and the current revision. The database moves the
+          *  revision back afterwards.
           */
          void undo() {
-            if( !enabled() ) return;
+            if( !head_in_current_revision() ) return;
 
-            const auto& head = _stack.back();
+            auto& head = _stack.back();
 
-            for( auto& item : head.old_values ) {
-               auto ok = _indices.modify( _indices.find( item.second.id ), [&]( value_type& v ) {
-                  v = std::move( item.second );
-               });
-               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+            // Created objects go first and removed objects come back last, so that no restored
+            // object collides with a key that was only taken or freed within the revision
+            for( const auto& item : head.changes ) {
+               if( item.second.type == undo_state_type::created )
+                  _indices.erase( _indices.find( item.first ) );
             }
+            _next_id = head.old_next_id;
 
-            for( auto id : head.new_ids )
-            {
-               _indices.erase( _indices.find( id ) );
+            for( const auto& item : head.changes ) {
+               if( item.second.type != undo_state_type::modified ) continue;
+               auto ok = _indices.modify( _indices.find( item.first ), [&]( value_type& v ) {
+                  v = std::move( head.old_values[ item.second.slot ] );
+               });
+               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
             }
-            _next_id = head.old_next_id;
 
-            for( auto& item : head.removed_values ) {
-               bool ok = _indices.emplace( std::move( item.second ) ).second;
+            for( const auto& item : head.changes ) {
+               if( item.second.type != undo_state_type::removed ) continue;
+               bool ok = _indices.emplace( std::move( head.old_values[ item.second.slot ] ) ).second;
                if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not restore object, most likely a uniqueness constraint was violated" ) );
             }
 
             _stack.pop_back();
-            --_revision;
          }
 
          /**
           *  This method works similar to git squash, it merges the change set from the two most
-          *  recent revision numbers into one revision number (reducing the head revision number)
+          *  recent revision numbers into one revision number. The database moves the revision
+          *  back afterwards.
           *
           *  This method does not change the state of the index, only the state of the undo buffer.
+          *
+          *  Returns true when the index had no changes in the previous revision, so that the
+          *  changes of the current revision became the previous revision's undo state as they are.
           */
-         void squash()
+         bool squash()
          {
-            if( !enabled() ) return;
-            if( _stack.size() == 1 ) {
-               _stack.pop_front();
-               return;
+            if( !head_in_current_revision() ) return false;
+            if( _context->revision - 1 <= _context->committed_revision ) {
+               _stack.pop_back();
+               return false;
+            }
+            if( _stack.size() == 1 || _stack[_stack.size()-2].revision != _context->revision - 1 ) {
+               // nop + B -> B
+               --_stack.back().revision;
+               return true;
             }
 
             auto& state = _stack.back();
             auto& prev_state = _stack[_stack.size()-2];
 
             // An object's relationship to a state can be:
-            // in new_ids            : new
-            // in old_values (was=X) : upd(was=X)
-            // in removed (was=X)    : del(was=X)
-            // not in any of above   : nop
+            // created              : new
+            // modified (was=X)     : upd(was=X)
+            // removed (was=X)      : del(was=X)
+            // not in changes       : nop
             //
             // When merging A=prev_state and B=state we have a 4x4 matrix of all possibilities:
             //
@@ -378,73 +415,58 @@ namespace chainbase {
             // \ | nop        | new       B| upd(was=Y)B| del(was=Y)B| nop      AB|
             //   +------------+------------+------------+------------+------------+
             //
-            // Each entry was composed by labelling what should occur in the given case.
-            //
             // Type A means the composition of states contains the same entry as the first of the two merged states for that object.
             // Type B means the composition of states contains the same entry as the second of the two merged states for that object.
             // Type C means the composition of states contains an entry different from either of the merged states for that object.
             // Type N/A means the composition of states violates causal timing.
             // Type AB means both type A and type B simultaneously.
             //
-            // The merge() operation is defined as modifying prev_state in-place to be the state object which represents the composition of
-            // state A and B.
-            //
-            // Type A (and AB) can be implemented as a no-op; prev_state already contains the correct value for the merged state.
-            // Type B (and AB) can be implemented by copying from state to prev_state.
-            // Type C needs special case-by-case logic.
-            // Type N/A can be ignored or assert(false) as it can only occur if prev_state and state have illegal values
-            // (a serious logic error which should never happen).
+            // Type A (and AB) is a no-op, prev_state already holds the entry. Type B appends the
+            // value from the log of state to the log of prev_state. Type C only changes the entry
+            // in prev_state, the value logged there stays the one to restore.
             //
+            // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's changes.
 
-            // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
+            prev_state.changes.reserve( prev_state.changes.size() + state.changes.size() );
 
-            for( const auto& item : state.old_values )
+            for( auto& item : state.changes )
             {
-               if( prev_state.new_ids.find( item.second.id ) != prev_state.new_ids.end() )
+               auto prev = prev_state.changes.find( item.first );
+
+               if( prev == prev_state.changes.end() )
                {
-                  // new+upd -> new, type A
+                  // nop + * -> *, type B
+                  typename undo_state_type::change c = item.second;
+                  if( c.type != undo_state_type::created )
+                     c.slot = prev_state.log( std::move( state.old_values[ item.second.slot ] ) );
+                  prev_state.changes.emplace( item.first, c );
                   continue;
                }
-               if( prev_state.old_values.find( item.second.id ) != prev_state.old_values.end() )
+
+               // *+new and del+* -> N/A
+               assert( item.second.type != undo_state_type::created );
+               assert( prev->second.type != undo_state_type::removed );
+
+               if( item.second.type == undo_state_type::modified )
                {
-                  // upd(was=X) + upd(was=Y) -> upd(was=X), type A
+                  // new+upd -> new, upd(was=X) + upd(was=Y) -> upd(was=X), type A
                   continue;
                }
-               // del+upd -> N/A
-               assert( prev_state.removed_values.find(item.second.id) == prev_state.removed_values.end() );
-               // nop+upd(was=Y) -> upd(was=Y), type B
-               prev_state.old_values.emplace( std::move(item) );
-            }
-
-            // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
-            for( auto id : state.new_ids )
-               prev_state.new_ids.insert(id);
 
-            // *+del
-            for( auto& obj : state.removed_values )
-            {
-               if( prev_state.new_ids.find(obj.second.id) != prev_state.new_ids.end() )
+               if( prev->second.type == undo_state_type::created )
                {
                   // new + del -> nop (type C)
-                  prev_state.new_ids.erase(obj.second.id);
-                  continue;
+                  prev_state.changes.erase( prev );
                }
-               auto it = prev_state.old_values.find(obj.second.id);
-               if( it != prev_state.old_values.end() )
+               else
                {
-                  // upd(was=X) + del(was=Y) -> del(was=X)
-                  prev_state.removed_values.emplace( std::move(*it) );
-                  prev_state.old_values.erase(obj.second.id);
-                  continue;
+                  // upd(was=X) + del(was=Y) -> del(was=X) (type C)
+                  prev->second.type = undo_state_type::removed;
                }
-               // del + del -> N/A
-               assert( prev_state.removed_values.find( obj.second.id ) == prev_state.removed_values.end() );
-               // nop + del(was=Y) -> del(was=Y)
-               prev_state.removed_values.emplace( std::move(obj) ); //[obj.second->id] = std::move(obj.second);
             }
 
             _stack.pop_back();
-            --_revision;
+            return false;
          }
 
          /**
@@ -458,113 +480,180 @@ namespace chainbase {
             }
          }
 
-         /**
-          * Unwinds all undo states
-          */
-         void undo_all()
+         void remove_object( int64_t id )
          {
-            while( enabled() )
-               undo();
+            const value_type* val = find( typename value_type::id_type(id) );
+            if( !val ) BOOST_THROW_EXCEPTION( std::out_of_range( boost::lexical_cast<std::string>(id) ) );
+            remove( *val );
          }
 
-         void set_revision( int64_t revision )
+         typename value_type::id_type next_id()const { return _next_id; }
+
+         void set_next_id( typename value_type::id_type next_id )
          {
-            if( _stack.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set revision while there is an existing undo stack") );
-            _revision = revision;
+            if( _stack.size() != 0 ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set next id while there is an existing undo stack") );
+            _next_id = next_id;
          }
 
-         void remove_object( int64_t id )
+         /**
+          * Calls f with every object as it was at the given revision, by looking past the undo states
+          * newer than revision instead of undoing them. The index is not modified. An object that
+          * changed after revision is visited with its value from the oldest such undo state.
+          *
+          * Returns the next id as it was at revision.
+          */
+         template< typename Function >
+         typename value_type::id_type for_each_at_revision( int64_t revision, Function&& f )const
          {
-            const value_type* val = find( typename value_type::id_type(id) );
-            if( !val ) BOOST_THROW_EXCEPTION( std::out_of_range( boost::lexical_cast<std::string>(id) ) );
-            remove( *val );
+            if( revision < _context->revision && revision < _context->committed_revision )
+               BOOST_THROW_EXCEPTION( std::logic_error( "revision is older than the undo history" ) );
+
+            // nullptr marks an object that did not exist yet at revision
+            std::map< typename value_type::id_type, const value_type* > overrides;
+            typename value_type::id_type next_id = _next_id;
+            bool found_state = false;
+
+            for( const auto& state : _stack )
+            {
+               if( state.revision <= revision )
+                  continue;
+
+               if( !found_state )
+               {
+                  next_id = state.old_next_id;
+                  found_state = true;
+               }
+
+               for( const auto& item : state.changes )
+               {
+                  if( item.second.type == undo_state_type::created )
+                     overrides.emplace( item.first, nullptr );
+                  else
+                     overrides.emplace( item.first, &state.old_values[ item.second.slot ] );
+               }
+            }
+
+            for( const auto& obj : _indices )
+            {
+               if( overrides.find( obj.id ) == overrides.end() )
+                  f( obj );
+            }
+
+            for( const auto& item : overrides )
+            {
+               if( item.second != nullptr )
+                  f( *item.second );
+            }
+
+            return next_id;
+         }
+
+         /**
+          * Calls f with the id of every object created, modified or removed after revision. Returns false
+          * without calling f when the undo history does not reach back to revision.
+          */
+         template< typename Function >
+         bool for_each_changed_since( int64_t revision, Function&& f )const
+         {
+            if( revision < _context->revision && revision < _context->committed_revision )
+               return false;
+
+            for( const auto& state : _stack )
+            {
+               if( state.revision <= revision )
+                  continue;
+
+               for( const auto& item : state.changes )
+                  f( item.first );
+            }
+
+            return true;
          }
 
       private:
-         bool enabled()const { return _stack.size(); }
+         bool head_in_current_revision()const {
+            return _stack.size() && _stack.back().revision == _context->revision;
+         }
 
-         void on_modify( const value_type& v ) {
-            if( !enabled() ) return;
+         /**
+          * The undo state of the current revision, added on the first change in the revision, or
+          * nullptr when there is no undo session to record changes for.
+          */
+         undo_state_type* head_state() {
+            if( !_context->enabled() ) return nullptr;
 
-            auto& head = _stack.back();
+            if( !head_in_current_revision() ) {
+               _stack.emplace_back( _indices.get_allocator() );
+               _stack.back().old_next_id = _next_id;
+               _stack.back().revision = _context->revision;
 
-            if( head.new_ids.find( v.id ) != head.new_ids.end() )
-               return;
+               undo_context::touched_index touched;
+               touched.revision = _context->revision;
+               touched.type_id = value_type::type_id;
+               _context->touched.push_back( touched );
+            }
 
-            auto itr = head.old_values.find( v.id );
-            if( itr != head.old_values.end() )
-               return;
+            return &_stack.back();
+         }
 
-            head.old_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) );
+         void on_modify( const value_type& v ) {
+            auto state = head_state();
+            if( !state ) return;
+
+            // Only the first change of an object in the revision logs its value
+            auto result = state->changes.emplace( v.id, typename undo_state_type::change() );
+            if( !result.second ) return;
+
+            try {
+               result.first->second.type = undo_state_type::modified;
+               result.first->second.slot = state->log( v );
+            } catch( ... ) {
+               state->changes.erase( result.first );
+               throw;
+            }
          }
 
          void on_remove( const value_type& v ) {
-            if( !enabled() ) return;
-
-            auto& head = _stack.back();
-            if( head.new_ids.count(v.id) ) {
-               head.new_ids.erase( v.id );
+            auto state = head_state();
+            if( !state ) return;
+
+            auto itr = state->changes.find( v.id );
+            if( itr == state->changes.end() ) {
+               typename undo_state_type::change c;
+               c.type = undo_state_type::removed;
+               c.slot = state->log( v );
+               state->changes.emplace( v.id, c );
                return;
             }
 
-            auto itr = head.old_values.find( v.id );
-            if( itr != head.old_values.end() ) {
-               head.removed_values.emplace( std::move( *itr ) );
-               head.old_values.erase( v.id );
+            if( itr->second.type == undo_state_type::created ) {
+               state->changes.erase( itr );
                return;
             }
 
-            if( head.removed_values.count( v.id ) )
-               return;
-
-            head.removed_values.emplace( std::pair< typename value_type::id_type, const value_type& >( v.id, v ) );
+            // The value logged on the first modify is the one to restore
+            itr->second.type = undo_state_type::removed;
          }
 
          void on_create( const value_type& v ) {
-            if( !enabled() ) return;
-            auto& head = _stack.back();
+            auto state = head_state();
+            if( !state ) return;
 
-            head.new_ids.insert( v.id );
+            state->changes.emplace( v.id, typename undo_state_type::change() );
          }
 
-         boost::interprocess::deque< undo_state_type, allocator<undo_state_type> > _stack;
-
          /**
-          *  Each new session increments the revision, a squash will decrement the revision by combining
-          *  the two most recent revisions into one revision.
-          *
-          *  Commit will discard all revisions prior to the committed revision.
+          *  Undo states of the revisions this index was changed in, oldest first. The revision
+          *  itself is kept in the undo context, which every index of the database shares.
           */
-         int64_t                         _revision = 0;
+         boost::interprocess::deque< undo_state_type, allocator<undo_state_type> > _stack;
+         bip::offset_ptr< undo_context > _context;
          typename value_type::id_type    _next_id = 0;
          index_type                      _indices;
          uint32_t                        _size_of_value_type = 0;
          uint32_t                        _size_of_this = 0;
    };
 
-   class abstract_session {
-      public:
-         virtual ~abstract_session(){};
-         virtual void push()             = 0;
-         virtual void squash()           = 0;
-         virtual void undo()             = 0;
-         virtual int64_t revision()const  = 0;
-   };
-
-   template<typename SessionType>
-   class session_impl : public abstract_session
-   {
-      public:
-         session_impl( SessionType&& s ):_session( std::move( s ) ){}
-
-         virtual void push() override  { _session.push();  }
-         virtual void squash() override{ _session.squash(); }
-         virtual void undo() override  { _session.undo();  }
-         virtual int64_t revision()const override  { return _session.revision();  }
-      private:
-         SessionType _session;
-   };
-
    class index_extension
    {
       public:
@@ -579,14 +668,11 @@ namespace chainbase {
       public:
          abstract_index( void* i ):_idx_ptr(i){}
          virtual ~abstract_index(){}
-         virtual void     set_revision( int64_t revision ) = 0;
-         virtual unique_ptr<abstract_session> start_undo_session( bool enabled ) = 0;
 
          virtual int64_t revision()const = 0;
          virtual void    undo()const = 0;
-         virtual void    squash()const = 0;
+         virtual bool    squash()const = 0;
          virtual void    commit( int64_t revision )const = 0;
-         virtual void    undo_all()const = 0;
          virtual uint32_t type_id()const  = 0;
 
          virtual void remove_object( int64_t id ) = 0;
@@ -594,6 +680,9 @@ namespace chainbase {
          void add_index_extension( std::shared_ptr< index_extension > ext )  { _extensions.push_back( ext ); }
          const index_extensions& get_index_extensions()const  { return _extensions; }
          void* get()const { return _idx_ptr; }
+
+         /** Points this index at its new address after the segment was mapped again */
+         void rebind( void* i ) { _idx_ptr = i; }
       private:
          void*              _idx_ptr;
          index_extensions   _extensions;
@@ -602,23 +691,18 @@ namespace chainbase {
    template<typename BaseIndex>
    class index_impl : public abstract_index {
       public:
-         index_impl( BaseIndex& base ):abstract_index( &base ),_base(base){}
+         index_impl( BaseIndex& base ):abstract_index( &base ){}
 
-         virtual unique_ptr<abstract_session> start_undo_session( bool enabled ) override {
-            return unique_ptr<abstract_session>( new session_impl<typename BaseIndex::session>( _base.start_undo_session( enabled ) ) );
-         }
-
-         virtual void     set_revision( int64_t revision ) override { _base.set_revision( revision ); }
-         virtual int64_t  revision()const  override { return _base.revision(); }
-         virtual void     undo()const  override { _base.undo(); }
-         virtual void     squash()const  override { _base.squash(); }
-         virtual void     commit( int64_t revision )const  override { _base.commit(revision); }
-         virtual void     undo_all() const override {_base.undo_all(); }
+         virtual int64_t  revision()const  override { return base().revision(); }
+         virtual void     undo()const  override { base().undo(); }
+         virtual bool     squash()const  override { return base().squash(); }
+         virtual void     commit( int64_t revision )const  override { base().commit(revision); }
          virtual uint32_t type_id()const override { return BaseIndex::value_type::type_id; }
 
-         virtual void     remove_object( int64_t id ) override { return _base.remove_object( id ); }
+         virtual void     remove_object( int64_t id ) override { return base().remove_object( id ); }
       private:
-         BaseIndex& _base;
+         /** Looked up through get() every time, the index moves when the segment is mapped again */
+         BaseIndex& base()const { return *static_cast< BaseIndex* >( get() ); }
    };
 
    template<typename IndexType>
@@ -660,6 +744,51 @@ namespace chainbase {
    };
 
 
+   /**
+    * How the shared memory file is mapped. By default it is mapped with the page size of the file
+    * system it is on, and its pages are faulted in as they are first used.
+    */
+   struct mapping_options
+   {
+      enum huge_page_mode
+      {
+         no_huge_pages,
+         transparent_huge_pages,   ///< madvise( MADV_HUGEPAGE ), honoured for files on tmpfs such as /dev/shm
+         hugetlbfs                 ///< the file is on a hugetlbfs mount, its size is rounded up to whole huge pages
+      };
+
+      /**
+       * NUMA placement of the file's pages, set with mbind() on the mapping. The kernel follows it for
+       * files on tmpfs and hugetlbfs. Page cache pages of other files are placed by the policy of the
+       * thread faulting them in, so with prefault the file is faulted in under the same policy.
+       */
+      enum numa_mode
+      {
+         numa_default,
+         numa_interleave,          ///< MPOL_INTERLEAVE, pages spread round robin over the nodes
+         numa_bind                 ///< MPOL_BIND, pages only taken from the nodes
+      };
+
+      huge_page_mode     huge_pages = no_huge_pages;
+      numa_mode          numa = numa_default;
+      vector< uint32_t > numa_nodes;             ///< nodes for numa, empty for all nodes the process may use
+      bool               warm_up = false;        ///< madvise( MADV_WILLNEED ) the whole file on open
+      bool               prefault = false;       ///< fault in the whole file on open and after it grows
+      bool               lock = false;           ///< mlock the whole file on open and after it grows
+   };
+
+   /**
+    * Cumulative memory counters of the thread that first asked for them, which should be the thread
+    * that applies blocks. dTLB misses need perf events, which the kernel may not allow.
+    */
+   struct mapping_stats
+   {
+      uint64_t minor_faults = 0;
+      uint64_t major_faults = 0;
+      uint64_t dtlb_misses = 0;
+      bool     dtlb_available = false;
+   };
+
    /**
     *  This class
     */
@@ -672,6 +801,7 @@ namespace chainbase {
          };
 
          database():_session_signal( std::make_shared< session_signal >() ){}
+         ~database();
 
          void open( const bfs::path& dir, uint32_t write = read_only, uint64_t shared_file_size = 0 );
          void close();
@@ -679,6 +809,32 @@ namespace chainbase {
          void wipe( const bfs::path& dir );
          void set_require_locking( bool enable_require_locking );
 
+         /** Takes effect on the next open */
+         void set_mapping_options( const mapping_options& options ) { _mapping_options = options; }
+         mapping_stats get_mapping_stats();
+
+         /**
+          * Grows the shared memory file by extra bytes while the database stays open. The segment
+          * is unmapped, grown and mapped again, possibly at another address. Everything inside the
+          * segment is addressed by offset and the indices and undo context are found again at their
+          * offsets, but references to objects held outside the segment become invalid, so call it
+          * only with the write lock held and between blocks, when nothing holds such references.
+          * Other processes that have the file open must map it again as well.
+          *
+          * Readers of this process that a writer moved past by taking a new lock may still be reading,
+          * so the segment is only unmapped once all of them are done, and readers starting meanwhile wait
+          * for it to be mapped again. Returns false, leaving the file as it is, when they are not done
+          * within wait_micro. Exits the process if the grown file cannot be mapped again, since every
+          * index points into the segment. The file is not flushed first, its dirty pages stay in the page
+          * cache when it is unmapped and are written back by the kernel even if the process exits.
+          */
+         bool grow( uint64_t extra, uint64_t wait_micro = 1000000 );
+
+         size_t get_size()const
+         {
+            return _segment->get_size();
+         }
+
 #ifdef CHAINBASE_CHECK_LOCKING
          void require_lock_fail( const char* method, const char* lock_type, const char* tname )const;
 
@@ -695,18 +851,20 @@ namespace chainbase {
          }
 #endif
 
+         /**
+          * An undo session is a revision of the database. Starting one costs the same however many
+          * indices there are, indices only join it when they are changed.
+          */
          struct session {
             public:
                session( session&& s )
-                  :_index_sessions( std::move(s._index_sessions) ), _revision( s._revision ), _session_signal( s._session_signal )
+                  :_db( s._db ), _revision( s._revision ), _session_signal( s._session_signal )
                {
+                  s._db = nullptr;
                }
-               session( vector<std::unique_ptr<abstract_session>>&& s, std::shared_ptr< session_signal > sig )
-                  :_index_sessions( std::move(s) ), _session_signal( sig )
+               session( database& db, int64_t revision, std::shared_ptr< session_signal > sig )
+                  :_db( &db ), _revision( revision ), _session_signal( sig )
                {
-                  if( _index_sessions.size() )
-                     _revision = _index_sessions[0]->revision();
-                     
                   _session_signal->notify_on_start_session( _revision );
                }
 
@@ -714,24 +872,25 @@ namespace chainbase {
                   undo();
                }
 
+               /** leaves the UNDO state on the stack when session goes out of scope */
                void push()
                {
-                  for( auto& i : _index_sessions ) i->push();
-                  _index_sessions.clear();
+                  _db = nullptr;
                   if( _session_signal ) _session_signal->notify_on_push_session( _revision );
                }
 
+               /** combines this session with the prior session */
                void squash()
                {
-                  for( auto& i : _index_sessions ) i->squash();
-                  _index_sessions.clear();
+                  if( _db ) _db->squash_head();
+                  _db = nullptr;
                   if( _session_signal ) _session_signal->notify_on_squash_session( _revision );
                }
 
                void undo()
                {
-                  for( auto& i : _index_sessions ) i->undo();
-                  _index_sessions.clear();
+                  if( _db ) _db->undo_head();
+                  _db = nullptr;
                   if( _session_signal ) _session_signal->notify_on_undo_session( _revision );
                }
 
@@ -741,7 +900,7 @@ namespace chainbase {
                friend class database;
                session() {}
 
-               vector< std::unique_ptr<abstract_session> > _index_sessions;
+               database* _db = nullptr;
                int64_t _revision = -1;
                std::shared_ptr< session_signal > _session_signal;
          };
@@ -749,8 +908,8 @@ namespace chainbase {
          session start_undo_session( bool enabled );
 
          int64_t revision()const {
-             if( _index_list.size() == 0 ) return -1;
-             return _index_list[0]->revision();
+             if( !_undo_context ) return -1;
+             return _undo_context->revision;
          }
 
          void undo();
@@ -759,11 +918,7 @@ namespace chainbase {
          void undo_all();
 
 
-         void set_revision( int64_t revision )
-         {
-             CHAINBASE_REQUIRE_WRITE_LOCK( "set_revision", int64_t );
-             for( auto i : _index_list ) i->set_revision( revision );
-         }
+         void set_revision( int64_t revision );
 
 
          template<typename MultiIndexType>
@@ -780,7 +935,7 @@ namespace chainbase {
 
              index_type* idx_ptr =  nullptr;
              if( !_read_only ) {
-                idx_ptr = _segment->find_or_construct< index_type >( type_name.c_str() )( index_alloc( _segment->get_segment_manager() ) );
+                idx_ptr = _segment->find_or_construct< index_type >( type_name.c_str() )( index_alloc( _segment->get_segment_manager() ), _undo_context );
              } else {
                 idx_ptr = _segment->find< index_type >( type_name.c_str() ).first;
                 if( !idx_ptr ) BOOST_THROW_EXCEPTION( std::runtime_error( "unable to find index for " + type_name + " in read only database" ) );
@@ -958,9 +1113,51 @@ namespace chainbase {
                   BOOST_THROW_EXCEPTION( std::runtime_error( "unable to acquire lock" ) );
             }
 
+            // A lock taken just before a writer moved to a new one can be held while grow() remaps the segment
+            atomic_incrementer reading( _active_readers );
+            while( BOOST_UNLIKELY( _remapping.load() ) )
+            {
+               --_active_readers;
+               boost::this_thread::sleep_for( boost::chrono::milliseconds( 1 ) );
+               ++_active_readers;
+            }
+
             return callback();
          }
 
+         /**
+          * with_read_lock for a reader on another thread than the writer's. A writer that times out on
+          * the lock moves to a new lock past the readers holding it, so a read that outlasts the writer's
+          * wait may see a block half written. A strict read fails instead of returning such a result:
+          * it throws when the writer moved to a new lock while it read.
+          */
+         template< typename Lambda >
+         auto with_strict_read_lock( Lambda&& callback, uint64_t wait_micro = 1000000 )
+            -> typename std::enable_if< !std::is_void< decltype( (*(Lambda*)nullptr)() ) >::value,
+                                        typename std::decay< decltype( (*(Lambda*)nullptr)() ) >::type >::type
+         {
+            typedef typename std::decay< decltype( (*(Lambda*)nullptr)() ) >::type result_type;
+            const uint64_t moves = _lock_moves.load();
+            return with_read_lock( [&]() -> result_type
+            {
+               result_type result = callback();
+               check_lock_not_moved( moves );
+               return result;
+            }, wait_micro );
+         }
+
+         template< typename Lambda >
+         auto with_strict_read_lock( Lambda&& callback, uint64_t wait_micro = 1000000 )
+            -> typename std::enable_if< std::is_void< decltype( (*(Lambda*)nullptr)() ) >::value >::type
+         {
+            const uint64_t moves = _lock_moves.load();
+            with_read_lock( [&]()
+            {
+               callback();
+               check_lock_not_moved( moves );
+            }, wait_micro );
+         }
+
          template< typename Lambda >
          auto with_write_lock( Lambda&& callback, uint64_t wait_micro = 1000000 ) -> decltype( (*(Lambda*)nullptr)() )
          {
@@ -982,6 +1179,7 @@ namespace chainbase {
                while( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
                {
                   _rw_manager->next_lock();
+                  ++_lock_moves;
                   std::cerr << "Lock timeout, moving to lock " << _rw_manager->current_lock_num() << std::endl;
                   lock = write_lock( _rw_manager->current_lock(), boost::defer_lock_t() );
                }
@@ -1007,14 +1205,34 @@ namespace chainbase {
          std::shared_ptr< session_signal > get_session_signal() { return _session_signal; }
 
       private:
+         /** Undo the changes of the head revision and move the revision back */
+         void undo_head();
+
+         /** Merge the changes of the head revision into the revision before it */
+         void squash_head();
+
+         abstract_index* find_index( uint16_t type_id )const;
+
+         void apply_mapping_options();
+
+         void check_lock_not_moved( uint64_t moves )const
+         {
+            if( _lock_moves.load() != moves )
+               BOOST_THROW_EXCEPTION( std::runtime_error( "read outlasted the writer's lock wait and was cancelled" ) );
+         }
+
          unique_ptr<bip::managed_mapped_file>                        _segment;
          unique_ptr<bip::managed_mapped_file>                        _meta;
          read_write_mutex_manager*                                   _rw_manager = nullptr;
          bool                                                        _read_only = false;
          bip::file_lock                                              _flock;
+         undo_context*                                               _undo_context = nullptr;
+         mapping_options                                             _mapping_options;
+         int                                                         _dtlb_counter_fd = -1;
+         bool                                                        _dtlb_counter_opened = false;
 
          /**
-          * This is a sparse list of known indicies kept to accelerate creation of undo sessions
+          * This is a sparse list of known indicies
           */
          vector<abstract_index*>                                     _index_list;
 
@@ -1029,6 +1247,13 @@ namespace chainbase {
          int32_t                                                     _write_lock_count = 0;
          bool                                                        _enable_require_locking = false;
          std::shared_ptr< session_signal >                           _session_signal;
+
+         /// Readers of this process holding a lock, grow() waits for them
+         std::atomic< uint32_t >                                     _active_readers{ 0 };
+
+         /// Times a writer moved to a new lock past readers, with_strict_read_lock fails reads that span a move
+         std::atomic< uint64_t >                                     _lock_moves{ 0 };
+         std::atomic< bool >                                         _remapping{ false };
    };
 
    template<typename Object, typename... Args>
@@ -1,8 +1,23 @@
 #include <chainbase/chainbase.hpp>
 #include <boost/array.hpp>
 
+#include <cstdlib>
 #include <iostream>
 
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#ifndef HUGETLBFS_MAGIC
+#define HUGETLBFS_MAGIC 0x958458f6
+#endif
+#endif
+
 namespace chainbase {
    struct environment_check {
       environment_check() {
@@ -49,6 +64,20 @@ namespace chainbase {
       bfs::create_directories( dir );
       if( _data_dir != dir ) close();
 
+      if( _mapping_options.huge_pages == mapping_options::hugetlbfs ) {
+#ifdef __linux__
+         struct statfs fs;
+         if( statfs( dir.generic_string().c_str(), &fs ) != 0 || fs.f_type != HUGETLBFS_MAGIC )
+            BOOST_THROW_EXCEPTION( std::runtime_error( dir.generic_string() + " is not on a hugetlbfs mount" ) );
+
+         // A file on hugetlbfs can only be sized and mapped in whole huge pages
+         uint64_t huge_page_size = fs.f_bsize;
+         shared_file_size = ( shared_file_size + huge_page_size - 1 ) / huge_page_size * huge_page_size;
+#else
+         BOOST_THROW_EXCEPTION( std::runtime_error( "hugetlbfs is only supported on Linux" ) );
+#endif
+      }
+
       _data_dir = dir;
       auto abs_path = bfs::absolute( dir / "shared_memory.bin" );
 
@@ -77,11 +106,17 @@ namespace chainbase {
          if( !env.first || !( *env.first == environment_check()) ) {
             BOOST_THROW_EXCEPTION( std::runtime_error( "database created by a different compiler, build, or operating system" ) );
          }
+
+         _undo_context = _segment->find< undo_context >( "undo_context" ).first;
+         if( !_undo_context || _undo_context->version != undo_context::current_version ) {
+            BOOST_THROW_EXCEPTION( std::runtime_error( "database created by a different version of chainbase" ) );
+         }
       } else {
          _segment.reset( new bip::managed_mapped_file( bip::create_only,
                                                        abs_path.generic_string().c_str(), shared_file_size
                                                        ) );
          _segment->find_or_construct< environment_check >( "environment" )();
+         _undo_context = _segment->find_or_construct< undo_context >( "undo_context" )( allocator< undo_context >( _segment->get_segment_manager() ) );
       }
 
 
@@ -111,6 +146,212 @@ namespace chainbase {
          if( !_flock.try_lock() )
             BOOST_THROW_EXCEPTION( std::runtime_error( "could not gain write access to the shared memory file" ) );
       }
+
+      apply_mapping_options();
+   }
+
+   bool database::grow( uint64_t extra, uint64_t wait_micro )
+   {
+      CHAINBASE_REQUIRE_WRITE_LOCK( "grow", uint64_t );
+      if( _read_only ) BOOST_THROW_EXCEPTION( std::logic_error( "cannot grow a read only database" ) );
+
+      auto abs_path = bfs::absolute( _data_dir / "shared_memory.bin" );
+
+#ifdef __linux__
+      if( _mapping_options.huge_pages == mapping_options::hugetlbfs ) {
+         struct statfs fs;
+         if( statfs( _data_dir.generic_string().c_str(), &fs ) == 0 && fs.f_bsize > 0 )
+            extra = ( extra + fs.f_bsize - 1 ) / fs.f_bsize * fs.f_bsize;
+      }
+#endif
+
+      // The write lock keeps new readers out, but readers a writer moved past may still be reading
+      _remapping = true;
+      auto deadline = boost::chrono::steady_clock::now() + boost::chrono::microseconds( wait_micro );
+      while( _active_readers.load() ) {
+         if( boost::chrono::steady_clock::now() >= deadline ) {
+            _remapping = false;
+            return false;
+         }
+         boost::this_thread::sleep_for( boost::chrono::milliseconds( 1 ) );
+      }
+
+      // Pointers into the segment held by this process, as offsets from its start
+      const char* old_base = static_cast< const char* >( _segment->get_address() );
+      std::ptrdiff_t undo_context_offset = reinterpret_cast< const char* >( _undo_context ) - old_base;
+      vector< std::ptrdiff_t > index_offsets( _index_map.size(), 0 );
+      for( size_t i = 0; i < _index_map.size(); ++i ) {
+         if( _index_map[i] )
+            index_offsets[i] = static_cast< const char* >( _index_map[i]->get() ) - old_base;
+      }
+
+      // Not flushed: unmapping a shared mapping leaves its dirty pages in the page cache, so msyncing the whole
+      // file here would only stall the writer for the writeback
+      _segment.reset();
+
+      bool grown = bip::managed_mapped_file::grow( abs_path.generic_string().c_str(), extra );
+
+      // Mapped again whether or not growing it worked, so the database stays usable
+      try {
+         _segment.reset( new bip::managed_mapped_file( bip::open_only, abs_path.generic_string().c_str() ) );
+      } catch( const std::exception& e ) {
+         // The indices and the undo context all point into the segment, there is no usable state to go back to
+         std::cerr << "Unable to map the shared memory file again after growing it, exiting: " << e.what() << std::endl;
+         std::abort();
+      }
+
+      char* new_base = static_cast< char* >( _segment->get_address() );
+      _undo_context = reinterpret_cast< undo_context* >( new_base + undo_context_offset );
+      for( size_t i = 0; i < _index_map.size(); ++i ) {
+         if( _index_map[i] )
+            _index_map[i]->rebind( new_base + index_offsets[i] );
+      }
+
+      apply_mapping_options();
+      _remapping = false;
+
+      if( !grown )
+         BOOST_THROW_EXCEPTION( std::runtime_error( "could not grow database file by " + std::to_string( extra ) + " bytes" ) );
+      return true;
+   }
+
+#ifdef __linux__
+   namespace {
+      const unsigned long max_numa_nodes = 1024;
+      const size_t numa_mask_bits = 8 * sizeof( unsigned long );
+      typedef std::array< unsigned long, max_numa_nodes / numa_mask_bits > numa_node_mask;
+
+      /** Switches the calling thread to a NUMA policy and back, so pages it faults in are placed by it */
+      class scoped_thread_numa_policy
+      {
+         public:
+            scoped_thread_numa_policy( int mode, const numa_node_mask& nodes )
+            {
+               _saved = syscall( __NR_get_mempolicy, &_old_mode, _old_nodes.data(), max_numa_nodes, nullptr, 0 ) == 0;
+               if( _saved && syscall( __NR_set_mempolicy, mode, nodes.data(), max_numa_nodes + 1 ) != 0 ) {
+                  std::cerr << "Unable to set the NUMA policy for faulting in the shared memory file: " << strerror( errno ) << std::endl;
+                  _saved = false;
+               }
+            }
+
+            ~scoped_thread_numa_policy()
+            {
+               if( _saved )
+                  syscall( __NR_set_mempolicy, _old_mode, _old_nodes.data(), max_numa_nodes + 1 );
+            }
+
+         private:
+            int            _old_mode = MPOL_DEFAULT;
+            numa_node_mask _old_nodes = {};
+            bool           _saved = false;
+      };
+   }
+#endif
+
+   void database::apply_mapping_options()
+   {
+#ifdef __linux__
+      char* base = static_cast< char* >( _segment->get_address() );
+      size_t size = _segment->get_size();
+      size_t page_size = sysconf( _SC_PAGESIZE );
+
+      int numa_policy = MPOL_DEFAULT;
+      numa_node_mask numa_nodes = {};
+      if( _mapping_options.numa != mapping_options::numa_default ) {
+         numa_policy = _mapping_options.numa == mapping_options::numa_interleave ? MPOL_INTERLEAVE : MPOL_BIND;
+         if( _mapping_options.numa_nodes.empty() ) {
+            if( syscall( __NR_get_mempolicy, nullptr, numa_nodes.data(), max_numa_nodes, nullptr, MPOL_F_MEMS_ALLOWED ) != 0 )
+               std::cerr << "Unable to find the NUMA nodes of this process: " << strerror( errno ) << std::endl;
+         } else {
+            for( uint32_t node : _mapping_options.numa_nodes ) {
+               if( node < max_numa_nodes )
+                  numa_nodes[ node / numa_mask_bits ] |= 1UL << ( node % numa_mask_bits );
+               else
+                  std::cerr << "Ignoring NUMA node " << node << " of the shared memory file, nodes go up to " << max_numa_nodes - 1 << std::endl;
+            }
+         }
+
+         // Pages already in memory are moved when the kernel can, the rest are placed as they are faulted in
+         if( syscall( __NR_mbind, base, size, numa_policy, numa_nodes.data(), max_numa_nodes + 1, MPOL_MF_MOVE ) != 0 )
+            std::cerr << "Unable to set the NUMA policy of the shared memory file: " << strerror( errno ) << std::endl;
+      }
+
+      if( _mapping_options.huge_pages == mapping_options::transparent_huge_pages ) {
+#ifdef MADV_HUGEPAGE
+         if( madvise( base, size, MADV_HUGEPAGE ) != 0 )
+            std::cerr << "Unable to enable transparent huge pages for the shared memory file: " << strerror( errno ) << std::endl;
+#else
+         std::cerr << "Transparent huge pages are not supported by this kernel" << std::endl;
+#endif
+      }
+
+      if( _mapping_options.warm_up ) {
+         if( madvise( base, size, MADV_WILLNEED ) != 0 )
+            std::cerr << "Unable to warm up the shared memory file: " << strerror( errno ) << std::endl;
+      }
+
+      // The allocator hands out free blocks from anywhere in the segment, not only past the used ones,
+      // so there is no used prefix of the file and both options cover all of it
+      if( _mapping_options.prefault ) {
+         std::unique_ptr< scoped_thread_numa_policy > thread_policy;
+         if( numa_policy != MPOL_DEFAULT )
+            thread_policy.reset( new scoped_thread_numa_policy( numa_policy, numa_nodes ) );
+
+         bool populated = false;
+#ifdef MADV_POPULATE_READ
+         // Faulting the pages in writable would dirty every page of the file, so they are only read in
+         populated = madvise( base, size, MADV_POPULATE_READ ) == 0;
+#endif
+         if( !populated ) {
+            volatile char sum = 0;
+            for( size_t offset = 0; offset < size; offset += page_size )
+               sum += base[ offset ];
+         }
+      }
+
+      if( _mapping_options.lock ) {
+         if( mlock( base, size ) != 0 )
+            std::cerr << "Unable to lock " << size << " bytes of the shared memory file in memory, check the memlock limit: " << strerror( errno ) << std::endl;
+      }
+#else
+      if( _mapping_options.huge_pages != mapping_options::no_huge_pages || _mapping_options.numa != mapping_options::numa_default
+          || _mapping_options.warm_up || _mapping_options.prefault || _mapping_options.lock )
+         std::cerr << "Shared memory file mapping options are only supported on Linux and are ignored" << std::endl;
+#endif
+   }
+
+   mapping_stats database::get_mapping_stats()
+   {
+      mapping_stats stats;
+#ifdef __linux__
+      struct rusage usage;
+      if( getrusage( RUSAGE_THREAD, &usage ) == 0 ) {
+         stats.minor_faults = usage.ru_minflt;
+         stats.major_faults = usage.ru_majflt;
+      }
+
+      if( !_dtlb_counter_opened ) {
+         _dtlb_counter_opened = true;
+
+         struct perf_event_attr attr;
+         memset( &attr, 0, sizeof( attr ) );
+         attr.size = sizeof( attr );
+         attr.type = PERF_TYPE_HW_CACHE;
+         attr.config = PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+         attr.exclude_kernel = 1;
+         attr.exclude_hv = 1;
+
+         // Counts the calling thread on any CPU
+         _dtlb_counter_fd = syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+      }
+
+      uint64_t misses = 0;
+      if( _dtlb_counter_fd >= 0 && read( _dtlb_counter_fd, &misses, sizeof( misses ) ) == sizeof( misses ) ) {
+         stats.dtlb_misses = misses;
+         stats.dtlb_available = true;
+      }
+#endif
+      return stats;
    }
 
    void database::flush() {
@@ -120,8 +361,17 @@ namespace chainbase {
          _meta->flush();
    }
 
+   database::~database()
+   {
+#ifdef __linux__
+      if( _dtlb_counter_fd >= 0 )
+         ::close( _dtlb_counter_fd );
+#endif
+   }
+
    void database::close()
    {
+      _undo_context = nullptr;
       _segment.reset();
       _meta.reset();
       _data_dir = bfs::path();
@@ -129,6 +379,7 @@ namespace chainbase {
 
    void database::wipe( const bfs::path& dir )
    {
+      _undo_context = nullptr;
       _segment.reset();
       _meta.reset();
       bfs::remove_all( dir / "shared_memory.bin" );
@@ -154,51 +405,102 @@ namespace chainbase {
    }
 #endif
 
-   void database::undo()
+   void database::set_revision( int64_t revision )
    {
-      for( auto& item : _index_list )
+      CHAINBASE_REQUIRE_WRITE_LOCK( "set_revision", int64_t );
+      if( _undo_context->touched.size() ) BOOST_THROW_EXCEPTION( std::logic_error("cannot set revision while there is an existing undo stack") );
+      _undo_context->revision = revision;
+      _undo_context->committed_revision = revision;
+   }
+
+   abstract_index* database::find_index( uint16_t type_id )const
+   {
+      // An index that was not added this time, by a plugin that is no longer enabled, keeps its undo states
+      return type_id < _index_map.size() ? _index_map[ type_id ].get() : nullptr;
+   }
+
+   void database::undo_head()
+   {
+      if( !_undo_context->enabled() ) return;
+
+      auto& touched = _undo_context->touched;
+      while( touched.size() && touched.back().revision == _undo_context->revision )
       {
-         item->undo();
+         if( auto idx = find_index( touched.back().type_id ) ) idx->undo();
+         touched.pop_back();
       }
-      _session_signal->notify_on_undo_session( ALL_SESSION_CODE );
+
+      --_undo_context->revision;
    }
 
-   void database::squash()
+   void database::squash_head()
    {
-      for( auto& item : _index_list )
+      if( !_undo_context->enabled() ) return;
+
+      auto& touched = _undo_context->touched;
+      const int64_t head = _undo_context->revision;
+
+      size_t first = touched.size();
+      while( first > 0 && touched[ first - 1 ].revision == head )
+         --first;
+
+      // Indices that kept their changes as the undo state of the previous revision stay listed under it
+      size_t kept = first;
+      for( size_t i = first; i < touched.size(); ++i )
       {
-         item->squash();
+         auto idx = find_index( touched[i].type_id );
+         if( idx && idx->squash() )
+         {
+            touched[ kept ] = touched[i];
+            touched[ kept ].revision = head - 1;
+            ++kept;
+         }
       }
+      touched.erase( touched.begin() + kept, touched.end() );
+
+      // Squashing the only revision that can be undone makes its changes permanent
+      if( head - 1 <= _undo_context->committed_revision )
+         _undo_context->committed_revision = head;
+      else
+         --_undo_context->revision;
+   }
+
+   void database::undo()
+   {
+      undo_head();
+      _session_signal->notify_on_undo_session( ALL_SESSION_CODE );
+   }
+
+   void database::squash()
+   {
+      squash_head();
       _session_signal->notify_on_squash_session( ALL_SESSION_CODE );
    }
 
    void database::commit( int64_t revision )
    {
-      for( auto& item : _index_list )
+      auto& touched = _undo_context->touched;
+      while( touched.size() && touched.front().revision <= revision )
       {
-         item->commit( revision );
+         if( auto idx = find_index( touched.front().type_id ) ) idx->commit( revision );
+         touched.pop_front();
       }
+
+      _undo_context->committed_revision = std::max( _undo_context->committed_revision, std::min( revision, _undo_context->revision ) );
       _session_signal->notify_on_commit_session( revision );
    }
 
    void database::undo_all()
    {
-      for( auto& item : _index_list )
-      {
-         item->undo_all();
-      }
+      while( _undo_context->enabled() )
+         undo_head();
       _session_signal->notify_on_undo_session( ALL_SESSION_CODE );
    }
 
    database::session database::start_undo_session( bool enabled )
    {
       if( enabled ) {
-         vector< std::unique_ptr<abstract_session> > _sub_sessions;
-         _sub_sessions.reserve( _index_list.size() );
-         for( auto& item : _index_list ) {
-            _sub_sessions.push_back( item->start_undo_session( enabled ) );
-         }
-         return session( std::move( _sub_sessions ), _session_signal );
+         return session( *this, ++_undo_context->revision, _session_signal );
       } else {
          return session();
       }
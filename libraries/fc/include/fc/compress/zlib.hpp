@@ -2,9 +2,19 @@
 
 #include <fc/string.hpp>
 
+#include <vector>
+
 namespace fc 
 {
 
   string zlib_compress(const string& in);
 
+  std::vector<char> zlib_compress(const char* in, size_t in_size);
+
+  /**
+   *  Inflates data written by zlib_compress.  Throws if the data is corrupt or
+   *  inflates to more than max_size bytes.
+   */
+  std::vector<char> zlib_decompress(const char* in, size_t in_size, size_t max_size);
+
 } // namespace fc
@@ -1,4 +1,5 @@
 #include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
 
 #include "miniz.c"
 
@@ -12,4 +13,23 @@ namespace fc
     free(compressed_message);
     return result;
   }
+
+  std::vector<char> zlib_compress(const char* in, size_t in_size)
+  {
+    size_t compressed_length;
+    char* compressed = (char*)tdefl_compress_mem_to_heap(in, in_size, &compressed_length, TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES);
+    FC_ASSERT( compressed, "unable to compress ${size} bytes", ("size", in_size) );
+    std::vector<char> result(compressed, compressed + compressed_length);
+    free(compressed);
+    return result;
+  }
+
+  std::vector<char> zlib_decompress(const char* in, size_t in_size, size_t max_size)
+  {
+    std::vector<char> result(max_size);
+    size_t length = tinfl_decompress_mem_to_mem(result.data(), result.size(), in, in_size, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    FC_ASSERT( length != TINFL_DECOMPRESS_MEM_TO_MEM_FAILED, "corrupt compressed data or more than ${max} bytes after decompression", ("max", max_size) );
+    result.resize(length);
+    return result;
+  }
 }
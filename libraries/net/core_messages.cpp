@@ -23,6 +23,8 @@
  */
 #include <graphene/net/core_messages.hpp>
 
+#include <fc/compress/zlib.hpp>
+
 
 namespace graphene { namespace net {
 
@@ -45,6 +47,39 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum compressed_message::type                      = core_message_type_enum::compressed_message_type;
+
+  compressed_message::compressed_message(const message& message_to_compress) :
+    msg_type(message_to_compress.msg_type),
+    uncompressed_size((uint32_t)message_to_compress.data.size()),
+    data(fc::zlib_compress(message_to_compress.data.data(), message_to_compress.data.size()))
+  {}
+
+  message compressed_message::decompress() const
+  {
+    FC_ASSERT(msg_type != compressed_message_type, "compressed messages can not be nested");
+    FC_ASSERT(uncompressed_size <= MAX_MESSAGE_SIZE, "compressed message would be ${size} bytes", ("size", uncompressed_size));
+
+    message result;
+    result.msg_type = msg_type;
+    result.data = fc::zlib_decompress(data.data(), data.size(), uncompressed_size);
+    FC_ASSERT(result.data.size() == uncompressed_size, "compressed message is ${actual} bytes instead of ${size}",
+              ("actual", result.data.size())("size", uncompressed_size));
+    result.size = (uint32_t)result.data.size();
+    return result;
+  }
+
+  message compress_if_worthwhile(const message& message_to_send)
+  {
+    if ((message_to_send.msg_type == block_message_type || message_to_send.msg_type == trx_message_type) &&
+        message_to_send.data.size() >= GRAPHENE_NET_MIN_COMPRESSED_MESSAGE_SIZE)
+    {
+      compressed_message compressed(message_to_send);
+      if (compressed.data.size() < message_to_send.data.size())
+        return message(compressed);
+    }
+    return message_to_send;
+  }
 
 } } // graphene::net
 
@@ -102,3 +102,9 @@
 #define GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
 
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
+
+/**
+ * Block and transaction messages smaller than this are sent uncompressed even
+ * to peers that accept compressed messages, it isn't worth the cpu time
+ */
+#define GRAPHENE_NET_MIN_COMPRESSED_MESSAGE_SIZE             512
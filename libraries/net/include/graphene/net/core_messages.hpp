@@ -25,6 +25,7 @@
 
 #include <graphene/net/config.hpp>
 #include <sigmaengine/protocol/block.hpp>
+#include <graphene/net/message.hpp>
 
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/crypto/elliptic.hpp>
@@ -86,6 +87,7 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compressed_message_type                      = 5018,
     core_message_type_last                       = 5099
   };
 
@@ -397,6 +399,33 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /**
+   * Another message with its data zlib compressed.  Only sent to peers that announced
+   * "compression" in the user data of their hello message, and only for the block and
+   * transaction messages that make up most of the traffic.
+   */
+  struct compressed_message
+  {
+    static const core_message_type_enum type;
+
+    uint32_t          msg_type = 0;           ///< type of the wrapped message
+    uint32_t          uncompressed_size = 0;  ///< size of the wrapped message's data
+    std::vector<char> data;
+
+    compressed_message() {}
+    explicit compressed_message(const message& message_to_compress);
+
+    /** returns the wrapped message, throws if it is corrupt or larger than MAX_MESSAGE_SIZE */
+    message decompress() const;
+  };
+
+  /**
+   * Returns a block or transaction message as a compressed_message when that makes it smaller,
+   * any other message is returned as it is.  Callers cache the result so a message going out
+   * to many peers is only compressed once.
+   */
+  message compress_if_worthwhile(const message& message_to_send);
+
 
 } } // graphene::net
 
@@ -421,6 +450,7 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compressed_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -504,6 +534,9 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT(graphene::net::compressed_message, (msg_type)
+                                         (uncompressed_size)
+                                         (data))
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
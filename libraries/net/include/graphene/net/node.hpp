@@ -114,6 +114,13 @@ namespace graphene { namespace net {
           */
          virtual message get_item( const item_id& id ) = 0;
 
+         /**
+          *  Same as get_item(), but the block or transaction comes back as a compressed_message
+          *  when that is smaller.  Implementations should cache the result, every peer that
+          *  accepts compressed messages asks for the same items.
+          */
+         virtual message get_compressed_item( const item_id& id ) = 0;
+
          /**
           * Returns a synopsis of the blockchain used for syncing.
           * This consists of a list of selected item hashes from our current preferred
@@ -150,6 +157,13 @@ namespace graphene { namespace net {
 
          virtual uint32_t get_block_number(const item_hash_t& block_id) = 0;
 
+         /**
+          *  Called as soon as a block is received during sync, before the blocks in front of it
+          *  have been handed to handle_block(). The client may start checking it in the background.
+          *  Must not block.
+          */
+         virtual void     prevalidate_sync_block( const graphene::net::block_message& block_message ) {}
+
          /**
           * Returns the time a block was produced (if block_id = 0, returns genesis time).
           * If we don't know about the block, returns time_point_sec::min()
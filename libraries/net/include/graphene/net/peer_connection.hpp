@@ -69,6 +69,8 @@ namespace graphene { namespace net
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
       virtual message get_message_for_item(const item_id& item) = 0;
+      /** same as get_message_for_item(), but compressed when worthwhile; compressed once and shared by all peers */
+      virtual message get_compressed_message_for_item(const item_id& item) = 0;
     };
 
     class peer_connection;
@@ -151,14 +153,17 @@ namespace graphene { namespace net
 
       /* when you queue up a 'virtual_queued_message', we just queue up the hash of the
        * item we want to send.  When it reaches the top of the queue, we make a callback
-       * to the node to generate the message.
+       * to the node to generate the message, or fetch its shared compressed form if
+       * the peer accepts compressed messages.
        */
       struct virtual_queued_message : queued_message
       {
         item_id item_to_send;
+        bool    compressed;
 
-        virtual_queued_message(item_id item_to_send) :
-          item_to_send(std::move(item_to_send))
+        virtual_queued_message(item_id item_to_send, bool compressed = false) :
+          item_to_send(std::move(item_to_send)),
+          compressed(compressed)
         {}
 
         message get_message(peer_connection_delegate* node) override;
@@ -204,6 +209,7 @@ namespace graphene { namespace net
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
       fc::optional<sigmaengine::protocol::chain_id_type> chain_id;
+      bool accepts_compressed_messages = false; /// the peer announced compression in its hello and we have it enabled
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
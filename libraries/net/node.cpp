@@ -139,6 +139,9 @@ namespace graphene { namespace net {
         message_propagation_data propagation_data;
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
+        // what we send to peers that accept compressed messages, built the first time one of them asks
+        mutable fc::optional<message> compressed_message_body;
+
         message_info( const message_hash_type& message_hash,
                       const message&           message_body,
                       uint32_t                 block_clock_when_received,
@@ -173,6 +176,7 @@ namespace graphene { namespace net {
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
       message get_message( const message_hash_type& hash_of_message_to_lookup );
+      message get_compressed_message( const message_hash_type& hash_of_message_to_lookup );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
     };
@@ -206,6 +210,19 @@ namespace graphene { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    message blockchain_tied_message_cache::get_compressed_message( const message_hash_type& hash_of_message_to_lookup )
+    {
+      message_cache_container::index<message_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+      if( iter != _message_cache.get<message_hash_index>().end() )
+      {
+        if( !iter->compressed_message_body )
+          iter->compressed_message_body = compress_if_worthwhile( iter->message_body );
+        return *iter->compressed_message_body;
+      }
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+    }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
     {
       if( hash_of_message_contents_to_lookup != fc::uint160_t() )
@@ -288,6 +305,7 @@ namespace graphene { namespace net { namespace detail {
                                    (handle_transaction) \
                                    (get_block_ids) \
                                    (get_item) \
+                                   (get_compressed_item) \
                                    (get_blockchain_synopsis) \
                                    (sync_status) \
                                    (connection_count_changed) \
@@ -383,11 +401,13 @@ namespace graphene { namespace net { namespace detail {
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 2000) override;
       message get_item( const item_id& id ) override;
+      message get_compressed_item( const item_id& id ) override;
       std::vector<item_hash_t> get_blockchain_synopsis(const item_hash_t& reference_point,
                                                        uint32_t number_of_blocks_after_reference_point) override;
       void     sync_status( uint32_t item_type, uint32_t item_count ) override;
       void     connection_count_changed( uint32_t c ) override;
       uint32_t get_block_number(const item_hash_t& block_id) override;
+      void     prevalidate_sync_block( const graphene::net::block_message& block_message ) override;
       fc::time_point_sec get_block_time(const item_hash_t& block_id) override;
       fc::time_point_sec get_blockchain_now() override;
       item_hash_t get_head_block_id() const override;
@@ -439,8 +459,9 @@ namespace graphene { namespace net { namespace detail {
       typedef std::unordered_map<graphene::net::block_id_type, fc::time_point> active_sync_requests_map;
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
-      std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
-      std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      /// sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain.
+      /// block ids start with the big-endian block number, so the map is ordered by block number
+      std::map<item_hash_t, graphene::net::block_message> _received_sync_items;
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -566,6 +587,7 @@ namespace graphene { namespace net { namespace detail {
       unsigned _maximum_number_of_blocks_to_handle_at_one_time;
       unsigned _maximum_number_of_sync_blocks_to_prefetch;
       unsigned _maximum_blocks_per_peer_during_syncing;
+      bool _message_compression_enabled; /// whether we announce and use compressed block and transaction messages
 
       std::list<fc::future<void> > _handle_message_calls_in_progress;
       std::set<message_hash_type> _message_ids_currently_being_processed;
@@ -743,6 +765,7 @@ namespace graphene { namespace net { namespace detail {
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
       message                    get_message_for_item(const item_id& item) override;
+      message                    get_compressed_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
@@ -816,7 +839,8 @@ namespace graphene { namespace net { namespace detail {
       _node_is_shutting_down(false),
       _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME),
       _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH),
-      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING),
+      _message_compression_enabled(true)
     {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_bytes(&_node_id.data[0], (int)_node_id.size());
@@ -985,10 +1009,7 @@ namespace graphene { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
-             std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+      return _received_sync_items.find(item_hash) != _received_sync_items.end();
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -1811,6 +1832,9 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::block_message_type:
         process_block_message(originating_peer, received_message, message_hash);
         break;
+      case core_message_type_enum::compressed_message_type:
+        on_message(originating_peer, received_message.as<compressed_message>().decompress());
+        break;
       case core_message_type_enum::current_time_request_message_type:
         on_current_time_request_message(originating_peer, received_message.as<current_time_request_message>());
         break;
@@ -1871,6 +1895,8 @@ namespace graphene { namespace net { namespace detail {
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
       user_data["chain_id"] = SIGMAENGINE_CHAIN_ID;
+      if (_message_compression_enabled)
+        user_data["compression"] = "zlib";
 
       return user_data;
     }
@@ -1888,6 +1914,8 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
       if (user_data.contains("chain_id"))
         originating_peer->chain_id = user_data["chain_id"].as<sigmaengine::protocol::chain_id_type>();
+      if (user_data.contains("compression"))
+        originating_peer->accepts_compressed_messages = _message_compression_enabled && user_data["compression"].as_string() == "zlib";
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2744,6 +2772,23 @@ namespace graphene { namespace net { namespace detail {
       return item_not_available_message(item);
     }
 
+    message node_impl::get_compressed_message_for_item(const item_id& item)
+    {
+      try
+      {
+        return _message_cache.get_compressed_message(item.item_hash);
+      }
+      catch (fc::key_not_found_exception&)
+      {}
+      try
+      {
+        return _delegate->get_compressed_item(item);
+      }
+      catch (fc::key_not_found_exception&)
+      {}
+      return item_not_available_message(item);
+    }
+
     void node_impl::on_fetch_items_message(peer_connection* originating_peer, const fetch_items_message& fetch_items_message_received)
     {
       VERIFY_CORRECT_THREAD();
@@ -2806,6 +2851,8 @@ namespace graphene { namespace net { namespace detail {
       {
         if (reply.msg_type == block_message_type)
           originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        else if (reply.msg_type == trx_message_type && originating_peer->accepts_compressed_messages)
+          originating_peer->send_message(get_compressed_message_for_item(item_id(trx_message_type, reply.id())));
         else
           originating_peer->send_message(reply);
       }
@@ -3267,34 +3314,41 @@ namespace graphene { namespace net { namespace detail {
 
       do
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
         dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
 
         block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
+
+        // the next block on the active chain or one of the forks is at the front of some peer's list
+        // of items to get, so look those up rather than testing every received block against every peer
+        auto received_block_iter = _received_sync_items.end();
+        for (const peer_connection_ptr& peer : _active_connections)
         {
+          ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+          if (!peer->ids_of_items_to_get.empty())
+          {
+            received_block_iter = _received_sync_items.find(peer->ids_of_items_to_get.front());
+            if (received_block_iter != _received_sync_items.end())
+              break;
+          }
+        }
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
+        if (received_block_iter != _received_sync_items.end())
+        {
+          const item_hash_t received_block_id = received_block_iter->first;
+
+          // remove it from all sync peers lists
           for (const peer_connection_ptr& peer : _active_connections)
           {
             ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
             if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                peer->ids_of_items_to_get.front() == received_block_id)
             {
-              potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+              peer->ids_of_items_being_processed.insert(received_block_id);
             }
           }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
+          // and process it
           {
             // we can get into an interesting situation near the end of synchronization.  We can be in
             // sync with one peer who is sending us the last block on the chain via a regular inventory
@@ -3303,9 +3357,9 @@ namespace graphene { namespace net { namespace detail {
             // we don't know they're the same (for the peer in normal operation, it has only told us the
             // message id, for the peer in the sync case we only known the block_id).
             if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
+                          received_block_id) == _most_recent_blocks_accepted.end())
             {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
+              graphene::net::block_message block_message_to_process = std::move(received_block_iter->second);
               _received_sync_items.erase(received_block_iter);
               _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
                 send_sync_block_to_node_delegate(block_message_to_process);
@@ -3319,7 +3373,7 @@ namespace graphene { namespace net { namespace detail {
               std::vector< peer_connection_ptr > peers_needing_next_batch;
               for (const peer_connection_ptr& peer : _active_connections)
               {
-                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->block_id);
+                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_id);
                 if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
                 {
                   peer->ids_of_items_being_processed.erase(items_being_processed_iter);
@@ -3342,9 +3396,8 @@ namespace graphene { namespace net { namespace detail {
                 fetch_next_batch_of_item_ids_from_peer(peer.get());
             }
 
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+          }
+        }
 
         if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
         {
@@ -3377,9 +3430,11 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
-      // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      // add it to _received_sync_items, then process _received_sync_items to try to
+      // pass as many messages as possible to the client.  The client can start checking the block
+      // while it waits for the blocks in front of it.
+      if( _received_sync_items.emplace( block_message_to_process.block_id, block_message_to_process ).second )
+        _delegate->prevalidate_sync_block( block_message_to_process );
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -4777,7 +4832,6 @@ namespace graphene { namespace net { namespace detail {
       ilog( "--------- MEMORY USAGE ------------" );
       ilog( "node._active_sync_requests size: ${size}", ("size", _active_sync_requests.size() ) );
       ilog( "node._received_sync_items size: ${size}", ("size", _received_sync_items.size() ) );
-      ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
       ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
@@ -5000,6 +5054,8 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("enable_message_compression"))
+        _message_compression_enabled = params["enable_message_compression"].as<bool>();
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -5019,6 +5075,7 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["enable_message_compression"] = _message_compression_enabled;
       return result;
     }
 
@@ -5499,6 +5556,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_item, id);
     }
 
+    message statistics_gathering_node_delegate_wrapper::get_compressed_item( const item_id& id )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_compressed_item, id);
+    }
+
     std::vector<item_hash_t> statistics_gathering_node_delegate_wrapper::get_blockchain_synopsis(const item_hash_t& reference_point, uint32_t number_of_blocks_after_reference_point)
     {
       INVOKE_AND_COLLECT_STATISTICS(get_blockchain_synopsis, reference_point, number_of_blocks_after_reference_point);
@@ -5521,6 +5583,13 @@ namespace graphene { namespace net { namespace detail {
       return _node_delegate->get_block_number(block_id);
     }
 
+    void statistics_gathering_node_delegate_wrapper::prevalidate_sync_block( const graphene::net::block_message& block_message )
+    {
+      // only queues work for the client's own threads, so it doesn't need to run on the delegate thread
+      ASSERT_TASK_NOT_PREEMPTED();
+      _node_delegate->prevalidate_sync_block(block_message);
+    }
+
     fc::time_point_sec statistics_gathering_node_delegate_wrapper::get_block_time(const item_hash_t& block_id)
     {
       INVOKE_AND_COLLECT_STATISTICS(get_block_time, block_id);
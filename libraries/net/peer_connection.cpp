@@ -62,7 +62,8 @@ namespace graphene { namespace net
     }
     message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
     {
-      return node->get_message_for_item(item_to_send);
+      return compressed ? node->get_compressed_message_for_item(item_to_send) :
+                          node->get_message_for_item(item_to_send);
     }
 
     size_t peer_connection::virtual_queued_message::get_size_in_queue()
@@ -383,7 +384,7 @@ namespace graphene { namespace net
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_item() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", item_to_send.item_type)("endpoint", get_remote_endpoint()));
-      std::unique_ptr<queued_message> message_to_enqueue(new virtual_queued_message(item_to_send));
+      std::unique_ptr<queued_message> message_to_enqueue(new virtual_queued_message(item_to_send, accepts_compressed_messages));
       send_queueable_message(std::move(message_to_enqueue));
     }
 
@@ -9,7 +9,6 @@
 
 #include <sigmaengine/chain/database.hpp>
 #include <sigmaengine/chain/operation_notification.hpp>
-#include <sigmaengine/chain/history_object.hpp>
 
 #include <fc/smart_ref_impl.hpp>
 #include <fc/thread/thread.hpp>
@@ -55,43 +54,18 @@ account_history_plugin_impl::~account_history_plugin_impl()
 
 struct operation_visitor
 {
-   operation_visitor( database& db, const operation_notification& note, const operation_object*& n, account_name_type i )
-      :_db(db), _note(note), new_obj(n), item(i) {}
+   operation_visitor( database& db, const operation_notification& note, account_name_type i )
+      :_db(db), _note(note), item(i) {}
 
    typedef void result_type;
 
    database& _db;
    const operation_notification& _note;
-   const operation_object*& new_obj;
    account_name_type item;
 
    template<typename Op>
    void operator()( Op&& )const
    {
-         const auto& hist_idx = _db.get_index<account_history_index>().indices().get<by_account>();
-         if( !new_obj )
-         {
-            new_obj = &_db.create<operation_object>( [&]( operation_object& obj )
-            {
-               obj.trx_id       = _note.trx_id;
-               obj.block        = _note.block;
-               obj.trx_in_block = _note.trx_in_block;
-               obj.op_in_trx    = _note.op_in_trx;
-               obj.virtual_op   = _note.virtual_op;
-               obj.timestamp    = _db.head_block_time();
-               //fc::raw::pack( obj.serialized_op , _note.op);  //call to 'pack' is ambiguous
-               auto size = fc::raw::pack_size( _note.op );
-               obj.serialized_op.resize( size );
-               fc::datastream< char* > ds( obj.serialized_op.data(), size );
-               fc::raw::pack( ds, _note.op );
-            });
-         }
-
-         auto hist_itr = hist_idx.lower_bound( boost::make_tuple( item, uint32_t(-1) ) );
-         uint32_t sequence = 0;
-         if( hist_itr != hist_idx.end() && hist_itr->account == item )
-            sequence = hist_itr->sequence + 1;
-
          uint32_t op_tag = 0;
 
          asset_symbol_type token_symbol = SGT_SYMBOL;
@@ -120,45 +94,24 @@ struct operation_visitor
                break;
                
             case operation::tag<custom_json_dapp_operation>::value:
-            { 
-               const std::string& type_name = fc::get_typename< transfer_token_operation >::name();
-               auto start = type_name.find_last_of( ':' ) + 1;
-               auto end   = type_name.find_last_of( '_' );
-               string transfer_token_op_name  = type_name.substr( start, end - start );
-
-               const std::string& type_name_savings = fc::get_typename< transfer_token_savings_operation >::name();
-               auto start_savings = type_name_savings.find_last_of( ':' ) + 1;
-               auto end_savings   = type_name_savings.find_last_of( '_' );
-               string transfer_token_savings_op_name  = type_name_savings.substr( start_savings, end_savings - start_savings );
-
-               auto& custom_op = _note.op.get< custom_json_dapp_operation >();
-               try{
-                  auto var = fc::json::from_string( custom_op.json );
-                  auto ar = var.get_array();
-                  if( ( ar[0].is_uint64() && ar[0].as_uint64() == token_operation::tag< transfer_token_operation >::value ) 
-                     || ( ar[0].as_string() == transfer_token_op_name ) ) 
-                  {
-                      op_tag = 3;
-                      const transfer_token_operation inner_op = ar[1].as< transfer_token_operation >();
-                      transfer_token_operation temp_op = inner_op;
-                      token_symbol = temp_op.amount.symbol;
-                  }
-                  else if( ( ar[0].is_uint64() && ar[0].as_uint64() == token_operation::tag< transfer_token_savings_operation >::value ) 
-                     || ( ar[0].as_string() == transfer_token_savings_op_name ) ) 
+            {
+               // Decoded once per operation and shared with the other observers and the token evaluator
+               const auto* inner_ops = _note.find_inner_operations< token_operation >();
+               op_tag = 2;
+               if( inner_ops != nullptr && inner_ops->size() )
+               {
+                  const token_operation& inner_op = inner_ops->front();
+                  if( inner_op.which() == token_operation::tag< transfer_token_operation >::value )
                   {
-                      op_tag = 3;
-                      const transfer_token_savings_operation inner_op = ar[1].as< transfer_token_savings_operation >();
-                      transfer_token_savings_operation temp_op = inner_op;
-                      token_symbol = temp_op.amount.symbol;
+                     op_tag = 3;
+                     token_symbol = inner_op.get< transfer_token_operation >().amount.symbol;
                   }
-                  else
+                  else if( inner_op.which() == token_operation::tag< transfer_token_savings_operation >::value )
                   {
-                     op_tag = 2;
+                     op_tag = 3;
+                     token_symbol = inner_op.get< transfer_token_savings_operation >().amount.symbol;
                   }
                }
-               catch( const fc::exception& ) {
-                  op_tag = 2;
-               }
             }
                break;
 
@@ -167,39 +120,19 @@ struct operation_visitor
                break;
          }
 
-         uint32_t op_seq = 0;
-         const auto& hiop_idx = _db.get_index<account_history_index>().indices().get<by_account_op_tag>();
-         //auto hiop_itr = hiop_idx.lower_bound( boost::make_tuple( item, _note.op.which(), uint32_t(-1) ) );
-         auto hiop_itr = hiop_idx.lower_bound( boost::make_tuple( item, op_tag, uint32_t(-1) ) );
-         if( hiop_itr != hiop_idx.end() && hiop_itr->account == item && hiop_itr->op_tag == op_tag )
-            op_seq = hiop_itr->op_seq + 1;
-
-         uint32_t token_seq = 0;
-         const auto& token_idx = _db.get_index<account_history_index>().indices().get<by_account_token>();
-         auto token_itr = token_idx.lower_bound( boost::make_tuple( item, op_tag, token_symbol, uint32_t(-1) ) );
-         if( token_itr != token_idx.end() && token_itr->token_symbol == token_symbol )
-            token_seq = token_itr->token_seq + 1;
-
-         _db.create<account_history_object>( [&]( account_history_object& ahist )
-         {
-            ahist.account  = item;
-            ahist.sequence = sequence;
-
-            ahist.op_tag = op_tag;
-            ahist.op_seq = op_seq;
-
-            ahist.token_seq = token_seq;
-            ahist.token_symbol = token_symbol;
-            
-            ahist.op       = new_obj->id;
-         });
+         // The operation is stored once and filed under the account, the account and tag, and the account, tag and token
+         auto& history = _db.get_history_store();
+         auto timestamp = _db.head_block_time();
+         history.add_operation( _note, timestamp, account_history_key( item ) );
+         history.add_operation( _note, timestamp, account_history_key( item, op_tag ) );
+         history.add_operation( _note, timestamp, account_history_key( item, op_tag, token_symbol ) );
    }
 };
 
 struct operation_visitor_filter : operation_visitor
 {
-   operation_visitor_filter( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, const flat_set< string >& filter, bool blacklist ):
-      operation_visitor( db, note, n, i ), _filter( filter ), _blacklist( blacklist ) {}
+   operation_visitor_filter( database& db, const operation_notification& note, account_name_type i, const flat_set< string >& filter, bool blacklist ):
+      operation_visitor( db, note, i ), _filter( filter ), _blacklist( blacklist ) {}
 
    const flat_set< string >& _filter;
    bool _blacklist;
@@ -225,8 +158,7 @@ void account_history_plugin_impl::on_operation( const operation_notification& no
    flat_set<account_name_type> impacted;
    sigmaengine::chain::database& db = database();
 
-   const operation_object* new_obj = nullptr;
-   app::operation_get_impacted_accounts( note.op, db, impacted );
+   app::operation_get_impacted_accounts( note, db, impacted );
 
    for( const auto& item : impacted ) {
       auto itr = _tracked_accounts.lower_bound( item );
@@ -260,11 +192,11 @@ void account_history_plugin_impl::on_operation( const operation_notification& no
       {
          if(_filter_content)
          {
-            note.op.visit( operation_visitor_filter( db, note, new_obj, item, _op_list, _blacklist ) );
+            note.op.visit( operation_visitor_filter( db, note, item, _op_list, _blacklist ) );
          }
          else
          {
-            note.op.visit( operation_visitor( db, note, new_obj, item ) );
+            note.op.visit( operation_visitor( db, note, item ) );
          }
       }
    }
@@ -303,6 +235,7 @@ void account_history_plugin::plugin_set_program_options(
 void account_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
    //ilog("Intializing account history plugin" );
+   database().enable_history_store();
    database().pre_apply_operation.connect( [&]( const operation_notification& note ){ my->on_operation(note); } );
 
    typedef pair<account_name_type,account_name_type> pairstring;
@@ -42,19 +42,19 @@ void auth_util_api_impl::check_authority_signature( const check_authority_signat
 {
    std::shared_ptr< chain::database > db = app.chain_database();
    const chain::account_authority_object& acct = db->get< chain::account_authority_object, chain::by_account >( args.account_name );
-   protocol::authority auth;
+   protocol::authority_view auth;
 
    if( (args.level == "posting") || (args.level == "p") )
    {
-      auth = protocol::authority( acct.posting );
+      auth = acct.posting;
    }
    else if( (args.level == "active") || (args.level == "a") || (args.level == "") )
    {
-      auth = protocol::authority( acct.active );
+      auth = acct.active;
    }
    else if( (args.level == "owner") || (args.level == "o") )
    {
-      auth = protocol::authority( acct.owner );
+      auth = acct.owner;
    }
    else
    {
@@ -68,9 +68,9 @@ void auth_util_api_impl::check_authority_signature( const check_authority_signat
    }
 
    flat_set< protocol::public_key_type > avail;
-   protocol::sign_state ss( signing_keys, [&db]( const std::string& account_name ) -> const protocol::authority
+   protocol::sign_state ss( signing_keys, [&db]( const std::string& account_name ) -> protocol::authority_view
    {
-      return protocol::authority(db->get< chain::account_authority_object, chain::by_account >( account_name ).active );
+      return db->get< chain::account_authority_object, chain::by_account >( account_name ).active;
    }, avail );
 
    bool has_authority = ss.check_authority( auth );
@@ -2,7 +2,6 @@
 
 #include <sigmaengine/app/impacted.hpp>
 #include <sigmaengine/chain/account_object.hpp>
-#include <sigmaengine/chain/history_object.hpp>
 
 #include <sigmaengine/chain/database.hpp>
 #include <sigmaengine/chain/index.hpp>
@@ -70,6 +69,11 @@ void blockchain_statistics_plugin_impl::on_block( const signed_block& b )
 {
    auto& db = _self.database();
 
+   // Counted by the chain while the block was applied
+   const auto* stats = db.find_block_stats( b.block_num() );
+   FC_ASSERT( stats != nullptr && stats->block_num == b.block_num() );
+   uint32_t num_ops = stats->operation_count - stats->virtual_operation_count;
+
    if( b.block_num() == 1 )
    {
       db.create< bucket_object >( [&]( bucket_object& bo )
@@ -77,6 +81,7 @@ void blockchain_statistics_plugin_impl::on_block( const signed_block& b )
          bo.open = b.timestamp;
          bo.seconds = 0;
          bo.blocks = 1;
+         bo.operations = num_ops;
       });
    }
    else
@@ -84,6 +89,7 @@ void blockchain_statistics_plugin_impl::on_block( const signed_block& b )
       db.modify( db.get( bucket_id_type() ), [&]( bucket_object& bo )
       {
          bo.blocks++;
+         bo.operations += num_ops;
       });
    }
 
@@ -93,9 +99,9 @@ void blockchain_statistics_plugin_impl::on_block( const signed_block& b )
    const auto& bucket_idx = db.get_index< bucket_index >().indices().get< by_bucket >();
 
    uint32_t trx_size = 0;
-   uint32_t num_trx =b.transactions.size();
+   uint32_t num_trx = stats->transaction_count;
 
-   for( auto trx : b.transactions )
+   for( const auto& trx : b.transactions )
    {
       trx_size += fc::raw::pack_size( trx );
    }
@@ -148,6 +154,7 @@ void blockchain_statistics_plugin_impl::on_block( const signed_block& b )
       db.modify( *itr, [&]( bucket_object& bo )
       {
          bo.transactions += num_trx;
+         bo.operations += num_ops;
          bo.bandwidth += trx_size;
       });
    }
@@ -165,13 +172,6 @@ void blockchain_statistics_plugin_impl::post_operation( const operation_notifica
    {
       const auto& bucket = db.get(bucket_id);
 
-      if( !is_virtual_operation( o.op ) )
-      {
-         db.modify( bucket, [&]( bucket_object& b )
-         {
-            b.operations++;
-         });
-      }
       o.op.visit( operation_process( _self, bucket ) );
    }
    } FC_CAPTURE_AND_RETHROW()
@@ -224,7 +224,7 @@ namespace detail
          case operation::tag< custom_binary_operation >::value:
          {
             flat_set< account_name_type > impacted;
-            app::operation_get_impacted_accounts( note.op, _self.database(), impacted );
+            app::operation_get_impacted_accounts( note, _self.database(), impacted );
 /*
             for( auto& account : impacted )
                if( db.is_producing() )
@@ -38,10 +38,11 @@ namespace sigmaengine { namespace dapp_history {
    struct get_dapp_name_visitor {
       flat_set< dapp_name_type >& _impacted;
       chain::database& _db;
+      const chain::operation_notification& _note;
       typedef void result_type;
 
-      get_dapp_name_visitor( chain::database& db, flat_set< dapp_name_type >& impact )
-         : _impacted(impact), _db( db ) {}
+      get_dapp_name_visitor( chain::database& db, const chain::operation_notification& note, flat_set< dapp_name_type >& impact )
+         : _impacted(impact), _db( db ), _note( note ) {}
 
       template< typename T >
       void operator()( const T& op ) {
@@ -72,11 +73,11 @@ namespace sigmaengine { namespace dapp_history {
       }
 
       void operator()( const custom_json_operation& op) {
-         get_imapcted_dapp_from_custom( op, _db, _impacted );
+         get_imapcted_dapp_from_custom( _note, _db, _impacted );
       }
 
       void operator()( const custom_json_dapp_operation& op) {
-         get_imapcted_dapp_from_custom( op, _db, _impacted );
+         get_imapcted_dapp_from_custom( _note, _db, _impacted );
       }
 
       void operator()( const custom_binary_operation& op) {
@@ -253,17 +254,13 @@ namespace sigmaengine { namespace dapp_history {
    }; // struct get_dapp_name_visitor_from_custom
 
    template< typename OPERATION_TYPE, typename VISITOR >
-   void process_inner_operation( const fc::variant var, VISITOR visitor ){
+   void process_inner_operation( const chain::operation_notification& note, VISITOR visitor ){
       try {
-         std::vector< OPERATION_TYPE > operations;
-         if( var.is_array() && var.size() > 0 && var.get_array()[0].is_array() ) {
-            from_variant( var, operations );
-         } else {
-            operations.emplace_back();
-            from_variant( var, operations[0] );
-         }
+         const auto* operations = note.find_inner_operations< OPERATION_TYPE >();
+         if( operations == nullptr )
+            return;
 
-         for( const OPERATION_TYPE& inner_o : operations ) {
+         for( const OPERATION_TYPE& inner_o : *operations ) {
             inner_o.visit( visitor );
          }
       } catch( const fc::exception& ) { }
@@ -285,20 +282,10 @@ namespace sigmaengine { namespace dapp_history {
       } catch( const fc::exception& ) { }
    }
 
-   void get_imapcted_dapp_from_custom( const custom_json_dapp_operation& op, chain::database& db, flat_set< dapp_name_type >& result ) {
-      auto var = fc::json::from_string( op.json );
-
-      process_inner_operation< dapp_operation >( var, get_dapp_name_visitor_from_custom( db, result ) );
-      process_inner_operation< token_operation >( var, get_dapp_name_visitor_from_custom( db, result ) );
-      process_inner_operation< bobserver_plugin_operation >( var, get_dapp_name_visitor_from_custom( db, result ) );
-   }
-
-   void get_imapcted_dapp_from_custom( const custom_json_operation& op, chain::database& db, flat_set< dapp_name_type >& result ) {
-      auto var = fc::json::from_string( op.json );
-
-      process_inner_operation< dapp_operation >( var, get_dapp_name_visitor_from_custom( db, result ) );
-      process_inner_operation< token_operation >( var, get_dapp_name_visitor_from_custom( db, result ) );
-      process_inner_operation< bobserver_plugin_operation >( var, get_dapp_name_visitor_from_custom( db, result ) );
+   void get_imapcted_dapp_from_custom( const chain::operation_notification& note, chain::database& db, flat_set< dapp_name_type >& result ) {
+      process_inner_operation< dapp_operation >( note, get_dapp_name_visitor_from_custom( db, result ) );
+      process_inner_operation< token_operation >( note, get_dapp_name_visitor_from_custom( db, result ) );
+      process_inner_operation< bobserver_plugin_operation >( note, get_dapp_name_visitor_from_custom( db, result ) );
    }
 
    void get_imapcted_dapp_from_custom( const custom_binary_operation& op, chain::database& db, flat_set< dapp_name_type >& result ) {
@@ -308,7 +295,11 @@ namespace sigmaengine { namespace dapp_history {
    }
 
    void operation_get_impacted_dapp( const operation& op, chain::database& db, flat_set< dapp_name_type >& result ) {
-      get_dapp_name_visitor visitor = get_dapp_name_visitor( db, result );
-      op.visit( visitor );
+      operation_get_impacted_dapp( chain::operation_notification( op ), db, result );
+   }
+
+   void operation_get_impacted_dapp( const chain::operation_notification& note, chain::database& db, flat_set< dapp_name_type >& result ) {
+      get_dapp_name_visitor visitor = get_dapp_name_visitor( db, note, result );
+      note.op.visit( visitor );
    }
 } } //namespace sigmaengine::dapp_history
@@ -4,7 +4,7 @@
 #include <sigmaengine/app/sigmaengine_api_objects.hpp>
 #include <sigmaengine/app/applied_operation.hpp>
 
-#include <sigmaengine/dapp_history/dapp_history_objects.hpp>
+#include <sigmaengine/dapp_history/dapp_history_plugin.hpp>
 
 #include <fc/api.hpp>
 
@@ -14,6 +14,22 @@ namespace sigmaengine { namespace dapp_history {
 
    namespace detail { class dapp_history_plugin_impl; }
 
+   /// Keys the dapp_history plugin files operations under in the history store
+   inline string dapp_history_key( const dapp_name_type& dapp_name )
+   {
+      return "dapp/" + string( dapp_name );
+   }
+
+   inline string dapp_operation_list_key()
+   {
+      return "dapp";
+   }
+
+   inline string nsta602_transfer_history_key( const dapp_name_type& dapp_name, const string& author, const string& unique_id )
+   {
+      return dapp_history_key( dapp_name ) + "/nsta602/" + author + "/" + unique_id;
+   }
+
    class dapp_history_plugin : public sigmaengine::app::plugin
    {
       public:
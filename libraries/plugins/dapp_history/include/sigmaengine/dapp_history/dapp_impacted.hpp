@@ -43,13 +43,12 @@ namespace sigmaengine { namespace dapp_history {
    using namespace sigmaengine::bobserver;
 
    template< typename OPERATION_TYPE, typename VISITOR >
-   void process_inner_operation( const fc::variant var, VISITOR visitor );
+   void process_inner_operation( const chain::operation_notification& note, VISITOR visitor );
 
    template< typename OPERATION_TYPE, typename VISITOR >
    void process_inner_operation( vector< char > data, VISITOR visitor );
 
-   void get_imapcted_dapp_from_custom( const custom_json_dapp_operation& op, chain::database& db, fc::flat_set< protocol::dapp_name_type >& result );
-   void get_imapcted_dapp_from_custom( const custom_json_operation& op, chain::database& db, fc::flat_set< protocol::dapp_name_type >& result );
+   void get_imapcted_dapp_from_custom( const chain::operation_notification& note, chain::database& db, fc::flat_set< protocol::dapp_name_type >& result );
    void get_imapcted_dapp_from_custom( const custom_binary_operation& op, chain::database& db, fc::flat_set< protocol::dapp_name_type >& result );
 
    void operation_get_impacted_dapp(
@@ -57,4 +56,10 @@ namespace sigmaengine { namespace dapp_history {
       chain::database& db,
       fc::flat_set< protocol::dapp_name_type >& result );
 
+   /// Same as above, reusing the custom json inner operations already decoded for the notification
+   void operation_get_impacted_dapp(
+      const chain::operation_notification& note,
+      chain::database& db,
+      fc::flat_set< protocol::dapp_name_type >& result );
+
 } } // sigmaengine::dapp_history
@@ -125,6 +125,23 @@ bool is_valid_account_name( const string& name )
    return true;
 }
 
+authority_view::operator authority()const
+{
+   authority result;
+
+   result.account_auths.reserve( account_auths.size() );
+   for( const auto& item : account_auths )
+      result.account_auths.insert( item );
+
+   result.key_auths.reserve( key_auths.size() );
+   for( const auto& item : key_auths )
+      result.key_auths.insert( item );
+
+   result.weight_threshold = weight_threshold;
+
+   return result;
+}
+
 bool operator == ( const authority& a, const authority& b )
 {
    return ( a.weight_threshold == b.weight_threshold ) &&
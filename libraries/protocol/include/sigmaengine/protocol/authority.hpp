@@ -54,6 +54,65 @@ namespace sigmaengine { namespace protocol {
       key_authority_map                                               key_auths;
    };
 
+   /**
+    *  A read only view of an authority kept elsewhere, an authority or a chain::shared_authority in
+    *  shared memory, which lets signatures be checked against an account authority without copying it.
+    *  The viewed authority must outlive the view and must not change while the view is used, so a view
+    *  of a temporary authority cannot be made, whether or not the temporary is const. A getter returning
+    *  an authority by value therefore does not compile as an authority_getter.
+    */
+   struct authority_view
+   {
+      template< typename T >
+      struct range
+      {
+         range() : first( nullptr ), last( nullptr ) {}
+         range( const T* f, const T* l ) : first( f ), last( l ) {}
+
+         const T* begin()const { return first; }
+         const T* end()const   { return last; }
+         size_t   size()const  { return last - first; }
+
+         const T* first;
+         const T* last;
+      };
+
+      typedef std::pair< account_name_type, weight_type >             account_weight;
+      typedef std::pair< public_key_type, weight_type >               key_weight;
+
+      authority_view(){}
+
+      authority_view( const authority& a )
+         : authority_view( a.weight_threshold, a.account_auths, a.key_auths ) {}
+
+      authority_view( authority&& a ) = delete;
+      authority_view( const authority&& a ) = delete;
+
+      /// Views the contiguous sorted pairs of any flat map with the same value types as authority
+      template< typename AccountMap, typename KeyMap >
+      authority_view( uint32_t threshold, const AccountMap& accounts, const KeyMap& keys )
+         : weight_threshold( threshold ),
+           account_auths( range_of< account_weight >( accounts ) ),
+           key_auths( range_of< key_weight >( keys ) ) {}
+
+      operator authority()const;
+
+      uint32_t                                                        weight_threshold = 0;
+      range< account_weight >                                         account_auths;
+      range< key_weight >                                             key_auths;
+
+      private:
+         template< typename T, typename FlatMap >
+         static range< T > range_of( const FlatMap& m )
+         {
+            static_assert( std::is_same< typename FlatMap::value_type, T >::value, "Not a map of authority weights" );
+            if( m.empty() )
+               return range< T >();
+            const T* first = &*m.begin();
+            return range< T >( first, first + m.size() );
+         }
+   };
+
 template< typename AuthorityType >
 void add_authority_accounts(
    flat_set<account_name_type>& result,
@@ -5,7 +5,11 @@
 
 namespace sigmaengine { namespace protocol {
 
-typedef std::function<authority(const string&)> authority_getter;
+/**
+ * Returns the authority of an account. The view must stay valid while the transaction is checked, so a
+ * getter returns a view of an authority it keeps, such as the shared_authority of the account object.
+ */
+typedef std::function<authority_view(const string&)> authority_getter;
 
 struct sign_state
 {
@@ -19,7 +23,7 @@ struct sign_state
        *  Checks to see if we have signatures of the active authorites of
        *  the accounts specified in authority or the keys specified.
        */
-      bool check_authority( const authority& au, uint32_t depth = 0 );
+      bool check_authority( const authority_view& au, uint32_t depth = 0 );
 
       bool remove_unused_signatures();
 
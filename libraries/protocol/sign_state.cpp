@@ -22,7 +22,7 @@ bool sign_state::check_authority( string id )
    return check_authority( get_active(id) );
 }
 
-bool sign_state::check_authority( const authority& auth, uint32_t depth )
+bool sign_state::check_authority( const authority_view& auth, uint32_t depth )
 {
    uint32_t total_weight = 0;
    for( const auto& k : auth.key_auths )
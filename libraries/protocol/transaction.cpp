@@ -124,9 +124,9 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
                           s.check_authority(get_owner(id)),
                           tx_missing_posting_auth, "Missing Posting Authority ${id}",
                           ("id",id)
-                          ("posting",get_posting(id))
-                          ("active",get_active(id))
-                          ("owner",get_owner(id)) );
+                          ("posting",authority(get_posting(id)))
+                          ("active",authority(get_active(id)))
+                          ("owner",authority(get_owner(id))) );
       }
       SIGMAENGINE_ASSERT(
          !s.remove_unused_signatures(),
@@ -154,14 +154,14 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
    {
       SIGMAENGINE_ASSERT( s.check_authority(id) ||
                        s.check_authority(get_owner(id)),
-                       tx_missing_active_auth, "Missing Active Authority ${id}", ("id",id)("auth",get_active(id))("owner",get_owner(id)) );
+                       tx_missing_active_auth, "Missing Active Authority ${id}", ("id",id)("auth",authority(get_active(id)))("owner",authority(get_owner(id))) );
    }
 
    for( auto id : required_owner )
    {
       SIGMAENGINE_ASSERT( owner_approvals.find(id) != owner_approvals.end() ||
                        s.check_authority(get_owner(id)),
-                       tx_missing_owner_auth, "Missing Owner Authority ${id}", ("id",id)("auth",get_owner(id)) );
+                       tx_missing_owner_auth, "Missing Owner Authority ${id}", ("id",id)("auth",authority(get_owner(id))) );
    }
 
    SIGMAENGINE_ASSERT(
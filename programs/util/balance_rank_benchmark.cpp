@@ -0,0 +1,88 @@
+/*
+ * Measures paging deep into the balance ranking served by get_balance_rank. Fills a scratch
+ * chainbase database with accounts holding random balances, then compares stepping an iterator
+ * from the top of by_balance to each offset with the logarithmic nth() and rank() lookups.
+ */
+
+#include <sigmaengine/chain/account_object.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace sigmaengine::chain;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      uint32_t account_count = argc > 1 ? std::stoul( argv[1] ) : 1000000;
+      uint32_t lookups = argc > 2 ? std::stoul( argv[2] ) : 100;
+
+      fc::temp_directory dir( fc::temp_directory_path() );
+      chainbase::database db;
+      db.open( dir.path(), chainbase::database::read_write, uint64_t( account_count ) * 1024 + 1024 * 1024 * 64 );
+      db.add_index< account_index >();
+
+      std::mt19937_64 rng( 42 );
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         db.create< account_object >( [&]( account_object& a )
+         {
+            a.name = "bench" + std::to_string( i );
+            a.balance = asset( rng() % 1000000000, SGT_SYMBOL );
+         });
+      }
+
+      const auto& idx = db.get_index< account_index >().indices().get< by_balance >();
+      std::cout << account_count << " accounts\n";
+
+      auto report = []( const char* name, uint32_t count, fc::microseconds t )
+      {
+         double seconds = std::max( double( t.count() ) / 1000000.0, 0.000001 );
+         std::cout << name << ": " << count << " lookups in " << seconds << " s, " << uint64_t( count / seconds ) << " lookups/s\n";
+      };
+
+      for( uint32_t depth : { 10u, 50u, 90u, 99u } )
+      {
+         uint64_t offset = uint64_t( account_count ) * depth / 100;
+         account_id_type expected;
+
+         auto start = fc::time_point::now();
+         for( uint32_t i = 0; i < lookups; ++i )
+         {
+            auto itr = idx.begin();
+            for( uint64_t n = 0; n < offset; ++n )
+               ++itr;
+            expected = itr->id;
+         }
+         auto walk_time = fc::time_point::now() - start;
+
+         start = fc::time_point::now();
+         for( uint32_t i = 0; i < lookups; ++i )
+            FC_ASSERT( idx.nth( offset )->id == expected );
+         auto nth_time = fc::time_point::now() - start;
+
+         auto itr = idx.nth( offset );
+         start = fc::time_point::now();
+         for( uint32_t i = 0; i < lookups; ++i )
+            FC_ASSERT( idx.rank( itr ) == offset );
+         auto rank_time = fc::time_point::now() - start;
+
+         std::cout << "offset " << offset << " (" << depth << "%)\n";
+         report( "   iterator walk", lookups, walk_time );
+         report( "   nth          ", lookups, nth_time );
+         report( "   rank         ", lookups, rank_time );
+      }
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
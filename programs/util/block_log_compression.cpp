@@ -0,0 +1,196 @@
+/*
+ * Measures what compression would save on a segment of a block log, for storage and for sync.
+ *
+ * Storage: the segment is written as a chunk compressed archive. Each chunk holds blocks_per_chunk
+ * blocks, every one prefixed with its 4 byte packed size, deflated as a whole. A sidecar index file
+ * holds one fixed size record per chunk (first block number, file offset, compressed and uncompressed
+ * size), so block n is found by seeking to index_record_size * ((n - first) / blocks_per_chunk) and
+ * inflating a single chunk. Every block is read back through the index and compared with the log.
+ *
+ * Sync: each block is compressed on its own, as the p2p layer does for a compressed_message, to get
+ * the bytes sent per block and the time spent compressing and inflating it.
+ */
+
+#include <iostream>
+#include <string>
+
+#include <sigmaengine/chain/block_log.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/time.hpp>
+
+#include <fstream>
+
+using namespace sigmaengine::chain;
+
+namespace
+{
+   struct chunk_record
+   {
+      uint32_t first_block;
+      uint64_t offset;
+      uint32_t compressed_size;
+      uint32_t uncompressed_size;
+   };
+
+   const uint64_t index_record_size = 4 + 8 + 4 + 4;
+
+   double seconds( fc::microseconds t )
+   {
+      return std::max( double( t.count() ) / 1000000.0, 0.000001 );
+   }
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      if( argc < 3 )
+      {
+         std::cerr << "block_log_compression <block_log> <output> [blocks_per_chunk] [first_block] [block_count]\n";
+         return 1;
+      }
+
+      block_log log;
+      log.open( fc::path( argv[1] ) );
+      FC_ASSERT( log.head().valid(), "Block log is empty" );
+
+      fc::path output( argv[2] );
+      fc::path index_output( output.generic_string() + ".index" );
+
+      uint32_t head_num = log.head()->block_num();
+      uint32_t blocks_per_chunk = argc > 3 ? std::stoul( argv[3] ) : 256;
+      uint32_t first = argc > 4 ? std::stoul( argv[4] ) : 1;
+      uint32_t count = argc > 5 ? std::stoul( argv[5] ) : head_num;
+      FC_ASSERT( blocks_per_chunk >= 1 );
+      FC_ASSERT( first >= 1 && first <= head_num );
+      uint32_t last = std::min< uint64_t >( head_num, uint64_t( first ) + count - 1 );
+      count = last - first + 1;
+
+      // Storage: chunk compressed archive
+      uint64_t raw_bytes = 0;
+      uint64_t archive_bytes = 0;
+      fc::microseconds compress_time;
+      {
+         std::ofstream out( output.generic_string(), std::ios::binary | std::ios::trunc );
+         std::ofstream index_out( index_output.generic_string(), std::ios::binary | std::ios::trunc );
+         FC_ASSERT( out && index_out, "Unable to create ${o}", ("o", output) );
+
+         std::vector< char > chunk;
+         for( uint32_t chunk_first = first; chunk_first <= last; chunk_first += blocks_per_chunk )
+         {
+            uint32_t chunk_last = std::min< uint64_t >( last, uint64_t( chunk_first ) + blocks_per_chunk - 1 );
+
+            chunk.clear();
+            for( uint32_t n = chunk_first; n <= chunk_last; ++n )
+            {
+               auto data = log.read_serialized_block_by_num( n );
+               FC_ASSERT( data.valid(), "Block ${n} is missing", ("n", n) );
+               uint32_t size = data->size;
+               chunk.insert( chunk.end(), (const char*)&size, (const char*)&size + sizeof( size ) );
+               chunk.insert( chunk.end(), data->data, data->data + data->size );
+               raw_bytes += data->size;
+            }
+
+            auto start = fc::time_point::now();
+            auto compressed = fc::zlib_compress( chunk.data(), chunk.size() );
+            compress_time += fc::time_point::now() - start;
+
+            chunk_record record{ chunk_first, archive_bytes, uint32_t( compressed.size() ), uint32_t( chunk.size() ) };
+            out.write( compressed.data(), compressed.size() );
+            index_out.write( (const char*)&record.first_block, sizeof( record.first_block ) );
+            index_out.write( (const char*)&record.offset, sizeof( record.offset ) );
+            index_out.write( (const char*)&record.compressed_size, sizeof( record.compressed_size ) );
+            index_out.write( (const char*)&record.uncompressed_size, sizeof( record.uncompressed_size ) );
+            archive_bytes += compressed.size();
+         }
+      }
+
+      // Read every block back through the index, inflating each chunk once
+      fc::microseconds inflate_time;
+      {
+         std::ifstream in( output.generic_string(), std::ios::binary );
+         std::ifstream index_in( index_output.generic_string(), std::ios::binary );
+
+         std::vector< char > compressed;
+         for( uint32_t chunk_first = first; chunk_first <= last; chunk_first += blocks_per_chunk )
+         {
+            chunk_record record;
+            index_in.seekg( index_record_size * ( ( chunk_first - first ) / blocks_per_chunk ) );
+            index_in.read( (char*)&record.first_block, sizeof( record.first_block ) );
+            index_in.read( (char*)&record.offset, sizeof( record.offset ) );
+            index_in.read( (char*)&record.compressed_size, sizeof( record.compressed_size ) );
+            index_in.read( (char*)&record.uncompressed_size, sizeof( record.uncompressed_size ) );
+            FC_ASSERT( index_in && record.first_block == chunk_first, "Bad index record for block ${n}", ("n", chunk_first) );
+
+            compressed.resize( record.compressed_size );
+            in.seekg( record.offset );
+            in.read( compressed.data(), compressed.size() );
+            FC_ASSERT( in, "Unable to read chunk of block ${n}", ("n", chunk_first) );
+
+            auto start = fc::time_point::now();
+            auto chunk = fc::zlib_decompress( compressed.data(), compressed.size(), record.uncompressed_size );
+            inflate_time += fc::time_point::now() - start;
+
+            size_t pos = 0;
+            for( uint32_t n = chunk_first; pos < chunk.size(); ++n )
+            {
+               uint32_t size;
+               FC_ASSERT( pos + sizeof( size ) <= chunk.size() );
+               memcpy( &size, chunk.data() + pos, sizeof( size ) );
+               pos += sizeof( size );
+               FC_ASSERT( pos + size <= chunk.size() );
+
+               auto data = log.read_serialized_block_by_num( n );
+               FC_ASSERT( data->size == size && memcmp( data->data, chunk.data() + pos, size ) == 0,
+                          "Block ${n} differs after decompression", ("n", n) );
+               pos += size;
+            }
+         }
+      }
+
+      // Sync: every block compressed on its own, as sent to a peer
+      uint64_t wire_bytes = 0;
+      fc::microseconds block_compress_time;
+      fc::microseconds block_inflate_time;
+      for( uint32_t n = first; n <= last; ++n )
+      {
+         auto data = log.read_serialized_block_by_num( n );
+         if( data->size < GRAPHENE_NET_MIN_COMPRESSED_MESSAGE_SIZE )
+         {
+            wire_bytes += data->size;
+            continue;
+         }
+
+         auto start = fc::time_point::now();
+         auto compressed = fc::zlib_compress( data->data, data->size );
+         block_compress_time += fc::time_point::now() - start;
+
+         start = fc::time_point::now();
+         fc::zlib_decompress( compressed.data(), compressed.size(), data->size );
+         block_inflate_time += fc::time_point::now() - start;
+
+         wire_bytes += std::min< uint64_t >( compressed.size(), data->size );
+      }
+
+      auto ratio = []( uint64_t part, uint64_t whole ) { return whole ? double( part ) / double( whole ) : 1.0; };
+
+      std::cout << count << " blocks, " << raw_bytes << " bytes packed\n";
+      std::cout << "archive, " << blocks_per_chunk << " blocks per chunk: " << archive_bytes << " bytes ("
+                << ratio( archive_bytes, raw_bytes ) << " of packed), compressed at "
+                << uint64_t( raw_bytes / seconds( compress_time ) ) << " bytes/s, inflated at "
+                << uint64_t( count / seconds( inflate_time ) ) << " blocks/s\n";
+      std::cout << "sync, per block: " << wire_bytes << " bytes (" << ratio( wire_bytes, raw_bytes ) << " of packed), "
+                << double( block_compress_time.count() ) / count << " us to compress and "
+                << double( block_inflate_time.count() ) / count << " us to inflate per block\n";
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Compares the two ways of building the block_message served to a peer from the block log:
+ * unpacking the block and packing it again inside a block_message, or copying the packed bytes
+ * straight out of the mapped block log and appending the block id.
+ */
+
+#include <iostream>
+#include <string>
+
+#include <sigmaengine/chain/block_log.hpp>
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/time.hpp>
+
+using namespace sigmaengine::chain;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      if( argc < 2 )
+      {
+         std::cerr << "block_serve_benchmark <block_log> [first_block] [block_count]\n";
+         return 1;
+      }
+
+      block_log log;
+      log.open( fc::path( argv[1] ) );
+      FC_ASSERT( log.head().valid(), "Block log is empty" );
+
+      uint32_t head_num = log.head()->block_num();
+      uint32_t first = argc > 2 ? std::stoul( argv[2] ) : 1;
+      uint32_t count = argc > 3 ? std::stoul( argv[3] ) : 100000;
+      FC_ASSERT( first >= 1 && first <= head_num );
+      uint32_t last = std::min( head_num, first + count - 1 );
+      count = last - first + 1;
+
+      uint64_t bytes = 0;
+
+      auto start = fc::time_point::now();
+      for( uint32_t n = first; n <= last; ++n )
+      {
+         auto b = log.read_block_by_num( n );
+         graphene::net::message msg( graphene::net::block_message( std::move( *b ) ) );
+         bytes += msg.size;
+      }
+      auto unpack_time = fc::time_point::now() - start;
+
+      start = fc::time_point::now();
+      for( uint32_t n = first; n <= last; ++n )
+      {
+         auto data = log.read_serialized_block_by_num( n );
+         signed_block_header header;
+         fc::datastream< const char* > ds( data->data, data->size );
+         fc::raw::unpack( ds, header );
+
+         graphene::net::message msg;
+         msg.msg_type = graphene::net::block_message::type;
+         msg.data.assign( data->data, data->data + data->size );
+         auto packed_id = fc::raw::pack( header.id() );
+         msg.data.insert( msg.data.end(), packed_id.begin(), packed_id.end() );
+         msg.size = msg.data.size();
+         bytes -= msg.size;
+      }
+      auto raw_time = fc::time_point::now() - start;
+
+      FC_ASSERT( bytes == 0, "Raw and repacked messages differ in size" );
+
+      auto report = []( const char* name, uint32_t count, fc::microseconds t )
+      {
+         double seconds = std::max( double( t.count() ) / 1000000.0, 0.000001 );
+         std::cout << name << ": " << count << " blocks in " << seconds << " s, " << uint64_t( count / seconds ) << " blocks/s\n";
+      };
+
+      report( "unpack/repack", count, unpack_time );
+      report( "raw bytes    ", count, raw_time );
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
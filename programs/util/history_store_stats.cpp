@@ -0,0 +1,50 @@
+/*
+ * Reports how the operations in a history store are shared between the plugins that file them.
+ * Before the history store, account_history and dapp_history each kept their own packed copy of an
+ * operation in shared memory; shared_bytes_saved is what those extra copies would take today.
+ *
+ * Run it against the history directory of a stopped node, e.g. data/blockchain/history. The store is
+ * opened read only, so nothing in the directory is changed; a block that was not completely written
+ * is left for the node to cut off on its next start.
+ */
+
+#include <sigmaengine/chain/history_store.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+
+#include <iostream>
+
+using namespace sigmaengine::chain;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      if( argc != 2 )
+      {
+         std::cerr << "usage: " << argv[0] << " <history directory>\n";
+         return 1;
+      }
+
+      history_store store;
+      store.open( fc::path( argv[1] ), true );
+      auto stats = store.get_stats();
+      store.close();
+
+      std::cout << fc::json::to_pretty_string( stats ) << "\n";
+
+      uint64_t per_owner_bytes = 0;
+      for( const auto& owner : stats.owner_bytes )
+         per_owner_bytes += owner.second;
+
+      std::cout << "one copy per owner: " << per_owner_bytes << " bytes, shared records: " << stats.operation_bytes
+                << " bytes, saved: " << stats.shared_bytes_saved << " bytes\n";
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
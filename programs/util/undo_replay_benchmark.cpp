@@ -0,0 +1,90 @@
+/*
+ * Measures the undo buffer on real blocks. Replays the first block_count blocks of a block log into a
+ * scratch database through push_block, so every block is applied inside an undo session exactly as
+ * during sync, and keeps the last undo_depth blocks undoable by committing the ones before them.
+ *
+ * Reports the time spent applying blocks, and the shared memory held by the undo states of the last
+ * undo_depth blocks, which is what committing all of them frees. Run it on the same block log before
+ * and after a change to the undo states to compare both.
+ */
+
+#include <sigmaengine/chain/block_log.hpp>
+#include <sigmaengine/chain/database.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <iostream>
+#include <string>
+
+using namespace sigmaengine::chain;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      if( argc < 2 )
+      {
+         std::cerr << "undo_replay_benchmark <block_log> [block_count] [undo_depth] [shared_file_size_mb]\n";
+         return 1;
+      }
+
+      block_log log;
+      log.open( fc::path( argv[1] ) );
+      FC_ASSERT( log.head().valid(), "Block log is empty" );
+
+      uint32_t block_count = std::min< uint32_t >( argc > 2 ? std::stoul( argv[2] ) : 100000, log.head()->block_num() );
+      uint32_t undo_depth = argc > 3 ? std::stoul( argv[3] ) : 100;
+      uint64_t shared_file_size = uint64_t( argc > 4 ? std::stoul( argv[4] ) : 4096 ) * 1024 * 1024;
+
+      fc::temp_directory dir( fc::temp_directory_path() );
+      database db;
+      db.open( dir.path() / "blockchain", dir.path() / "shm", SIGMAENGINE_INIT_SUPPLY, shared_file_size, chainbase::database::read_write );
+
+      const uint32_t skip = database::skip_bobserver_signature
+                          | database::skip_transaction_signatures
+                          | database::skip_transaction_dupe_check
+                          | database::skip_tapos_check
+                          | database::skip_merkle_check
+                          | database::skip_authority_check
+                          | database::skip_undo_history_check
+                          | database::skip_bobserver_schedule_check
+                          | database::skip_validate
+                          | database::skip_validate_invariants
+                          | database::skip_block_log;
+
+      fc::microseconds apply_time;
+      for( uint32_t n = 1; n <= block_count; ++n )
+      {
+         auto block = log.read_block_by_num( n );
+         FC_ASSERT( block.valid(), "Block ${n} is missing", ("n", n) );
+
+         auto start = fc::time_point::now();
+         db.push_block( *block, skip );
+         apply_time += fc::time_point::now() - start;
+
+         if( db.revision() > int64_t( undo_depth ) )
+            db.commit( db.revision() - undo_depth );
+
+         if( n % 10000 == 0 )
+            std::cerr << "   " << n << " blocks\n";
+      }
+
+      auto free_before = db.get_free_memory();
+      db.commit( db.revision() );
+      auto undo_bytes = db.get_free_memory() - free_before;
+
+      std::cout << block_count << " blocks applied in " << apply_time.count() / 1000 << " ms, "
+                << double( apply_time.count() ) / block_count << " us per block\n";
+      std::cout << "undo states of the last " << std::min( undo_depth, block_count ) << " blocks: " << undo_bytes << " bytes\n";
+
+      db.close();
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
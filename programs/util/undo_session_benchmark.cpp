@@ -0,0 +1,160 @@
+/*
+ * Measures the cost of the per transaction undo sessions _push_transaction opens, against the number
+ * of indices registered in the database. Registers index_count indices in a scratch chainbase
+ * database, then runs transactions that each open a session, modify objects in touched_count of the
+ * indices and squash the session into a pending session, as a pending block does. Since indices only
+ * join the sessions they are changed in, the time per transaction should follow touched_count and
+ * not index_count. Undoing the pending session at the end must restore every object.
+ */
+
+#include <chainbase/chainbase.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <iostream>
+#include <string>
+
+using namespace boost::multi_index;
+
+namespace
+{
+   const uint16_t max_indices = 64;
+   const uint32_t objects_per_index = 100;
+
+   template< uint16_t TypeNumber >
+   struct bench_object : public chainbase::object< TypeNumber, bench_object< TypeNumber > >
+   {
+      template< typename Constructor, typename Allocator >
+      bench_object( Constructor&& c, Allocator&& a ) { c( *this ); }
+
+      typename chainbase::object< TypeNumber, bench_object< TypeNumber > >::id_type id;
+      uint64_t value = 0;
+   };
+
+   template< uint16_t TypeNumber >
+   using bench_index = chainbase::shared_multi_index_container<
+      bench_object< TypeNumber >,
+      indexed_by<
+         ordered_unique< member< bench_object< TypeNumber >, typename bench_object< TypeNumber >::id_type, &bench_object< TypeNumber >::id > >
+      >
+   >;
+
+   /// Calls v.visit< N >() for every index type number N below count
+   template< uint16_t First >
+   struct for_each_index
+   {
+      template< typename Visitor >
+      static void call( uint16_t count, Visitor& v )
+      {
+         if( First >= count )
+            return;
+         v.template visit< First >();
+         for_each_index< First + 1 >::call( count, v );
+      }
+   };
+
+   template<>
+   struct for_each_index< max_indices >
+   {
+      template< typename Visitor >
+      static void call( uint16_t, Visitor& ) {}
+   };
+
+   struct add_indices
+   {
+      chainbase::database& db;
+
+      template< uint16_t N >
+      void visit()
+      {
+         db.add_index< bench_index< N > >();
+         auto& idx = db.get_mutable_index< bench_index< N > >();
+         for( uint32_t i = 0; i < objects_per_index; ++i )
+            idx.emplace( [&]( bench_object< N >& o ) { o.value = i; } );
+      }
+   };
+
+   struct modify_indices
+   {
+      chainbase::database& db;
+      uint32_t transaction;
+
+      template< uint16_t N >
+      void visit()
+      {
+         auto& idx = db.get_mutable_index< bench_index< N > >();
+         const auto& obj = idx.get( typename bench_object< N >::id_type( transaction % objects_per_index ) );
+         idx.modify( obj, [&]( bench_object< N >& o ) { o.value += objects_per_index; } );
+      }
+   };
+
+   struct check_indices
+   {
+      chainbase::database& db;
+
+      template< uint16_t N >
+      void visit()
+      {
+         for( const auto& o : db.get_index< bench_index< N > >().indices() )
+            FC_ASSERT( o.value == uint64_t( o.id._id ), "Undo did not restore object ${i}", ("i", o.id._id) );
+      }
+   };
+
+   double run( uint16_t index_count, uint16_t touched_count, uint32_t transactions )
+   {
+      fc::temp_directory dir( fc::temp_directory_path() );
+      chainbase::database db;
+      db.open( dir.path(), chainbase::database::read_write, 1024 * 1024 * 256 );
+
+      add_indices adder{ db };
+      for_each_index< 0 >::call( index_count, adder );
+
+      auto pending = db.start_undo_session( true );
+
+      auto start = fc::time_point::now();
+      for( uint32_t t = 0; t < transactions; ++t )
+      {
+         auto session = db.start_undo_session( true );
+         modify_indices modifier{ db, t };
+         for_each_index< 0 >::call( touched_count, modifier );
+         session.squash();
+      }
+      auto elapsed = fc::time_point::now() - start;
+
+      pending.undo();
+      check_indices checker{ db };
+      for_each_index< 0 >::call( index_count, checker );
+
+      db.close();
+      return double( elapsed.count() ) / transactions;
+   }
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      uint32_t transactions = argc > 1 ? std::stoul( argv[1] ) : 100000;
+      uint16_t touched_count = argc > 2 ? std::stoul( argv[2] ) : 4;
+      FC_ASSERT( touched_count >= 1 && touched_count <= max_indices );
+
+      for( uint16_t index_count : { touched_count, uint16_t( 16 ), uint16_t( 32 ), max_indices } )
+      {
+         if( index_count < touched_count )
+            continue;
+         std::cout << index_count << " indices, " << touched_count << " touched per transaction: "
+                   << run( index_count, touched_count, transactions ) << " us per transaction\n";
+      }
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}